@@ -1 +1,7 @@
-g++ ./src/main.cpp ./src/glslu.cpp ./src/gl_core_4_4.cpp -static-libgcc -static-libstdc++ -L./lib -I./include -lglfw3 -lopengl32  -lgdi32 -o ./ForeverCube.exe -std=c++11
+if not exist src\generated mkdir src\generated
+if not exist cache mkdir cache
+g++ ./src/glslu_reflect.cpp ./src/glslu.cpp ./src/profiler.cpp ./src/json.cpp ./src/glslu_deletion.cpp ./src/glslu_codegen.cpp ./src/headless.cpp ./src/gl_core_4_4.cpp -static-libgcc -static-libstdc++ -L./lib -I./include -lglfw3 -lopengl32  -lgdi32 -o ./glslu-reflect.exe -std=c++11
+g++ ./src/glslu_compile.cpp ./src/glslu.cpp ./src/profiler.cpp ./src/json.cpp ./src/glslu_deletion.cpp ./src/headless.cpp ./src/gl_core_4_4.cpp -static-libgcc -static-libstdc++ -L./lib -I./include -lglfw3 -lopengl32  -lgdi32 -o ./glslu-compile.exe -std=c++11
+glslu-reflect.exe ./shaders ./src/generated
+glslu-compile.exe --cache ./cache --json ./cache/shader_build.json ./shaders
+g++ ./src/main.cpp ./src/mesh.cpp ./src/instances.cpp ./src/indirect.cpp ./src/benchmarks.cpp ./src/streaming.cpp ./src/culling.cpp ./src/gpuculling.cpp ./src/clock.cpp ./src/pacing.cpp ./src/throttle.cpp ./src/rendertarget.cpp ./src/scenebench.cpp ./src/gpuprofiler.cpp ./src/jobs.cpp ./src/transforms.cpp ./src/scenegraph.cpp ./src/renderqueue.cpp ./src/materials.cpp ./src/tga.cpp ./src/textures.cpp ./src/texturearray.cpp ./src/capabilities.cpp ./src/glslu.cpp ./src/profiler.cpp ./src/json.cpp ./src/glslu_deletion.cpp ./src/headless.cpp ./src/gl_core_4_4.cpp -static-libgcc -static-libstdc++ -L./lib -I./include -I./src -lglfw3 -lopengl32  -lgdi32 -o ./ForeverCube.exe -std=c++11
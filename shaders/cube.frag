@@ -0,0 +1,36 @@
+#version 330 core
+#extension GL_ARB_explicit_uniform_location : require
+
+in vec3 worldPosition;
+in vec3 worldNormal;
+in vec3 instanceColour;
+in vec2 surfaceCoord;
+in vec3 arrayCoord;
+
+// Locations follow on from cube.vert's
+layout(location = 2) uniform vec3 lightDirection;
+layout(location = 3) uniform vec3 eyePosition;
+layout(location = 4) uniform sampler2D surface;
+layout(location = 5) uniform sampler2DArray surfaceArray;    // the instance's own rect of a layer
+
+// One slot of the material buffer, bound per draw
+layout(std140) uniform Material
+{
+    vec4 tint;          // times the instance colour
+    vec4 specular;      // rgb colour, a shininess
+    vec4 emissive;      // rgb, unlit
+};
+
+out vec4 fragColor;
+
+void main()
+{
+    vec3 normal = normalize(worldNormal);
+    vec3 albedo = tint.rgb * texture(surface, surfaceCoord).rgb * texture(surfaceArray, arrayCoord).rgb * instanceColour * (0.5 + 0.5 * abs(normal));
+    float diffuse = max(dot(normal, -lightDirection), 0.0);
+    
+    vec3 halfway = normalize(normalize(eyePosition - worldPosition) - lightDirection);
+    float highlight = diffuse > 0.0 ? pow(max(dot(normal, halfway), 0.0), max(specular.a, 1.0)) : 0.0;
+    
+    fragColor = vec4(albedo * (0.2 + 0.8 * diffuse) + specular.rgb * highlight + emissive.rgb, 1.0);
+}
@@ -0,0 +1,48 @@
+#version 330 core
+#extension GL_ARB_explicit_uniform_location : require
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+
+// Per instance
+layout(location = 2) in mat4 transform;
+layout(location = 6) in vec4 colour;
+layout(location = 7) in float phase;
+layout(location = 8) in vec4 surfaceRect;     // xy offset, zw scale
+layout(location = 9) in float surfaceLayer;
+
+// Fixed locations, so glslu-reflect's constants hold on every driver
+layout(location = 0) uniform mat4 viewProjection;
+layout(location = 1) uniform float time;
+
+out vec3 worldPosition;
+out vec3 worldNormal;
+out vec3 instanceColour;
+out vec2 surfaceCoord;
+out vec3 arrayCoord;
+
+// Rotation by angle around the cube's fixed spin axis
+mat3 spin(float angle)
+{
+    vec3 axis = vec3(0.70710678, 0.70710678, 0.0);
+    float s = sin(angle);
+    float c = cos(angle);
+    
+    return mat3(c) + s * mat3(0.0, axis.z, -axis.y, -axis.z, 0.0, axis.x, axis.y, -axis.x, 0.0) + (1.0 - c) * outerProduct(axis, axis);
+}
+
+void main()
+{
+    mat3 rotation = mat3(transform) * spin(time + phase);
+    
+    worldPosition = rotation * position + transform[3].xyz;
+    worldNormal = rotation * normal;
+    instanceColour = colour.rgb;
+    
+    // Box mapped along the face's main axis, the shapes span -0.5 to 0.5
+    vec3 facing = abs(normal);
+    surfaceCoord = (facing.x > facing.y && facing.x > facing.z ? position.zy : facing.y > facing.z ? position.xz : position.xy) + 0.5;
+    arrayCoord = vec3(surfaceRect.xy + surfaceCoord * surfaceRect.zw, surfaceLayer);
+    
+    gl_Position = viewProjection * vec4(worldPosition, 1.0);
+}
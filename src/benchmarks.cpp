@@ -0,0 +1,657 @@
+#include "benchmarks.hpp"
+
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "capabilities.hpp"
+#include "indirect.hpp"
+#include "instances.hpp"
+#include "jobs.hpp"
+#include "streaming.hpp"
+#include "textures.hpp"
+#include "tga.hpp"
+
+using std::vector;
+using std::string;
+using std::endl;
+
+typedef std::chrono::steady_clock BenchmarkClock;
+
+namespace forever
+{
+    // Milliseconds between two clock readings
+    static double elapsed(BenchmarkClock::time_point start, BenchmarkClock::time_point end)
+    {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    
+    // Time a batch through one path
+    static BenchmarkResult measure(const string& name, Mesh& mesh, DrawBatch& batch, DrawPath path, int frames)
+    {
+	BenchmarkResult result = {name, batch.getInstanceCount(), batch.getCommandCount(), 0, 0.0, 0.0, 0.0};
+	
+	// Warm up, the first frames pay for uploads and driver validation
+	for(int frame = 0; frame < 3; ++frame)
+	    batch.draw(mesh, path);
+	
+	gl::Finish();
+	
+	for(int frame = 0; frame < frames; ++frame) {
+	    BenchmarkClock::time_point start = BenchmarkClock::now();
+	    
+	    gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
+	    result.callsPerFrame = batch.draw(mesh, path);
+	    
+	    BenchmarkClock::time_point submitted = BenchmarkClock::now();
+	    gl::Finish();
+	    
+	    result.submitTime += elapsed(start, submitted);
+	    result.frameTime += elapsed(start, BenchmarkClock::now());
+	}
+	
+	if(frames > 0) {
+	    result.submitTime /= frames;
+	    result.frameTime /= frames;
+	}
+	
+	if(result.frameTime > 0.0)
+	    result.objectsPerSecond = 1000.0 * result.objectsPerFrame / result.frameTime;
+	
+	return result;
+    }
+    
+    // Every draw path over the same scene
+    vector<BenchmarkResult> benchmarkDrawPaths(Mesh& mesh, const vector<GLuint>& partCounts, int frames)
+    {
+	vector<BenchmarkResult> results;
+	DrawBatch parts, objects;
+	
+	addPartDraws(parts, mesh, partCounts, false);
+	addPartDraws(objects, mesh, partCounts, true);
+	
+	results.push_back(measure("instanced", mesh, parts, DIRECT_DRAW_PATH, frames));
+	results.push_back(measure("per-object", mesh, objects, DIRECT_DRAW_PATH, frames));
+	results.push_back(measure("indirect-instanced", mesh, parts, INDIRECT_DRAW_PATH, frames));
+	results.push_back(measure("indirect-per-object", mesh, objects, INDIRECT_DRAW_PATH, frames));
+	
+	return results;
+    }
+    
+    // Every upload path over the same instances
+    vector<UploadBenchmarkResult> benchmarkUploads(Mesh& mesh, const vector<Instance>& instances, const vector<GLuint>& partCounts, int frames)
+    {
+	vector<UploadBenchmarkResult> results;
+	DrawBatch batch;
+	GLsizeiptr size = instances.size() * sizeof(Instance);
+	
+	addPartDraws(batch, mesh, partCounts, false);
+	
+	for(int mode = 0; mode < STREAM_MODE_COUNT; ++mode) {
+	    if(mode == PERSISTENT_STREAM && !getCapabilities().bufferStorage)
+		continue;
+	    
+	    StreamBuffer stream(gl::ARRAY_BUFFER, size, (StreamMode)mode);
+	    UploadBenchmarkResult result = {getStreamModeName((StreamMode)mode), size, 0.0, 0.0, 0.0, 0.0};
+	    
+	    gl::Finish();
+	    BenchmarkClock::time_point start = BenchmarkClock::now();
+	    
+	    for(int frame = 0; frame < frames; ++frame) {
+		BenchmarkClock::time_point uploadStart = BenchmarkClock::now();
+		
+		std::memcpy(stream.map(size), &instances[0], size);
+		mesh.setInstanceBuffer(stream.getBuffer(), stream.unmap());
+		
+		result.uploadTime += elapsed(uploadStart, BenchmarkClock::now());
+		
+		gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
+		batch.draw(mesh, DIRECT_DRAW_PATH);
+		stream.fence();
+	    }
+	    
+	    gl::Finish();
+	    
+	    if(frames > 0) {
+		result.frameTime = elapsed(start, BenchmarkClock::now()) / frames;
+		result.uploadTime /= frames;
+		result.waitTime = stream.getWaitTime() / frames;
+	    }
+	    
+	    if(result.uploadTime > 0.0)
+		result.megabytesPerSecond = size / (1024.0 * 1024.0) * 1000.0 / result.uploadTime;
+	    
+	    results.push_back(result);
+	}
+	
+	return results;
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<BenchmarkResult>& results)
+    {
+	out << std::left << std::setw(22) << "path"
+	    << std::right << std::setw(10) << "objects" << std::setw(10) << "commands" << std::setw(10) << "calls"
+	    << std::setw(12) << "submit ms" << std::setw(12) << "frame ms" << std::setw(14) << "objects/s" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const BenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(22) << result.name
+		<< std::right << std::setw(10) << result.objectsPerFrame << std::setw(10) << result.commandsPerFrame << std::setw(10) << result.callsPerFrame
+		<< std::fixed << std::setprecision(3)
+		<< std::setw(12) << result.submitTime << std::setw(12) << result.frameTime
+		<< std::setprecision(0) << std::setw(14) << result.objectsPerSecond << endl;
+	}
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<UploadBenchmarkResult>& results)
+    {
+	out << std::left << std::setw(18) << "upload"
+	    << std::right << std::setw(12) << "KiB/frame" << std::setw(12) << "upload ms" << std::setw(12) << "wait ms"
+	    << std::setw(12) << "frame ms" << std::setw(12) << "MiB/s" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const UploadBenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(18) << result.name
+		<< std::right << std::setw(12) << result.bytesPerFrame / 1024
+		<< std::fixed << std::setprecision(3)
+		<< std::setw(12) << result.uploadTime << std::setw(12) << result.waitTime << std::setw(12) << result.frameTime
+		<< std::setprecision(1) << std::setw(12) << result.megabytesPerSecond << endl;
+	}
+    }
+    
+    // Every culling kernel
+    vector<CullBenchmarkResult> benchmarkCulling(const CullingSet& set, const Frustum& frustum, int threadCount, int repeats)
+    {
+	vector<CullBenchmarkResult> results;
+	vector<GLuint> visible;
+	int threadCounts[2] = {1, threadCount};
+	
+	for(int isa = 0; isa < CULL_ISA_COUNT; ++isa) {
+	    if(!isCullISASupported((CullISA)isa))
+		continue;
+	    
+	    for(int shape = SPHERE_CULL; shape <= BOX_CULL; ++shape) {
+		for(int threads = 0; threads < (threadCount > 1 ? 2 : 1); ++threads) {
+		    CullBenchmarkResult result = {string(getCullISAName((CullISA)isa)) + (shape == SPHERE_CULL ? " sphere" : " box"),
+						  threadCounts[threads], set.size(), 0, 0.0, 0.0};
+		    
+		    // Best run, the others being noise from the rest of the system
+		    for(int repeat = 0; repeat < repeats; ++repeat) {
+			BenchmarkClock::time_point start = BenchmarkClock::now();
+			set.cull(frustum, (CullShape)shape, (CullISA)isa, visible, threadCounts[threads]);
+			double time = elapsed(start, BenchmarkClock::now());
+			
+			if(repeat == 0 || time < result.cullTime)
+			    result.cullTime = time;
+		    }
+		    
+		    result.visible = visible.size();
+		    
+		    if(result.cullTime > 0.0)
+			result.objectsPerMillisecond = result.objects / result.cullTime;
+		    
+		    results.push_back(result);
+		}
+	    }
+	}
+	
+	return results;
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<CullBenchmarkResult>& results)
+    {
+	out << std::left << std::setw(18) << "cull"
+	    << std::right << std::setw(10) << "threads" << std::setw(12) << "objects" << std::setw(12) << "visible"
+	    << std::setw(12) << "cull ms" << std::setw(14) << "objects/ms" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const CullBenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(18) << result.name
+		<< std::right << std::setw(10) << result.threads << std::setw(12) << result.objects << std::setw(12) << result.visible
+		<< std::fixed << std::setprecision(3) << std::setw(12) << result.cullTime
+		<< std::setprecision(0) << std::setw(14) << result.objectsPerMillisecond << endl;
+	}
+    }
+    
+    // Best of the repeats, in milliseconds
+    static double bestTime(const std::function<void()>& task, int repeats)
+    {
+	double best = 0.0;
+	
+	for(int repeat = 0; repeat < repeats; ++repeat) {
+	    BenchmarkClock::time_point start = BenchmarkClock::now();
+	    task();
+	    double time = elapsed(start, BenchmarkClock::now());
+	    
+	    if(repeat == 0 || time < best)
+		best = time;
+	}
+	
+	return best;
+    }
+    
+    // Doubling thread counts, then the maximum
+    vector<JobBenchmarkResult> benchmarkJobs(const CullingSet& set, const TransformSet& transforms, const Frustum& frustum, Mesh& mesh, const vector<Instance>& instances, const vector<GLuint>& partCounts, int maxThreads, int repeats)
+    {
+	vector<JobBenchmarkResult> results;
+	vector<int> threadCounts;
+	
+	for(int threads = 1; threads < maxThreads; threads *= 2)
+	    threadCounts.push_back(threads);
+	
+	threadCounts.push_back(maxThreads > 1 ? maxThreads : 1);
+	
+	vector<Instance> composed(transforms.size());
+	glm::quat spin = glm::angleAxis(1.0f, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+	vector<GLuint> visible;
+	DrawBatch batch;
+	double baseline[3] = {0.0, 0.0, 0.0};
+	
+	for(size_t curr = 0; curr < threadCounts.size(); ++curr) {
+	    JobSystem jobs(threadCounts[curr]);
+	    JobBenchmarkResult task[3] = {
+		{"compose", jobs.getThreadCount(), transforms.size(), 0.0, 1.0},
+		{"cull", jobs.getThreadCount(), set.size(), 0.0, 1.0},
+		{"commands", jobs.getThreadCount(), instances.size(), 0.0, 1.0}
+	    };
+	    
+	    task[0].time = bestTime([&]() {
+		    transforms.compose(composed.data(), composed.size(), spin, getBestCullISA(), jobs);
+		}, repeats);
+	    
+	    task[1].time = bestTime([&]() {
+		    set.cull(frustum, SPHERE_CULL, getBestCullISA(), visible, jobs);
+		}, repeats);
+	    
+	    task[2].time = bestTime([&]() {
+		    batch.clear();
+		    addPartDraws(batch, mesh, partCounts, true, &jobs);
+		}, repeats);
+	    
+	    for(int kind = 0; kind < 3; ++kind) {
+		if(curr == 0)
+		    baseline[kind] = task[kind].time;
+		
+		if(task[kind].time > 0.0)
+		    task[kind].speedup = baseline[kind] / task[kind].time;
+		
+		results.push_back(task[kind]);
+	    }
+	}
+	
+	return results;
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<JobBenchmarkResult>& results)
+    {
+	out << std::left << std::setw(18) << "job"
+	    << std::right << std::setw(10) << "threads" << std::setw(12) << "items"
+	    << std::setw(12) << "time ms" << std::setw(10) << "speedup" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const JobBenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(18) << result.name
+		<< std::right << std::setw(10) << result.threads << std::setw(12) << result.items
+		<< std::fixed << std::setprecision(3) << std::setw(12) << result.time
+		<< std::setprecision(2) << std::setw(10) << result.speedup << endl;
+	}
+    }
+    
+    // What the set replaces: glm matrices, one struct per instance
+    struct NaiveTransform
+    {
+	glm::vec3 position;
+	glm::quat rotation;
+	glm::vec3 scale;
+	GLubyte colour[4];
+    };
+    
+    // The glm loop first, then every kernel
+    vector<TransformBenchmarkResult> benchmarkTransforms(const TransformSet& set, const vector<Instance>& instances, JobSystem& jobs, int repeats)
+    {
+	vector<TransformBenchmarkResult> results;
+	vector<NaiveTransform> naive(set.size());
+	vector<Instance> composed(set.size());
+	glm::quat spin = glm::angleAxis(1.0f, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+	
+	for(size_t index = 0; index < naive.size(); ++index) {
+	    set.get(index, naive[index].position, naive[index].rotation, naive[index].scale);
+	    std::memcpy(naive[index].colour, instances[index].colour, sizeof(naive[index].colour));
+	}
+	
+	TransformBenchmarkResult result = {"glm aos", 1, set.size(), 0.0, 0.0, 1.0};
+	result.composeTime = bestTime([&]() {
+		for(size_t index = 0; index < naive.size(); ++index) {
+		    const NaiveTransform& from = naive[index];
+		    glm::mat4 model = glm::translate(glm::mat4(1.0f), from.position) * glm::mat4_cast(from.rotation * spin) * glm::scale(glm::mat4(1.0f), from.scale);
+		    
+		    std::memcpy(composed[index].transform, &model[0][0], sizeof(composed[index].transform));
+		    std::memcpy(composed[index].colour, from.colour, sizeof(from.colour));
+		    composed[index].phase = 0.0f;
+		}
+	    }, repeats);
+	
+	results.push_back(result);
+	double baseline = result.composeTime;
+	
+	for(int isa = 0; isa < CULL_ISA_COUNT; ++isa) {
+	    if(!isCullISASupported((CullISA)isa))
+		continue;
+	    
+	    for(int pooled = 0; pooled < (jobs.getThreadCount() > 1 ? 2 : 1); ++pooled) {
+		result.name = string(getCullISAName((CullISA)isa)) + " soa";
+		result.threads = pooled ? jobs.getThreadCount() : 1;
+		result.composeTime = bestTime([&]() {
+			if(pooled)
+			    set.compose(&composed[0], set.size(), spin, (CullISA)isa, jobs);
+			else
+			    set.compose(&composed[0], 0, set.size(), spin, (CullISA)isa);
+		    }, repeats);
+		
+		results.push_back(result);
+	    }
+	}
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    if(results[curr].composeTime > 0.0) {
+		results[curr].instancesPerMillisecond = results[curr].instances / results[curr].composeTime;
+		results[curr].speedup = baseline / results[curr].composeTime;
+	    }
+	}
+	
+	return results;
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<TransformBenchmarkResult>& results)
+    {
+	out << std::left << std::setw(18) << "transforms"
+	    << std::right << std::setw(10) << "threads" << std::setw(12) << "instances"
+	    << std::setw(12) << "compose ms" << std::setw(16) << "instances/ms" << std::setw(10) << "speedup" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const TransformBenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(18) << result.name
+		<< std::right << std::setw(10) << result.threads << std::setw(12) << result.instances
+		<< std::fixed << std::setprecision(3) << std::setw(12) << result.composeTime
+		<< std::setprecision(0) << std::setw(16) << result.instancesPerMillisecond
+		<< std::setprecision(2) << std::setw(10) << result.speedup << endl;
+	}
+    }
+    
+    // Traversal order first, then sorted
+    vector<QueueBenchmarkResult> benchmarkRenderQueue(Mesh& mesh, glslu::Program& program, const vector<GLuint>& partCounts, JobSystem& jobs, int frames)
+    {
+	vector<QueueBenchmarkResult> results;
+	RenderQueue queue;
+	std::mt19937 random(1);
+	
+	// Stand-ins for material textures, all plain white
+	const int textureCount = 4;
+	GLuint textures[textureCount];
+	
+	for(int texture = 0; texture < textureCount; ++texture)
+	    textures[texture] = createSolidTexture(255, 255, 255, 255);
+	
+	// The same draws, in the same order, for every variant
+	vector<RenderItem> items;
+	vector<float> depths;
+	GLuint firstInstance = 0;
+	
+	for(size_t part = 0; part < partCounts.size() && part < mesh.getPartCount(); ++part) {
+	    for(GLuint instance = 0; instance < partCounts[part]; ++instance) {
+		GLuint texture = random() % textureCount;
+		RenderItem item = {&program, &mesh, mesh.getPart(part), firstInstance++, 1, texture, textures[texture]};
+		
+		items.push_back(item);
+		depths.push_back((float)(random() % 1000));
+	    }
+	}
+	
+	queue.setDepthRange(0.0f, 1000.0f);
+	
+	for(int variant = 0; variant < (jobs.getThreadCount() > 1 ? 3 : 2); ++variant) {
+	    QueueBenchmarkResult result = {variant == 0 ? "traversal" : "radix sorted", variant == 2 ? jobs.getThreadCount() : 1, 0, 0.0, 0.0, 0, 0, 0};
+	    
+	    for(int frame = 0; frame < frames + 3; ++frame) {
+		queue.clear();
+		
+		for(size_t curr = 0; curr < items.size(); ++curr)
+		    queue.add(OPAQUE_PASS, items[curr], depths[curr]);
+		
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		
+		if(variant > 0)
+		    queue.sort(variant == 2 ? &jobs : NULL);
+		
+		BenchmarkClock::time_point sorted = BenchmarkClock::now();
+		
+		gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
+		RenderQueueStats stats = queue.submit();
+		
+		BenchmarkClock::time_point submitted = BenchmarkClock::now();
+		gl::Finish();
+		
+		// The first frames pay for driver validation
+		if(frame < 3)
+		    continue;
+		
+		result.sortTime += elapsed(start, sorted) / frames;
+		result.submitTime += elapsed(sorted, submitted) / frames;
+		result.draws = stats.draws;
+		result.programBinds = stats.programBinds;
+		result.textureBinds = stats.textureBinds;
+		result.materialChanges = stats.materialChanges;
+	    }
+	    
+	    results.push_back(result);
+	}
+	
+	gl::DeleteTextures(textureCount, textures);
+	
+	return results;
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<QueueBenchmarkResult>& results)
+    {
+	out << std::left << std::setw(18) << "queue"
+	    << std::right << std::setw(10) << "threads" << std::setw(10) << "draws"
+	    << std::setw(10) << "sort ms" << std::setw(12) << "submit ms"
+	    << std::setw(10) << "programs" << std::setw(10) << "textures" << std::setw(11) << "materials" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const QueueBenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(18) << result.name
+		<< std::right << std::setw(10) << result.threads << std::setw(10) << result.draws
+		<< std::fixed << std::setprecision(3) << std::setw(10) << result.sortTime << std::setw(12) << result.submitTime
+		<< std::setw(10) << result.programBinds << std::setw(10) << result.textureBinds << std::setw(11) << result.materialChanges << endl;
+	}
+    }
+    
+    // Generated files, removed again however the benchmark ends
+    struct TemporaryFiles
+    {
+	vector<string> filenames;
+	
+	~TemporaryFiles(void)
+	{
+	    for(size_t curr = 0; curr < filenames.size(); ++curr)
+		std::remove(filenames[curr].c_str());
+	}
+    };
+    
+    // The system's temporary directory, whatever the working one
+    static string getTemporaryDirectory(void)
+    {
+	const char* variables[] = {"TMPDIR", "TEMP", "TMP"};
+	
+	for(int curr = 0; curr < 3; ++curr) {
+	    const char* path = std::getenv(variables[curr]);
+	    
+	    if(path && *path)
+		return path;
+	}
+	
+#if defined(_WIN32)
+	return ".";
+#else
+	return "/tmp";
+#endif
+    }
+    
+    // Checks and gradients, different per image so nothing compresses away
+    static void writeTestTextures(TemporaryFiles& files, int count, int size)
+    {
+	string directory = getTemporaryDirectory();
+	vector<unsigned char> pixels((size_t)size * size * 4);
+	
+	for(int image = 0; image < count; ++image) {
+	    for(int y = 0; y < size; ++y) {
+		for(int x = 0; x < size; ++x) {
+		    unsigned char* pixel = &pixels[((size_t)y * size + x) * 4];
+		    bool check = ((x >> (4 + image % 3)) ^ (y >> (4 + image % 3))) & 1;
+		    
+		    pixel[0] = (unsigned char)(x * 255 / size);
+		    pixel[1] = (unsigned char)(y * 255 / size);
+		    pixel[2] = (unsigned char)(image * 64);
+		    pixel[3] = 255;
+		    
+		    if(check)
+			pixel[0] = pixel[1] = pixel[2] = 255 - pixel[2];
+		}
+	    }
+	    
+	    std::stringstream filename;
+	    filename << directory << "/forevercube_texture" << image << ".tga";
+	    files.filenames.push_back(filename.str());
+	    writeTga(filename.str(), &pixels[0], size, size);
+	}
+    }
+    
+    // Sleep out the rest of a 60 Hz frame
+    static void paceFrame(BenchmarkClock::time_point start)
+    {
+	std::this_thread::sleep_until(start + std::chrono::microseconds(16667));
+    }
+    
+    vector<TextureBenchmarkResult> benchmarkTextureLoading(const vector<string>& files, GLsizeiptr uploadBudget)
+    {
+	vector<TextureBenchmarkResult> results;
+	TemporaryFiles generated;
+	
+	if(files.empty())
+	    writeTestTextures(generated, 4, 1024);
+	
+	const vector<string>& filenames = files.empty() ? generated.filenames : files;
+	int count = (int)filenames.size();
+	
+	// One image a frame, decoded and uploaded on this thread
+	{
+	    TextureBenchmarkResult result = {"synchronous", count, 0, 0.0, 0.0, 0.0};
+	    vector<GLuint> textures(count, 0);
+	    vector<unsigned char> pixels;
+	    BenchmarkClock::time_point begin = BenchmarkClock::now();
+	    
+	    gl::GenTextures(count, &textures[0]);
+	    
+	    for(int curr = 0; curr < count; ++curr) {
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		int width, height;
+		
+		readTgaSize(filenames[curr], width, height);
+		pixels.resize((size_t)width * height * 4);
+		decodeTga(filenames[curr], &pixels[0], width, height);
+		
+		gl::BindTexture(gl::TEXTURE_2D, textures[curr]);
+		gl::TexImage2D(gl::TEXTURE_2D, 0, gl::RGBA8, width, height, 0, gl::RGBA, gl::UNSIGNED_BYTE, &pixels[0]);
+		gl::GenerateMipmap(gl::TEXTURE_2D);
+		gl::BindTexture(gl::TEXTURE_2D, 0);
+		gl::Finish();
+		
+		double frameTime = elapsed(start, BenchmarkClock::now());
+		result.maxFrameTime = std::max(result.maxFrameTime, frameTime);
+		result.frameTime += frameTime;
+		++result.frames;
+		
+		paceFrame(start);
+	    }
+	    
+	    result.loadTime = elapsed(begin, BenchmarkClock::now());
+	    result.frameTime /= result.frames;
+	    results.push_back(result);
+	    
+	    gl::DeleteTextures(count, &textures[0]);
+	}
+	
+	// Everything requested up front, streamed under the budget
+	{
+	    std::stringstream name;
+	    name << "streamed " << uploadBudget / 1024 << " KiB";
+	    
+	    TextureBenchmarkResult result = {name.str(), count, 0, 0.0, 0.0, 0.0};
+	    TextureStreamer streamer(32 << 20, uploadBudget);
+	    BenchmarkClock::time_point begin = BenchmarkClock::now();
+	    
+	    do {
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		
+		if(result.frames == 0)
+		    for(int curr = 0; curr < count; ++curr)
+			streamer.load(filenames[curr]);
+		
+		streamer.update();
+		gl::Finish();
+		
+		double frameTime = elapsed(start, BenchmarkClock::now());
+		result.maxFrameTime = std::max(result.maxFrameTime, frameTime);
+		result.frameTime += frameTime;
+		++result.frames;
+		
+		paceFrame(start);
+	    } while(streamer.getPendingCount() > 0);
+	    
+	    result.loadTime = elapsed(begin, BenchmarkClock::now());
+	    result.frameTime /= result.frames;
+	    results.push_back(result);
+	}
+	
+	return results;
+    }
+    
+    // Aligned table
+    void printBenchmarkResults(std::ostream& out, const vector<TextureBenchmarkResult>& results)
+    {
+	out << std::left << std::setw(20) << "textures"
+	    << std::right << std::setw(10) << "count" << std::setw(10) << "frames"
+	    << std::setw(12) << "load ms" << std::setw(16) << "worst frame ms" << std::setw(14) << "avg frame ms" << endl;
+	
+	for(size_t curr = 0; curr < results.size(); ++curr) {
+	    const TextureBenchmarkResult& result = results[curr];
+	    
+	    out << std::left << std::setw(20) << result.name
+		<< std::right << std::setw(10) << result.textures << std::setw(10) << result.frames
+		<< std::fixed << std::setprecision(3) << std::setw(12) << result.loadTime << std::setw(16) << result.maxFrameTime
+		<< std::setw(14) << result.frameTime << endl;
+	}
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef FOREVER_BENCHMARKS
+#define FOREVER_BENCHMARKS
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+#include "mesh.hpp"
+#include "culling.hpp"
+#include "transforms.hpp"
+#include "renderqueue.hpp"
+
+namespace forever
+{
+    class JobSystem;
+    
+    // One submission strategy, averaged over the measured frames
+    struct BenchmarkResult
+    {
+	std::string name;
+	GLuint objectsPerFrame;     // instances drawn
+	GLsizei commandsPerFrame;   // ranges of them queued
+	GLsizei callsPerFrame;      // GL draw calls made for them
+	double submitTime;          // CPU time issuing a frame, milliseconds
+	double frameTime;           // submit through glFinish, milliseconds
+	double objectsPerSecond;
+    };
+    
+    // Draw the scene frames times through each path: one instanced draw per
+    // part, one draw per object, and multi-draw-indirect over per-part and
+    // per-object commands. The caller binds the program and its uniforms.
+    std::vector<BenchmarkResult> benchmarkDrawPaths(Mesh& mesh, const std::vector<GLuint>& partCounts, int frames);
+    
+    void printBenchmarkResults(std::ostream& out, const std::vector<BenchmarkResult>& results);
+    
+    // One upload strategy, averaged over the measured frames
+    struct UploadBenchmarkResult
+    {
+	std::string name;
+	GLsizeiptr bytesPerFrame;
+	double uploadTime;          // CPU time mapping, writing and unmapping, milliseconds
+	double frameTime;           // upload and draw, through glFinish at the end
+	double waitTime;            // of uploadTime, blocked on region fences
+	double megabytesPerSecond;  // bytesPerFrame over uploadTime
+    };
+    
+    // Copy every instance into a StreamBuffer each frame, through each
+    // StreamMode the context supports, and draw from it so every strategy
+    // pays its real synchronisation cost. The caller binds the program and
+    // its uniforms.
+    std::vector<UploadBenchmarkResult> benchmarkUploads(Mesh& mesh, const std::vector<Instance>& instances, const std::vector<GLuint>& partCounts, int frames);
+    
+    void printBenchmarkResults(std::ostream& out, const std::vector<UploadBenchmarkResult>& results);
+    
+    // One culling kernel, shape and thread count, best of the repeats
+    struct CullBenchmarkResult
+    {
+	std::string name;
+	int threads;
+	size_t objects;
+	size_t visible;
+	double cullTime;            // milliseconds
+	double objectsPerMillisecond;
+    };
+    
+    // Cull the set against frustum with every supported kernel, both
+    // bounding shapes, on one thread and on threadCount.
+    std::vector<CullBenchmarkResult> benchmarkCulling(const CullingSet& set, const Frustum& frustum, int threadCount, int repeats);
+    
+    void printBenchmarkResults(std::ostream& out, const std::vector<CullBenchmarkResult>& results);
+    
+    // One per-frame CPU task on a job system of some size, best of the repeats
+    struct JobBenchmarkResult
+    {
+	std::string name;
+	int threads;
+	size_t items;
+	double time;                // milliseconds
+	double speedup;             // over the same task on one thread
+    };
+    
+    // Compose every streamed instance's spun transform from transforms, as
+    // a streamed frame does, cull the set against frustum and build one
+    // draw command per instance, on job systems of one thread up to
+    // maxThreads.
+    std::vector<JobBenchmarkResult> benchmarkJobs(const CullingSet& set, const TransformSet& transforms, const Frustum& frustum, Mesh& mesh, const std::vector<Instance>& instances, const std::vector<GLuint>& partCounts, int maxThreads, int repeats);
+    
+    void printBenchmarkResults(std::ostream& out, const std::vector<JobBenchmarkResult>& results);
+    
+    // One way of composing model matrices, best of the repeats
+    struct TransformBenchmarkResult
+    {
+	std::string name;
+	int threads;
+	size_t instances;
+	double composeTime;         // milliseconds
+	double instancesPerMillisecond;
+	double speedup;             // over the glm loop
+    };
+    
+    // Compose every instance's model matrix with a naive glm loop over an
+    // array of structs, then with each supported kernel over the set, on
+    // one thread and across jobs.
+    std::vector<TransformBenchmarkResult> benchmarkTransforms(const TransformSet& set, const std::vector<Instance>& instances, JobSystem& jobs, int repeats);
+    
+    void printBenchmarkResults(std::ostream& out, const std::vector<TransformBenchmarkResult>& results);
+    
+    // One submission order of a render queue, averaged over the frames
+    struct QueueBenchmarkResult
+    {
+	std::string name;
+	int threads;
+	GLsizei draws;
+	double sortTime;            // milliseconds
+	double submitTime;          // CPU time issuing the draws, milliseconds
+	int programBinds;
+	int textureBinds;
+	int materialChanges;
+    };
+    
+    // Queue one draw per instance, each with one of a few textures and a
+    // random depth, and submit it as queued, then radix sorted on one
+    // thread and across jobs. The caller binds the program's uniforms.
+    std::vector<QueueBenchmarkResult> benchmarkRenderQueue(Mesh& mesh, glslu::Program& program, const std::vector<GLuint>& partCounts, JobSystem& jobs, int frames);
+    
+    void printBenchmarkResults(std::ostream& out, const std::vector<QueueBenchmarkResult>& results);
+    
+    // One way of loading a set of textures, frames paced at 60 Hz
+    struct TextureBenchmarkResult
+    {
+	std::string name;
+	int textures;
+	int frames;                 // until every texture was complete
+	double loadTime;            // milliseconds, the same
+	double maxFrameTime;        // worst frame's loading work, milliseconds
+	double frameTime;           // average of the same
+    };
+    
+    // Load the TGA files one a frame with a synchronous decode, TexImage2D
+    // and GenerateMipmap, then all at once through a TextureStreamer with
+    // uploadBudget bytes a frame. Each frame's time includes a glFinish.
+    // Without files, a few are generated in the temporary directory and
+    // removed afterwards.
+    std::vector<TextureBenchmarkResult> benchmarkTextureLoading(const std::vector<std::string>& filenames, GLsizeiptr uploadBudget);
+    void printBenchmarkResults(std::ostream& out, const std::vector<TextureBenchmarkResult>& results);
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "capabilities.hpp"
+
+#include "gl_core_4_4.hpp"
+
+using std::string;
+
+namespace forever
+{
+    // Version comparison
+    bool glVersionAtLeast(int major, int minor)
+    {
+	int currentMajor = gl::sys::GetMajorVersion();
+	int currentMinor = gl::sys::GetMinorVersion();
+	
+	return currentMajor > major || (currentMajor == major && currentMinor >= minor);
+    }
+    
+    // Extension lookup
+    bool hasExtension(const string& name)
+    {
+	GLint extensionCount = 0;
+	gl::GetIntegerv(gl::NUM_EXTENSIONS, &extensionCount);
+	
+	for(GLint curr = 0; curr < extensionCount; ++curr) {
+	    const GLubyte* extension = gl::GetStringi(gl::EXTENSIONS, curr);
+	    
+	    if(extension && name == (const char*)extension)
+		return true;
+	}
+	
+	return false;
+    }
+    
+    // Lazily resolved capability set
+    const Capabilities& getCapabilities(void)
+    {
+	static bool resolved = false;
+	static Capabilities capabilities;
+	
+	if(!resolved) {
+	    capabilities.bufferStorage = glVersionAtLeast(4, 4) || hasExtension("GL_ARB_buffer_storage");
+	    capabilities.multiDrawIndirect = glVersionAtLeast(4, 3) || hasExtension("GL_ARB_multi_draw_indirect");
+	    capabilities.baseInstance = glVersionAtLeast(4, 2) || hasExtension("GL_ARB_base_instance");
+	    capabilities.textureStorage = glVersionAtLeast(4, 2) || hasExtension("GL_ARB_texture_storage");
+	    capabilities.computeShader = glVersionAtLeast(4, 3) || hasExtension("GL_ARB_compute_shader");
+	    capabilities.programInterface = glVersionAtLeast(4, 3) || hasExtension("GL_ARB_program_interface_query");
+	    capabilities.explicitUniformLocation = glVersionAtLeast(4, 3) || hasExtension("GL_ARB_explicit_uniform_location");
+	    capabilities.timerQuery = glVersionAtLeast(3, 3) || hasExtension("GL_ARB_timer_query");
+	    
+	    resolved = true;
+	}
+	
+	return capabilities;
+    }
+}
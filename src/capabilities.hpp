@@ -0,0 +1,31 @@
+#ifndef FOREVER_CAPABILITIES
+#define FOREVER_CAPABILITIES
+
+#include <string>
+
+namespace forever
+{
+    // Context version check; gl::sys::IsVersionGEQ compares the wrong way around
+    bool glVersionAtLeast(int major, int minor);
+    
+    // Extension check through GetStringi
+    bool hasExtension(const std::string& name);
+    
+    // Features the renderer picks paths on, resolved once after loading GL.
+    // Function pointers alone are not enough, drivers hand out stubs.
+    struct Capabilities
+    {
+	bool bufferStorage;            // 4.4 / ARB_buffer_storage
+	bool multiDrawIndirect;        // 4.3 / ARB_multi_draw_indirect
+	bool baseInstance;             // 4.2 / ARB_base_instance
+	bool textureStorage;           // 4.2 / ARB_texture_storage
+	bool computeShader;            // 4.3 / ARB_compute_shader
+	bool programInterface;         // 4.3 / ARB_program_interface_query
+	bool explicitUniformLocation;  // 4.3 / ARB_explicit_uniform_location
+	bool timerQuery;               // 3.3 / ARB_timer_query
+    };
+    
+    const Capabilities& getCapabilities(void);
+}
+
+#endif
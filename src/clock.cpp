@@ -0,0 +1,60 @@
+#include "clock.hpp"
+
+#include <cmath>
+
+namespace forever
+{
+    // Constructor
+    SimulationClock::SimulationClock(double rate, double maxCatchUp):
+	step(rate > 0.0 ? 1.0 / rate : 1.0 / 60.0), maxSteps(maxCatchUp * rate >= 1.0 ? (int)(maxCatchUp * rate) : 1),
+	lastTime(0.0), accumulator(0.0), simulationTime(0.0), tick(0), droppedTime(0.0), started(false)
+    {}
+    
+    // Restart
+    void SimulationClock::reset(double time)
+    {
+	lastTime = time;
+	accumulator = 0.0;
+	started = true;
+    }
+    
+    // Accumulate and pay out steps
+    int SimulationClock::advance(double time)
+    {
+	if(!started)
+	    reset(time);
+	
+	double elapsed = time - lastTime;
+	lastTime = time;
+	
+	// Clocks can step backwards across suspends
+	if(elapsed > 0.0)
+	    accumulator += elapsed;
+	
+	int steps = 0;
+	
+	while(accumulator >= step && steps < maxSteps) {
+	    accumulator -= step;
+	    simulationTime += step;
+	    ++tick;
+	    ++steps;
+	}
+	
+	// Too far behind, keep the fraction of a step for interpolation only
+	if(accumulator >= step) {
+	    double excess = accumulator - std::fmod(accumulator, step);
+	    
+	    droppedTime += excess;
+	    accumulator -= excess;
+	}
+	
+	return steps;
+    }
+    
+    // Accessors
+    double SimulationClock::getStep(void) const { return step; }
+    double SimulationClock::getAlpha(void) const { return accumulator / step; }
+    double SimulationClock::getSimulationTime(void) const { return simulationTime; }
+    long long SimulationClock::getTick(void) const { return tick; }
+    double SimulationClock::getDroppedTime(void) const { return droppedTime; }
+}
@@ -0,0 +1,54 @@
+#ifndef FOREVER_CLOCK
+#define FOREVER_CLOCK
+
+namespace forever
+{
+    // Fixed-timestep simulation clock.
+    //
+    // Each frame hands advance() the current time; the accumulated real time
+    // is paid out in whole steps of 1 / rate seconds, and getAlpha() says how
+    // far into the next step the frame is, for interpolating between the
+    // last two simulated states. Render stalls are caught up on in full, up
+    // to maxCatchUp seconds; anything longer (a breakpoint, a suspend) is
+    // dropped rather than simulated all at once.
+    class SimulationClock
+    {
+    private:
+	double step;
+	int maxSteps;           // maxCatchUp in steps
+	double lastTime;
+	double accumulator;
+	double simulationTime;
+	long long tick;
+	double droppedTime;
+	bool started;
+	
+    public:
+	SimulationClock(double rate = 60.0, double maxCatchUp = 1.0);
+	
+	// Restart the accumulator from time, e.g. after loading
+	void reset(double time);
+	
+	// Steps to simulate this frame
+	int advance(double time);
+	
+	double getStep(void) const;
+	double getAlpha(void) const;
+	
+	// Simulated seconds and steps since the start
+	double getSimulationTime(void) const;
+	long long getTick(void) const;
+	
+	// Real time skipped because frames fell too far behind
+	double getDroppedTime(void) const;
+    };
+    
+    // Linear blend of two simulated states
+    template<typename T>
+    T interpolate(const T& previous, const T& current, double alpha)
+    {
+	return previous + (current - previous) * alpha;
+    }
+}
+
+#endif
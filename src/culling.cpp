@@ -0,0 +1,371 @@
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "jobs.hpp"
+#include "profiler.hpp"
+
+// The SIMD kernels are compiled per function with target attributes, so the
+// rest of the build keeps its baseline flags and the CPU is asked at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FOREVER_CULL_X86 1
+#include <immintrin.h>
+#endif
+
+using std::vector;
+
+namespace forever
+{
+    // Plane extraction
+    Frustum extractFrustum(const glm::mat4& viewProjection)
+    {
+	Frustum frustum;
+	
+	// Row 3 plus or minus rows 0, 1 and 2, glm being column-major
+	for(int plane = 0; plane < 6; ++plane) {
+	    int row = plane / 2;
+	    float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+	    
+	    for(int column = 0; column < 4; ++column)
+		frustum.planes[plane][column] = viewProjection[column][3] + sign * viewProjection[column][row];
+	    
+	    float length = std::sqrt(frustum.planes[plane][0] * frustum.planes[plane][0] +
+				     frustum.planes[plane][1] * frustum.planes[plane][1] +
+				     frustum.planes[plane][2] * frustum.planes[plane][2]);
+	    
+	    if(length > 0.0f)
+		for(int column = 0; column < 4; ++column)
+		    frustum.planes[plane][column] /= length;
+	}
+	
+	return frustum;
+    }
+    
+    // Names for reports
+    const char* getCullISAName(CullISA isa)
+    {
+	switch(isa) {
+	case SCALAR_CULL:
+	    return "scalar";
+	    
+	case SSE_CULL:
+	    return "sse";
+	    
+	case AVX2_CULL:
+	    return "avx2";
+	    
+	default:
+	    return "unknown";
+	}
+    }
+    
+    // Build and CPU support
+    bool isCullISASupported(CullISA isa)
+    {
+	switch(isa) {
+	case SCALAR_CULL:
+	    return true;
+	    
+#ifdef FOREVER_CULL_X86
+	case SSE_CULL:
+	    return __builtin_cpu_supports("sse2");
+	    
+	case AVX2_CULL:
+	    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	    
+	default:
+	    return false;
+	}
+    }
+    
+    // Widest supported
+    CullISA getBestCullISA(void)
+    {
+	for(int isa = CULL_ISA_COUNT - 1; isa > SCALAR_CULL; --isa)
+	    if(isCullISASupported((CullISA)isa))
+		return (CullISA)isa;
+	
+	return SCALAR_CULL;
+    }
+    
+    // Array pointers handed to the kernels
+    struct BoundsArrays
+    {
+	const float* center[3];
+	const float* radius;
+	const float* min[3];
+	const float* max[3];
+    };
+    
+    // Push the set lanes of mask, skipping padding past end
+    static inline void appendMask(unsigned int mask, size_t base, size_t end, vector<GLuint>& visible)
+    {
+	while(mask) {
+	    size_t index = base + __builtin_ctz(mask);
+	    
+	    if(index < end)
+		visible.push_back((GLuint)index);
+	    
+	    mask &= mask - 1;
+	}
+    }
+    
+    // Reference kernel
+    static void cullScalar(const BoundsArrays& bounds, const Frustum& frustum, CullShape shape, size_t begin, size_t end, vector<GLuint>& visible)
+    {
+	for(size_t index = begin; index < end; ++index) {
+	    bool inside = true;
+	    
+	    for(int plane = 0; plane < 6 && inside; ++plane) {
+		const float* p = frustum.planes[plane];
+		float distance = p[3];
+		
+		if(shape == SPHERE_CULL) {
+		    for(int axis = 0; axis < 3; ++axis)
+			distance += p[axis] * bounds.center[axis][index];
+		    
+		    inside = distance >= -bounds.radius[index];
+		} else {
+		    // Corner of the box furthest along the plane normal
+		    for(int axis = 0; axis < 3; ++axis)
+			distance += p[axis] * (p[axis] > 0.0f ? bounds.max[axis][index] : bounds.min[axis][index]);
+		    
+		    inside = distance >= 0.0f;
+		}
+	    }
+	    
+	    if(inside)
+		visible.push_back((GLuint)index);
+	}
+    }
+    
+#ifdef FOREVER_CULL_X86
+    // Four instances at a time
+    __attribute__((target("sse2")))
+    static void cullSSE(const BoundsArrays& bounds, const Frustum& frustum, CullShape shape, size_t begin, size_t end, vector<GLuint>& visible)
+    {
+	for(size_t index = begin; index < end; index += 4) {
+	    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	    __m128 limit = _mm_setzero_ps();
+	    const float* axes[3];
+	    
+	    if(shape == SPHERE_CULL)
+		limit = _mm_sub_ps(limit, _mm_loadu_ps(bounds.radius + index));
+	    
+	    for(int plane = 0; plane < 6; ++plane) {
+		const float* p = frustum.planes[plane];
+		
+		// Spheres test their center, boxes the corner along the normal
+		for(int axis = 0; axis < 3; ++axis)
+		    axes[axis] = shape == SPHERE_CULL ? bounds.center[axis] : (p[axis] > 0.0f ? bounds.max[axis] : bounds.min[axis]);
+		
+		__m128 distance = _mm_set1_ps(p[3]);
+		distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p[0]), _mm_loadu_ps(axes[0] + index)));
+		distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p[1]), _mm_loadu_ps(axes[1] + index)));
+		distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(p[2]), _mm_loadu_ps(axes[2] + index)));
+		
+		inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, limit));
+	    }
+	    
+	    appendMask((unsigned int)_mm_movemask_ps(inside), index, end, visible);
+	}
+    }
+    
+    // Eight instances at a time
+    __attribute__((target("avx2,fma")))
+    static void cullAVX2(const BoundsArrays& bounds, const Frustum& frustum, CullShape shape, size_t begin, size_t end, vector<GLuint>& visible)
+    {
+	for(size_t index = begin; index < end; index += 8) {
+	    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+	    __m256 limit = _mm256_setzero_ps();
+	    const float* axes[3];
+	    
+	    if(shape == SPHERE_CULL)
+		limit = _mm256_sub_ps(limit, _mm256_loadu_ps(bounds.radius + index));
+	    
+	    for(int plane = 0; plane < 6; ++plane) {
+		const float* p = frustum.planes[plane];
+		
+		for(int axis = 0; axis < 3; ++axis)
+		    axes[axis] = shape == SPHERE_CULL ? bounds.center[axis] : (p[axis] > 0.0f ? bounds.max[axis] : bounds.min[axis]);
+		
+		__m256 distance = _mm256_set1_ps(p[3]);
+		distance = _mm256_fmadd_ps(_mm256_set1_ps(p[0]), _mm256_loadu_ps(axes[0] + index), distance);
+		distance = _mm256_fmadd_ps(_mm256_set1_ps(p[1]), _mm256_loadu_ps(axes[1] + index), distance);
+		distance = _mm256_fmadd_ps(_mm256_set1_ps(p[2]), _mm256_loadu_ps(axes[2] + index), distance);
+		
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, limit, _CMP_GE_OQ));
+	    }
+	    
+	    appendMask((unsigned int)_mm256_movemask_ps(inside), index, end, visible);
+	}
+    }
+#endif
+    
+    // Constructor
+    CullingSet::CullingSet(void):
+	count(0)
+    {}
+    
+    // Bounds from instance translations
+    void CullingSet::assign(const vector<Instance>& instances, float radius)
+    {
+	count = instances.size();
+	
+	// Padding lanes are culled by the index check, any value will do
+	size_t padded = (count + 7) / 8 * 8;
+	vector<float>* arrays[] = {&centerX, &centerY, &centerZ, &this->radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ};
+	
+	for(size_t array = 0; array < sizeof(arrays) / sizeof(arrays[0]); ++array)
+	    arrays[array]->assign(padded, 0.0f);
+	
+	for(size_t index = 0; index < count; ++index) {
+	    const float* translation = instances[index].transform + 12;
+	    
+	    centerX[index] = translation[0];
+	    centerY[index] = translation[1];
+	    centerZ[index] = translation[2];
+	    this->radius[index] = radius;
+	    
+	    minX[index] = translation[0] - radius;
+	    minY[index] = translation[1] - radius;
+	    minZ[index] = translation[2] - radius;
+	    maxX[index] = translation[0] + radius;
+	    maxY[index] = translation[1] + radius;
+	    maxZ[index] = translation[2] + radius;
+	}
+    }
+    
+    // Instance count
+    size_t CullingSet::size(void) const { return count; }
+    
+    // One contiguous range through the chosen kernel
+    void CullingSet::cullRange(const Frustum& frustum, CullShape shape, CullISA isa, size_t begin, size_t end, vector<GLuint>& visible) const
+    {
+	if(begin >= end)
+	    return;
+	
+	PROFILE_ZONE("cull range");
+	
+	BoundsArrays bounds = {
+	    {&centerX[0], &centerY[0], &centerZ[0]}, &radius[0],
+	    {&minX[0], &minY[0], &minZ[0]}, {&maxX[0], &maxY[0], &maxZ[0]}
+	};
+	
+	if(!isCullISASupported(isa))
+	    isa = SCALAR_CULL;
+	
+	switch(isa) {
+#ifdef FOREVER_CULL_X86
+	case SSE_CULL:
+	    cullSSE(bounds, frustum, shape, begin, end, visible);
+	    break;
+	    
+	case AVX2_CULL:
+	    cullAVX2(bounds, frustum, shape, begin, end, visible);
+	    break;
+#endif
+	    
+	default:
+	    cullScalar(bounds, frustum, shape, begin, end, visible);
+	    break;
+	}
+    }
+    
+    // Split over threads, then stitch the ranges back in order
+    void CullingSet::cull(const Frustum& frustum, CullShape shape, CullISA isa, vector<GLuint>& visible, int threadCount, size_t chunkSize) const
+    {
+	visible.clear();
+	
+	if(chunkSize < 8)
+	    chunkSize = 8;
+	
+	size_t rangeCount = (count + chunkSize - 1) / chunkSize;
+	
+	if(threadCount < 1)
+	    threadCount = 1;
+	
+	if(rangeCount > (size_t)threadCount)
+	    rangeCount = threadCount;
+	
+	if(rangeCount <= 1) {
+	    cullRange(frustum, shape, isa, 0, count, visible);
+	    return;
+	}
+	
+	// Ranges start on whole vectors
+	size_t rangeSize = ((count + rangeCount - 1) / rangeCount + 7) / 8 * 8;
+	vector< vector<GLuint> > results(rangeCount);
+	vector<std::thread> threads;
+	
+	for(size_t range = 1; range < rangeCount; ++range) {
+	    size_t begin = range * rangeSize;
+	    size_t end = begin + rangeSize < count ? begin + rangeSize : count;
+	    
+	    results[range].reserve(end > begin ? end - begin : 0);
+	    threads.push_back(std::thread(&CullingSet::cullRange, this, std::cref(frustum), shape, isa, begin, end, std::ref(results[range])));
+	}
+	
+	// The calling thread takes the first range
+	visible.reserve(count);
+	cullRange(frustum, shape, isa, 0, rangeSize < count ? rangeSize : count, visible);
+	
+	for(size_t thread = 0; thread < threads.size(); ++thread)
+	    threads[thread].join();
+	
+	for(size_t range = 1; range < rangeCount; ++range)
+	    visible.insert(visible.end(), results[range].begin(), results[range].end());
+    }
+    
+    // One job per chunk, stitched back in order
+    void CullingSet::cull(const Frustum& frustum, CullShape shape, CullISA isa, vector<GLuint>& visible, JobSystem& jobs, size_t chunkSize) const
+    {
+	visible.clear();
+	
+	// Chunks start on whole vectors
+	chunkSize = (std::max(chunkSize, (size_t)8) + 7) / 8 * 8;
+	size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+	
+	if(chunkCount <= 1 || jobs.getThreadCount() <= 1) {
+	    cullRange(frustum, shape, isa, 0, count, visible);
+	    return;
+	}
+	
+	vector< vector<GLuint> > results(chunkCount);
+	
+	jobs.parallelFor(0, chunkCount, 1, [&](size_t first, size_t last) {
+		for(size_t chunk = first; chunk < last; ++chunk) {
+		    size_t begin = chunk * chunkSize;
+		    size_t end = std::min(begin + chunkSize, count);
+		    
+		    results[chunk].reserve(end - begin);
+		    cullRange(frustum, shape, isa, begin, end, results[chunk]);
+		}
+	    });
+	
+	visible.reserve(count);
+	
+	for(size_t chunk = 0; chunk < chunkCount; ++chunk)
+	    visible.insert(visible.end(), results[chunk].begin(), results[chunk].end());
+    }
+    
+    // Per-part visible counts
+    void countVisibleParts(const vector<GLuint>& visible, const vector<GLuint>& partCounts, vector<GLuint>& visibleCounts)
+    {
+	visibleCounts.assign(partCounts.size(), 0);
+	
+	size_t part = 0;
+	GLuint partEnd = partCounts.empty() ? 0 : partCounts[0];
+	
+	for(size_t curr = 0; curr < visible.size(); ++curr) {
+	    while(part + 1 < partCounts.size() && visible[curr] >= partEnd)
+		partEnd += partCounts[++part];
+	    
+	    if(part < partCounts.size() && visible[curr] < partEnd)
+		++visibleCounts[part];
+	}
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef FOREVER_CULLING
+#define FOREVER_CULLING
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "gl_core_4_4.hpp"
+#include "mesh.hpp"
+
+namespace forever
+{
+    class JobSystem;
+    
+    // Six normalized planes, inside where dot(plane.xyz, p) + plane.w >= 0:
+    // left, right, bottom, top, near, far.
+    struct Frustum
+    {
+	float planes[6][4];
+    };
+    
+    // Planes of a combined view-projection matrix (Gribb and Hartmann)
+    Frustum extractFrustum(const glm::mat4& viewProjection);
+    
+    // Bounding volume tested
+    enum CullShape
+    {
+	SPHERE_CULL,
+	BOX_CULL
+    };
+    
+    // Instruction set the kernels run on
+    enum CullISA
+    {
+	SCALAR_CULL,
+	SSE_CULL,
+	AVX2_CULL,
+	CULL_ISA_COUNT
+    };
+    
+    const char* getCullISAName(CullISA isa);
+    
+    // Widest instruction set both the build and this CPU support
+    CullISA getBestCullISA(void);
+    bool isCullISASupported(CullISA isa);
+    
+    // Bounding spheres and axis-aligned boxes in structure-of-arrays
+    // layout, one entry per instance, padded to a whole number of 8-wide
+    // vectors so the kernels never need a remainder loop.
+    class CullingSet
+    {
+    private:
+	size_t count;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	
+	void cullRange(const Frustum& frustum, CullShape shape, CullISA isa, size_t begin, size_t end, std::vector<GLuint>& visible) const;
+	
+    public:
+	CullingSet(void);
+	
+	// Bounds of every instance: a sphere of radius around its
+	// translation, and the box around that sphere
+	void assign(const std::vector<Instance>& instances, float radius);
+	
+	size_t size(void) const;
+	
+	// Indices of every instance inside frustum, ascending, so instances
+	// grouped by mesh part stay grouped. Ranges of at least chunkSize
+	// instances are spread over up to threadCount threads.
+	void cull(const Frustum& frustum, CullShape shape, CullISA isa, std::vector<GLuint>& visible, int threadCount = 1, size_t chunkSize = 16384) const;
+	
+	// The same, as jobs of chunkSize instances on a job system
+	void cull(const Frustum& frustum, CullShape shape, CullISA isa, std::vector<GLuint>& visible, JobSystem& jobs, size_t chunkSize = 16384) const;
+    };
+    
+    // Count how many of the ascending indices fall in each part, with
+    // partCounts giving the instances per part as buildInstanceGrid does
+    void countVisibleParts(const std::vector<GLuint>& visible, const std::vector<GLuint>& partCounts, std::vector<GLuint>& visibleCounts);
+}
+
+#endif
@@ -96,6 +96,20 @@ static PROC WinGetProcAddress(const char *name)
 	#endif
 #endif
 
+/* Headless contexts resolve entry points through their own API */
+#if defined(GLSLU_USE_EGL)
+	#include <EGL/egl.h>
+	
+	#undef IntGetProcAddress
+	#define IntGetProcAddress(name) eglGetProcAddress(name)
+#elif defined(GLSLU_USE_OSMESA)
+	typedef void (*OSMESAproc)();
+	extern "C" OSMESAproc OSMesaGetProcAddress(const char* funcName);
+	
+	#undef IntGetProcAddress
+	#define IntGetProcAddress(name) OSMesaGetProcAddress(name)
+#endif
+
 namespace gl
 {
 	namespace exts
@@ -5,6 +5,14 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <dirent.h>
+
+#include "profiler.hpp"
+#include "json.hpp"
 
 #include <glm/glm.hpp>
 
@@ -14,6 +22,9 @@ using std::string;
 using std::setw;
 using std::endl;
 using std::stringstream;
+using std::vector;
+using std::map;
+using std::ostream;
 using glm::vec2;
 using glm::vec3;
 using glm::vec4;
@@ -43,32 +54,226 @@ namespace glslu
 	};
     }
     
+    namespace StatsInfo {
+	typedef std::chrono::steady_clock clock;
+	
+	vector<ProgramStats> programs;
+	
+	double millisecondsSince(clock::time_point start)
+	{
+	    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	}
+	
+	const char* stageName(ShaderType type)
+	{
+	    switch(type) {
+	    case VERTEX:          return "vertex";
+	    case FRAGMENT:        return "fragment";
+	    case GEOMETRY:        return "geometry";
+	    case TESS_CONTROL:    return "tess_control";
+	    case TESS_EVALUATION: return "tess_evaluation";
+	    case COMPUTE:         return "compute";
+	    default:              return "unknown";
+	    }
+	}
+	
+	// Quote a string for CSV output
+	string quoteCSV(const string& value)
+	{
+	    string quoted = "\"";
+	    
+	    for(size_t curr = 0; curr < value.size(); ++curr) {
+		if(value[curr] == '"')
+		    quoted += '"';
+		
+		quoted += value[curr];
+	    }
+	    
+	    return quoted + "\"";
+	}
+    }
+    
+    // Global statistics accessor
+    const vector<ProgramStats>& getProgramStats(void) { return StatsInfo::programs; }
+    
+    // One row per compile/link/validate step
+    void writeProgramStatsCSV(ostream& output)
+    {
+	const vector<ProgramStats>& programs = StatsInfo::programs;
+	
+	output << "program,stage,file,source_bytes,milliseconds,cache_hit" << endl;
+	
+	for(size_t program = 0; program < programs.size(); ++program) {
+	    const ProgramStats& stats = programs[program];
+	    string name = StatsInfo::quoteCSV(stats.name);
+	    
+	    for(size_t shader = 0; shader < stats.shaders.size(); ++shader) {
+		const ShaderStats& shaderStats = stats.shaders[shader];
+		
+		output << name << "," << StatsInfo::stageName(shaderStats.type) << "," << StatsInfo::quoteCSV(shaderStats.filename) << ","
+		       << shaderStats.sourceSize << "," << shaderStats.compileTime << "," << stats.cacheHit << endl;
+	    }
+	    
+	    output << name << ",link,," << "," << stats.linkTime << "," << stats.cacheHit << endl
+		   << name << ",validate,," << "," << stats.validateTime << "," << stats.cacheHit << endl;
+	}
+    }
+    
+    // Per-program breakdown along with the startup totals
+    void writeProgramStatsJSON(ostream& output)
+    {
+	const vector<ProgramStats>& programs = StatsInfo::programs;
+	double totalCompile = 0.0, totalLink = 0.0, totalValidate = 0.0;
+	
+	output << "{" << endl
+	       << "  \"programs\": [" << endl;
+	
+	for(size_t program = 0; program < programs.size(); ++program) {
+	    const ProgramStats& stats = programs[program];
+	    
+	    totalCompile += stats.compileTime;
+	    totalLink += stats.linkTime;
+	    totalValidate += stats.validateTime;
+	    
+	    output << "    {" << endl
+		   << "      \"name\": " << forever::quoteJson(stats.name) << "," << endl
+		   << "      \"compile_ms\": " << stats.compileTime << "," << endl
+		   << "      \"link_ms\": " << stats.linkTime << "," << endl
+		   << "      \"validate_ms\": " << stats.validateTime << "," << endl
+		   << "      \"cache_hit\": " << (stats.cacheHit ? "true" : "false") << "," << endl
+		   << "      \"shaders\": [";
+	    
+	    for(size_t shader = 0; shader < stats.shaders.size(); ++shader) {
+		const ShaderStats& shaderStats = stats.shaders[shader];
+		
+		output << (shader != 0 ? "," : "") << endl
+		       << "        {\"stage\": \"" << StatsInfo::stageName(shaderStats.type) << "\", "
+		       << "\"file\": " << forever::quoteJson(shaderStats.filename) << ", "
+		       << "\"source_bytes\": " << shaderStats.sourceSize << ", "
+		       << "\"compile_ms\": " << shaderStats.compileTime << "}";
+	    }
+	    
+	    output << endl
+		   << "      ]" << endl
+		   << "    }" << (program + 1 != programs.size() ? "," : "") << endl;
+	}
+	
+	output << "  ]," << endl
+	       << "  \"total_compile_ms\": " << totalCompile << "," << endl
+	       << "  \"total_link_ms\": " << totalLink << "," << endl
+	       << "  \"total_validate_ms\": " << totalValidate << "," << endl
+	       << "  \"total_ms\": " << (totalCompile + totalLink + totalValidate) << endl
+	       << "}" << endl;
+    }
+    
+    namespace BinaryInfo {
+	const char* magic = "GLSLU-BINARY 1";
+	
+	// Binaries are only valid for the driver that produced them
+	string driverString(void)
+	{
+	    const GLubyte* vendor = gl::GetString(gl::VENDOR);
+	    const GLubyte* renderer = gl::GetString(gl::RENDERER);
+	    const GLubyte* version = gl::GetString(gl::VERSION);
+	    
+	    stringstream buffer;
+	    buffer << (vendor ? (const char*)vendor : "") << " | "
+		   << (renderer ? (const char*)renderer : "") << " | "
+		   << (version ? (const char*)version : "");
+	    
+	    return buffer.str();
+	}
+    }
+    
+    // FNV-1a over the contents of every file, in name order so callers
+    // listing them differently still agree
+    string getSourceKey(const vector<string>& filenames)
+    {
+	vector<string> sorted(filenames);
+	std::sort(sorted.begin(), sorted.end());
+	
+	unsigned long long hash = 14695981039346656037ULL;
+	
+	for(size_t curr = 0; curr < sorted.size(); ++curr) {
+	    ifstream file(sorted[curr].c_str(), ios::in | ios::binary);
+	    char c;
+	    
+	    while(file.get(c)) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ULL;
+	    }
+	    
+	    // Separate files so moving text between them changes the key
+	    hash ^= 0xff;
+	    hash *= 1099511628211ULL;
+	}
+	
+	stringstream buffer;
+	buffer << std::hex << std::setfill('0') << std::setw(16) << hash;
+	
+	return buffer.str();
+    }
+    
+    // Collect shader files in a directory, keyed by their base name
+    map<string, vector<string> > findShaderPrograms(const string& directory)
+    {
+	map<string, vector<string> > programs;
+	int extensionCount = sizeof(ShaderInfo::extensions)/sizeof(ShaderInfo::shader_file_extension);
+	
+	DIR* dir = opendir(directory.c_str());
+	
+	if(!dir)
+	    return programs;
+	
+	while(struct dirent* entry = readdir(dir)) {
+	    string filename = entry->d_name;
+	    size_t location = filename.find_last_of('.');
+	    
+	    if(location == string::npos || location == 0)
+		continue;
+	    
+	    // Only keep files with a recognized shader extension
+	    string extension = filename.substr(location);
+	    
+	    for(int ext = 0; ext < extensionCount; ++ext) {
+		if(extension == ShaderInfo::extensions[ext].extension) {
+		    programs[filename.substr(0, location)].push_back(directory + "/" + filename);
+		    
+		    break;
+		}
+	    }
+	}
+	
+	closedir(dir);
+	
+	// Directory order is arbitrary, keep source keys stable
+	for(map<string, vector<string> >::iterator entry = programs.begin(); entry != programs.end(); ++entry)
+	    std::sort(entry->second.begin(), entry->second.end());
+	
+	return programs;
+    }
+    
     // Constructor
     Program::Program(void):
-	handle(0), linked(false) {}
+	handle(0), linked(false), retrievable(false), statsIndex(-1)
+    {
+	stats.compileTime = 0.0;
+	stats.linkTime = 0.0;
+	stats.validateTime = 0.0;
+	stats.cacheHit = false;
+    }
     
     // Deconstructor!
+    // Shaders are tracked as they are attached so no queries are needed here,
+    // and deletion goes through the current DeletionQueue when there is one.
     Program::~Program(void)
     {
 	if(handle == 0) return;
 	
-	// Query the attached shader count
-	GLint shaderCount = 0;
-	gl::GetProgramiv(handle, gl::ATTACHED_SHADERS, &shaderCount);
-	
-	// Query shader handles
-	GLuint* shaders = new GLuint[shaderCount];
-	gl::GetAttachedShaders(handle, shaderCount, NULL, shaders);
+	for(size_t current = 0; current < shaders.size(); ++current)
+	    releaseObject(SHADER_OBJECT, shaders[current]);
 	
-	// Delete and cleanup after each shader
-	for(int current = 0; current < shaderCount; ++current)
-	    gl::DeleteShader(shaders[current]);
-	
-	// Delete the program itself
-	gl::DeleteProgram(handle);
-	
-	// Cleanup
-	delete[] shaders;
+	releaseObject(PROGRAM_OBJECT, handle);
     }
     
     // Handle accessor
@@ -77,6 +282,26 @@ namespace glslu
     // Link accessor
     bool Program::isLinked(void) { return linked; }
     
+    // Build statistics accessor
+    const ProgramStats& Program::getStats(void) { return stats; }
+    
+    // Publish this program's statistics to the global list
+    void Program::recordStats(void)
+    {
+	if(stats.name.empty()) {
+	    stringstream name;
+	    name << "Program[" << handle << "]";
+	    stats.name = name.str();
+	}
+	
+	if(statsIndex < 0) {
+	    statsIndex = (int)StatsInfo::programs.size();
+	    StatsInfo::programs.push_back(stats);
+	} else {
+	    StatsInfo::programs[statsIndex] = stats;
+	}
+    }
+    
     // Get the location of a uniform based on its name
     int Program::getUniformLocation(const string& name)
     {
@@ -114,6 +339,92 @@ namespace glslu
 	return "";
     }
     
+    // Read a shader's info log
+    string Program::getShaderLog(GLuint shader)
+    {
+	int length = 0;
+	string log;
+	
+	gl::GetShaderiv(shader, gl::INFO_LOG_LENGTH, &length);
+	
+	if(length > 0) {
+	    char* c_log = new char[length];
+	    int written = 0;
+	    
+	    gl::GetShaderInfoLog(shader, length, &written, c_log);
+	    
+	    log = c_log;
+	    
+	    delete[] c_log;
+	}
+	
+	return log;
+    }
+    
+    // Read the program's info log
+    string Program::getProgramLog(void)
+    {
+	int length = 0;
+	string log;
+	
+	gl::GetProgramiv(handle, gl::INFO_LOG_LENGTH, &length);
+	
+	if(length > 0) {
+	    char* c_log = new char[length];
+	    int written = 0;
+	    
+	    gl::GetProgramInfoLog(handle, length, &written, c_log);
+	    
+	    log = c_log;
+	    
+	    delete[] c_log;
+	}
+	
+	return log;
+    }
+    
+    // Sampler/image type check
+    bool isOpaqueType(GLenum type)
+    {
+	switch(type) {
+	case gl::SAMPLER_1D:
+	case gl::SAMPLER_2D:
+	case gl::SAMPLER_3D:
+	case gl::SAMPLER_CUBE:
+	case gl::SAMPLER_1D_SHADOW:
+	case gl::SAMPLER_2D_SHADOW:
+	case gl::SAMPLER_1D_ARRAY:
+	case gl::SAMPLER_2D_ARRAY:
+	case gl::SAMPLER_2D_ARRAY_SHADOW:
+	case gl::SAMPLER_CUBE_SHADOW:
+	case gl::SAMPLER_CUBE_MAP_ARRAY:
+	case gl::SAMPLER_2D_MULTISAMPLE:
+	case gl::SAMPLER_2D_MULTISAMPLE_ARRAY:
+	case gl::SAMPLER_BUFFER:
+	case gl::SAMPLER_2D_RECT:
+	case gl::INT_SAMPLER_2D:
+	case gl::INT_SAMPLER_3D:
+	case gl::INT_SAMPLER_CUBE:
+	case gl::INT_SAMPLER_2D_ARRAY:
+	case gl::INT_SAMPLER_BUFFER:
+	case gl::UNSIGNED_INT_SAMPLER_2D:
+	case gl::UNSIGNED_INT_SAMPLER_3D:
+	case gl::UNSIGNED_INT_SAMPLER_CUBE:
+	case gl::UNSIGNED_INT_SAMPLER_2D_ARRAY:
+	case gl::UNSIGNED_INT_SAMPLER_BUFFER:
+	case gl::IMAGE_2D:
+	case gl::IMAGE_3D:
+	case gl::IMAGE_2D_ARRAY:
+	case gl::IMAGE_BUFFER:
+	case gl::INT_IMAGE_2D:
+	case gl::UNSIGNED_INT_IMAGE_2D:
+	case gl::UNSIGNED_INT_IMAGE_BUFFER:
+	    return true;
+	default:
+	    return false;
+	}
+    }
+    
     // String type translator
     string Program::getTypeString(GLenum type)
     {
@@ -123,13 +434,34 @@ namespace glslu
 	case gl::FLOAT_VEC3:   return "vec3"; break;
 	case gl::FLOAT_VEC4:   return "vec4"; break;
 	case gl::DOUBLE:       return "double"; break;
+	case gl::DOUBLE_VEC2:  return "dvec2"; break;
+	case gl::DOUBLE_VEC3:  return "dvec3"; break;
+	case gl::DOUBLE_VEC4:  return "dvec4"; break;
 	case gl::INT:          return "int"; break;
+	case gl::INT_VEC2:     return "ivec2"; break;
+	case gl::INT_VEC3:     return "ivec3"; break;
+	case gl::INT_VEC4:     return "ivec4"; break;
 	case gl::UNSIGNED_INT: return "unsigned int"; break;
+	case gl::UNSIGNED_INT_VEC2: return "uvec2"; break;
+	case gl::UNSIGNED_INT_VEC3: return "uvec3"; break;
+	case gl::UNSIGNED_INT_VEC4: return "uvec4"; break;
 	case gl::BOOL:         return "boolean"; break;
+	case gl::BOOL_VEC2:    return "bvec2"; break;
+	case gl::BOOL_VEC3:    return "bvec3"; break;
+	case gl::BOOL_VEC4:    return "bvec4"; break;
 	case gl::FLOAT_MAT2:   return "mat2"; break;
 	case gl::FLOAT_MAT3:   return "mat3"; break;
 	case gl::FLOAT_MAT4:   return "mat4"; break;
-	default:               return "???"; break;
+	case gl::FLOAT_MAT2x3: return "mat2x3"; break;
+	case gl::FLOAT_MAT2x4: return "mat2x4"; break;
+	case gl::FLOAT_MAT3x2: return "mat3x2"; break;
+	case gl::FLOAT_MAT3x4: return "mat3x4"; break;
+	case gl::FLOAT_MAT4x2: return "mat4x2"; break;
+	case gl::FLOAT_MAT4x3: return "mat4x3"; break;
+	case gl::DOUBLE_MAT2:  return "dmat2"; break;
+	case gl::DOUBLE_MAT3:  return "dmat3"; break;
+	case gl::DOUBLE_MAT4:  return "dmat4"; break;
+	default:               return isOpaqueType(type) ? "sampler/image" : "???"; break;
 	}
     }
     
@@ -225,6 +557,8 @@ namespace glslu
 	}
 	
 	// Create shader and attach source
+	PROFILE_ZONE("glslu compile");
+	StatsInfo::clock::time_point start = StatsInfo::clock::now();
 	GLuint shaderHandle = gl::CreateShader(type);
         
 	const char* c_source = source.c_str();
@@ -233,39 +567,40 @@ namespace glslu
 	// Compile the shader
 	gl::CompileShader(shaderHandle);
 	
-	// Check for compile errors
+	// Check for compile errors (the status query waits for the compile)
 	int status;
 	gl::GetShaderiv(shaderHandle, gl::COMPILE_STATUS, &status);
 	
+	// Account compile time, keeping any warnings the compiler produced
+	ShaderStats shaderStats;
+	shaderStats.filename = filename;
+	shaderStats.type = type;
+	shaderStats.sourceSize = source.size();
+	shaderStats.compileTime = StatsInfo::millisecondsSince(start);
+	shaderStats.log = getShaderLog(shaderHandle);
+	
+	stats.shaders.push_back(shaderStats);
+	stats.compileTime += shaderStats.compileTime;
+	
+	if(!filename.empty())
+	    stats.name += (stats.name.empty() ? "" : "+") + filename.substr(filename.find_last_of("/\\") + 1);
+	
 	if(status == gl::FALSE_) {
-	    int length = 0;
-	    string log;
 	    stringstream exceptionMessage;
 	    
-	    gl::GetShaderiv(shaderHandle, gl::INFO_LOG_LENGTH, &length);
-	    
-	    if(length > 0) {
-		char* c_log = new char[length];
-		int written = 0;
-		
-		gl::GetShaderInfoLog(shaderHandle, length, &written, c_log);
-		
-		log = c_log;
-		
-		delete[] c_log;
-	    }
-	    
 	    // Construct exception...
 	    if(filename != "")
 		exceptionMessage << "\"" << filename << "\" could not be compiled!";
 	    else
 		exceptionMessage << "Shader could not be compiled!";
 	    
-	    exceptionMessage << endl << log;
+	    exceptionMessage << endl << shaderStats.log;
 	    
 	    throw ProgramException(exceptionMessage.str());
-	} else
+	} else {
 	    gl::AttachShader(handle, shaderHandle);
+	    shaders.push_back(shaderHandle);
+	}
     }
     
     void Program::link(void)
@@ -275,40 +610,34 @@ namespace glslu
 	else if(handle <= 0)
 	    throw ProgramException("Program has not been initialized! (Have you attached shaders to it?)");
 	
+	// Ask the driver to keep the binary around for saveBinary()
+	if(retrievable)
+	    gl::ProgramParameteri(handle, gl::PROGRAM_BINARY_RETRIEVABLE_HINT, gl::TRUE_);
+	
 	// Linking is easy!
+	PROFILE_ZONE("glslu link");
+	StatsInfo::clock::time_point start = StatsInfo::clock::now();
 	gl::LinkProgram(handle);
 	
 	// Check link status
 	int status;
 	
 	gl::GetProgramiv(handle, gl::LINK_STATUS, &status);
+	stats.linkTime = StatsInfo::millisecondsSince(start);
+	stats.linkLog = getProgramLog();
+	recordStats();
 	
 	if(status == gl::FALSE_) {
-	    int length = 0;
-	    string log;
 	    stringstream exceptionMessage;
 	    
-	    gl::GetProgramiv(handle, gl::INFO_LOG_LENGTH, &length);
-	    
-	    if(length > 0) {
-		char* c_log = new char[length];
-		int written = 0;
-		
-		gl::GetProgramInfoLog(handle, length, &written, c_log);
-		
-		log = c_log;
-		
-		delete[] c_log;
-	    }
-	    
 	    // Construct exception message...
 	    exceptionMessage << "Could not link Program[" << handle << "]" << endl
-			     << log;
-		  
+			     << stats.linkLog;
 	    
 	    throw ProgramException(exceptionMessage.str());
 	} else {
 	    uniformLocations.clear();
+	    reflectUniforms();
 	    linked = true;
 	}
     }
@@ -321,31 +650,20 @@ namespace glslu
 	    throw ProgramException("Program has not been linked!");
 	
 	// Validate program
+	StatsInfo::clock::time_point start = StatsInfo::clock::now();
 	GLint status;
 	gl::ValidateProgram(handle);
 	gl::GetProgramiv(handle, gl::VALIDATE_STATUS, &status);
 	
+	stats.validateTime = StatsInfo::millisecondsSince(start);
+	recordStats();
+	
 	// Check validation status
 	if(status == gl::FALSE_) {
-	    // Get the program validation log
-	    int length = 0;
-	    string log;
 	    stringstream exceptionMessage;
 	    
-	    gl::GetProgramiv(handle, gl::INFO_LOG_LENGTH, &length);
-	    
-	    if(length > 0) {
-		char* c_log = new char[length];
-		int written = 0;
-		gl::GetProgramInfoLog(handle, length, &written, c_log);
-		
-		log = c_log;
-		
-		delete[] c_log;
-	    }
-	    
 	    exceptionMessage << "Program did not validate: " << endl
-			     << log;
+			     << getProgramLog();
 	    
 	    throw ProgramException(exceptionMessage.str());
 	}
@@ -363,12 +681,150 @@ namespace glslu
 	gl::UseProgram(handle);
     }
     
+    // Binaries can only be saved from programs linked with this set
+    void Program::setRetrievable(bool retrievable) { this->retrievable = retrievable; }
+    
+    // Try to skip compile and link by loading a saved program binary.
+    // Returns false on any cache miss (missing file, different key or driver,
+    // binary rejected); the program can then be built from source as usual.
+    bool Program::loadBinary(const string& filename, const string& key)
+    {
+	if(linked || !gl::ProgramBinary)
+	    return false;
+	
+	ifstream input(filename.c_str(), ios::in | ios::binary);
+	
+	if(!input)
+	    return false;
+	
+	// Header: magic, source key, driver, format and size
+	string magic, storedKey, storedDriver;
+	GLenum format = 0;
+	GLint length = 0;
+	
+	std::getline(input, magic);
+	std::getline(input, storedKey);
+	std::getline(input, storedDriver);
+	input >> format >> length;
+	input.ignore(1);
+	
+	if(!input || magic != BinaryInfo::magic || storedKey != key || storedDriver != BinaryInfo::driverString() || length <= 0)
+	    return false;
+	
+	vector<char> binary(length);
+	
+	if(!input.read(&binary[0], length))
+	    return false;
+	
+	// Create program if necessary.
+	if(handle <= 0) {
+	    handle = gl::CreateProgram();
+	    
+	    if(handle == 0)
+		return false;
+	}
+	
+	PROFILE_ZONE("glslu load binary");
+	StatsInfo::clock::time_point start = StatsInfo::clock::now();
+	gl::ProgramBinary(handle, format, &binary[0], length);
+	
+	int status;
+	gl::GetProgramiv(handle, gl::LINK_STATUS, &status);
+	
+	if(status == gl::FALSE_)
+	    return false;
+	
+	// Account the load as the link step of a cache hit
+	stats.linkTime = StatsInfo::millisecondsSince(start);
+	stats.cacheHit = true;
+	
+	if(stats.name.empty())
+	    stats.name = filename.substr(filename.find_last_of("/\\") + 1);
+	
+	recordStats();
+	
+	uniformLocations.clear();
+	reflectUniforms();
+	linked = true;
+	
+	return true;
+    }
+    
+    // Write the linked program's binary for later loadBinary() calls
+    void Program::saveBinary(const string& filename, const string& key)
+	throw(ProgramException)
+    {
+	if(!linked)
+	    throw ProgramException("Program has not been linked!");
+	else if(!gl::GetProgramBinary)
+	    throw ProgramException("Program binaries are not supported by this context.");
+	
+	GLint length = 0;
+	gl::GetProgramiv(handle, gl::PROGRAM_BINARY_LENGTH, &length);
+	
+	if(length <= 0)
+	    throw ProgramException("Program binary is empty! (Was setRetrievable(true) called before linking?)");
+	
+	vector<char> binary(length);
+	GLenum format = 0;
+	gl::GetProgramBinary(handle, length, NULL, &format, &binary[0]);
+	
+	std::ofstream output(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	
+	if(!output)
+	    throw ProgramException("Could not write program binary \"" + filename + "\"");
+	
+	output << BinaryInfo::magic << "\n"
+	       << key << "\n"
+	       << BinaryInfo::driverString() << "\n"
+	       << format << " " << length << "\n";
+	output.write(&binary[0], length);
+    }
+    
+    // Cached program loader
+    void loadProgram(Program& program, const vector<string>& filenames, const string& cacheFile)
+	throw(ProgramException)
+    {
+	string key = cacheFile.empty() ? "" : getSourceKey(filenames);
+	
+	if(!cacheFile.empty() && program.loadBinary(cacheFile, key))
+	    return;
+	
+	for(size_t curr = 0; curr < filenames.size(); ++curr)
+	    program.compileShader(filenames[curr]);
+	
+	program.setRetrievable(!cacheFile.empty());
+	program.link();
+	
+	// A cache that cannot be written only costs the next startup
+	if(!cacheFile.empty()) {
+	    try {
+		program.saveBinary(cacheFile, key);
+	    } catch(ProgramException&) {}
+	}
+    }
+    
     // Attrib Bind Location
     void Program::bindAttribLocation(GLuint location, const string& name) { gl::BindAttribLocation(handle, location, name.c_str()); }
     
     // Frag Data Bind Location
     void Program::bindFragDataLocation(GLuint location, const string& name) { gl::BindFragDataLocation(handle, location, name.c_str()); }
     
+    // Uniform block binding, which GLSL 3.30 cannot declare itself
+    void Program::setUniformBlockBinding(const string& name, GLuint binding)
+	throw(ProgramException)
+    {
+	if(!linked)
+	    throw ProgramException("Program has not been linked!");
+	
+	GLuint index = gl::GetUniformBlockIndex(handle, name.c_str());
+	
+	if(index == gl::INVALID_INDEX)
+	    throw ProgramException("No active uniform block named \"" + name + "\" (was it optimized out?)");
+	
+	gl::UniformBlockBinding(handle, index, binding);
+    }
+    
     // Set Uniform for boolean value.
     void Program::setUniform(const string& name, bool value)
     {
@@ -591,4 +1047,135 @@ namespace glslu
 	
 	return buffer.str();
     }	    
+    
+    // Query the full description of a single uniform by resource index
+    UniformInfo Program::queryUniformInfo(GLuint index)
+    {
+	GLenum properties[] = {gl::NAME_LENGTH, gl::TYPE, gl::LOCATION, gl::ARRAY_SIZE, gl::BLOCK_INDEX,
+			       gl::OFFSET, gl::ARRAY_STRIDE, gl::MATRIX_STRIDE, gl::IS_ROW_MAJOR};
+	GLint results[9];
+	gl::GetProgramResourceiv(handle, gl::UNIFORM, index, 9, properties, 9, NULL, results);
+	
+	// Read name
+	GLint nameLength = results[0] + 1;
+	char* name = new char[nameLength];
+	gl::GetProgramResourceName(handle, gl::UNIFORM, index, nameLength, NULL, name);
+	
+	UniformInfo info;
+	info.name = name;
+	info.type = results[1];
+	info.location = results[2];
+	info.arraySize = results[3];
+	info.blockIndex = results[4];
+	info.offset = results[5];
+	info.arrayStride = results[6];
+	info.matrixStride = results[7];
+	info.rowMajor = results[8] != 0;
+	
+	delete[] name;
+	
+	return info;
+    }
+    
+    // Cache type and location of every default-block uniform (GL 3.1 queries)
+    void Program::reflectUniforms(void)
+    {
+	activeUniforms.clear();
+	
+	GLint uniformCount = 0;
+	GLint maxLength = 0;
+	gl::GetProgramiv(handle, gl::ACTIVE_UNIFORMS, &uniformCount);
+	gl::GetProgramiv(handle, gl::ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	
+	vector<char> name(maxLength + 1);
+	
+	for(GLuint curr = 0; curr < (GLuint)uniformCount; ++curr) {
+	    GLint size = 0;
+	    GLint blockIndex = -1;
+	    GLenum type = 0;
+	    
+	    gl::GetActiveUniform(handle, curr, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+	    gl::GetActiveUniformsiv(handle, 1, &curr, gl::UNIFORM_BLOCK_INDEX, &blockIndex);
+	    
+	    // Block members have no location of their own
+	    if(blockIndex != -1) continue;
+	    
+	    UniformInfo info;
+	    info.name = &name[0];
+	    info.type = type;
+	    info.location = gl::GetUniformLocation(handle, &name[0]);
+	    info.arraySize = size;
+	    info.blockIndex = -1;
+	    info.offset = -1;
+	    info.arrayStride = 0;
+	    info.matrixStride = 0;
+	    info.rowMajor = false;
+	    
+	    activeUniforms[info.name] = info;
+	    
+	    // Arrays are reported as "name[0]", make them reachable as "name" too
+	    size_t length = info.name.size();
+	    
+	    if(length > 3 && info.name.compare(length - 3, 3, "[0]") == 0)
+		activeUniforms[info.name.substr(0, length - 3)] = info;
+	}
+    }
+    
+    // Reflect every active uniform of the program
+    vector<UniformInfo> Program::getUniformInfo(void)
+    {
+	vector<UniformInfo> uniforms;
+	
+	GLint uniformCount = 0;
+	gl::GetProgramInterfaceiv(handle, gl::UNIFORM, gl::ACTIVE_RESOURCES, &uniformCount);
+	
+	for(int curr = 0; curr < uniformCount; ++curr)
+	    uniforms.push_back(queryUniformInfo(curr));
+	
+	return uniforms;
+    }
+    
+    // Reflect every active uniform block along with its members
+    vector<UniformBlockInfo> Program::getUniformBlockInfo(void)
+    {
+	vector<UniformBlockInfo> blocks;
+	
+	GLint blockCount = 0;
+	gl::GetProgramInterfaceiv(handle, gl::UNIFORM_BLOCK, gl::ACTIVE_RESOURCES, &blockCount);
+	
+	GLenum blockProperties[] = {gl::NAME_LENGTH, gl::BUFFER_BINDING, gl::BUFFER_DATA_SIZE, gl::NUM_ACTIVE_VARIABLES};
+	GLenum blockIndex[] = {gl::ACTIVE_VARIABLES};
+	
+	for(int block = 0; block < blockCount; ++block) {
+	    GLint blockInfo[4];
+	    gl::GetProgramResourceiv(handle, gl::UNIFORM_BLOCK, block, 4, blockProperties, 4, NULL, blockInfo);
+	    
+	    // Get block name
+	    GLint blockNameLength = blockInfo[0] + 1;
+	    char* blockName = new char[blockNameLength];
+	    gl::GetProgramResourceName(handle, gl::UNIFORM_BLOCK, block, blockNameLength, NULL, blockName);
+	    
+	    UniformBlockInfo info;
+	    info.name = blockName;
+	    info.binding = blockInfo[1];
+	    info.dataSize = blockInfo[2];
+	    
+	    delete[] blockName;
+	    
+	    // Reflect each member of the block
+	    GLint uniformCount = blockInfo[3];
+	    
+	    if(uniformCount > 0) {
+		vector<GLint> uniformIndexes(uniformCount);
+		gl::GetProgramResourceiv(handle, gl::UNIFORM_BLOCK, block, 1, blockIndex, uniformCount, NULL, &uniformIndexes[0]);
+		
+		for(int uniform = 0; uniform < uniformCount; ++uniform)
+		    info.members.push_back(queryUniformInfo(uniformIndexes[uniform]));
+	    }
+	    
+	    blocks.push_back(info);
+	}
+	
+	return blocks;
+    }
 }
@@ -2,12 +2,16 @@
 #define GLSL_UTILITIES
 
 #include <stdexcept>
+#include <ostream>
 #include <string>
+#include <vector>
 #include <map>
 
 #include <glm/glm.hpp>
 
 #include "gl_core_4_4.hpp"
+#include "glslu_uniform.hpp"
+#include "glslu_deletion.hpp"
 
 namespace glslu
 {
@@ -27,15 +31,83 @@ namespace glslu
 	ProgramException(const std::string &msg): std::runtime_error(msg) {}
     };
     
+    // Reflected description of a single active uniform
+    struct UniformInfo
+    {
+	std::string name;
+	GLenum type;
+	GLint location;
+	GLint arraySize;
+	GLint blockIndex;
+	GLint offset;
+	GLint arrayStride;
+	GLint matrixStride;
+	bool rowMajor;
+    };
+    
+    // Reflected description of an active uniform block
+    struct UniformBlockInfo
+    {
+	std::string name;
+	GLint binding;
+	GLint dataSize;
+	std::vector<UniformInfo> members;
+    };
+    
+    // Build cost of a single shader stage
+    struct ShaderStats
+    {
+	std::string filename;
+	ShaderType type;
+	size_t sourceSize;
+	double compileTime;     // milliseconds, including the COMPILE_STATUS wait
+	std::string log;        // compiler output, warnings included
+    };
+    
+    // Accumulated build cost of a program
+    struct ProgramStats
+    {
+	std::string name;
+	std::vector<ShaderStats> shaders;
+	double compileTime;     // sum over shaders, milliseconds
+	double linkTime;
+	double validateTime;
+	bool cacheHit;          // loaded from a program binary instead of compiled
+	std::string linkLog;
+    };
+    
+    // Build statistics of every program linked so far, in link order
+    const std::vector<ProgramStats>& getProgramStats(void);
+    void writeProgramStatsCSV(std::ostream& output);
+    void writeProgramStatsJSON(std::ostream& output);
+    
+    // Key identifying a set of shader sources, used to invalidate program
+    // binaries; the same whatever order the files are listed in
+    std::string getSourceKey(const std::vector<std::string>& filenames);
+    
+    // Group the shader files of a directory into programs by base name
+    // (e.g. "cube.vert" and "cube.frag" both belong to "cube").
+    std::map<std::string, std::vector<std::string> > findShaderPrograms(const std::string& directory);
+    
     class Program
     {
     private:
 	int handle;
 	bool linked;
+	bool retrievable;
+	std::vector<GLuint> shaders;
 	std::map<std::string, int> uniformLocations;
+	std::map<std::string, UniformInfo> activeUniforms;
+	ProgramStats stats;
+	int statsIndex;
 	
 	// Minor helper functions for internals.
 	GLint getUniformLocation(const std::string& name);
+	UniformInfo queryUniformInfo(GLuint index);
+	void reflectUniforms(void);
+	void recordStats(void);
+	std::string getShaderLog(GLuint shader);
+	std::string getProgramLog(void);
 	bool fileExists(const std::string& filename);
 	std::string getExtension(const std::string& filename);
 	
@@ -51,6 +123,7 @@ namespace glslu
 	// Status functions
 	int getHandle(void);
 	bool isLinked(void);
+	const ProgramStats& getStats(void);
 	
 	// Compile functions
 	void compileShader(const std::string& filename) throw (ProgramException);
@@ -62,10 +135,18 @@ namespace glslu
 	void validate(void) throw (ProgramException);
 	void use(void) throw (ProgramException);
 	
+	// Program binary cache
+	void setRetrievable(bool retrievable);
+	bool loadBinary(const std::string& filename, const std::string& key = "");
+	void saveBinary(const std::string& filename, const std::string& key = "") throw (ProgramException);
+	
 	// Attribute handlers
 	void bindAttribLocation(GLuint location, const std::string& name);
 	void bindFragDataLocation(GLuint location, const std::string& name);
 	
+	// Point a uniform block at a UNIFORM_BUFFER binding, after linking
+	void setUniformBlockBinding(const std::string& name, GLuint binding) throw (ProgramException);
+	
 	// Uniform handlers
 	void setUniform(const std::string& name, bool value);
 	void setUniform(const std::string& name, int value);
@@ -80,14 +161,46 @@ namespace glslu
 	void setUniform(const std::string& name, const glm::mat3& matrix);
 	void setUniform(const std::string& name, const glm::mat4& matrix);
 	
+	// Typed uniform handles, checked against the reflected uniform type
+	template<typename T> Uniform<T> getUniform(const std::string& name) throw (ProgramException);
+	
 	// String functions
 	std::string getActiveUniforms(void);
 	std::string getActiveUniformBlocks(void);
 	std::string getActiveAttribs(void);
 	
+	// Reflection functions
+	std::vector<UniformInfo> getUniformInfo(void);
+	std::vector<UniformBlockInfo> getUniformBlockInfo(void);
+	
 	// Type helper
 	std::string getTypeString(GLenum type);
     };
+    
+    // Build a program from shader files, going through a binary cache file when
+    // one is given: a valid cached binary skips compilation entirely, otherwise
+    // the program is compiled, linked, and the binary written for next time.
+    void loadProgram(Program& program, const std::vector<std::string>& filenames, const std::string& cacheFile = "") throw (ProgramException);
+    
+    // Look up a typed handle for a default-block uniform of a linked program
+    template<typename T>
+    Uniform<T> Program::getUniform(const std::string& name)
+	throw(ProgramException)
+    {
+	if(!linked)
+	    throw ProgramException("Program has not been linked!");
+	
+	std::map<std::string, UniformInfo>::iterator info = activeUniforms.find(name);
+	
+	if(info == activeUniforms.end())
+	    throw ProgramException("No active uniform named \"" + name + "\" (was it optimized out?)");
+	
+	if(!UniformTraits<T>::accepts(info->second.type))
+	    throw ProgramException("Uniform \"" + name + "\" is declared " + getTypeString(info->second.type)
+				   + ", but was requested as " + getTypeString(UniformTraits<T>::glType()));
+	
+	return Uniform<T>(info->second.location, info->second.arraySize);
+    }
 }
 
 #endif
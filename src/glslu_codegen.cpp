@@ -0,0 +1,412 @@
+#include "glslu_codegen.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <sstream>
+
+using std::string;
+using std::vector;
+using std::set;
+using std::stringstream;
+using std::endl;
+
+namespace glslu
+{
+    namespace CodegenInfo {
+	// Mapping of a reflected GL type onto C++ and its uniform setter
+	struct type_mapping {
+	    GLenum type;
+	    const char* cppType;
+	    const char* setter;     // gl:: entry point taking (location, count, [transpose,] pointer)
+	    const char* pointer;    // expression yielding a pointer to the first component
+	    int columns;            // matrix columns (1 for non-matrices)
+	    int columnSize;         // bytes per column when tightly packed
+	};
+	
+	struct type_mapping types[] = {
+	    {gl::FLOAT,             "float",        "Uniform1fv",         "&value",       1, 4},
+	    {gl::FLOAT_VEC2,        "glm::vec2",    "Uniform2fv",         "&value[0]",    1, 8},
+	    {gl::FLOAT_VEC3,        "glm::vec3",    "Uniform3fv",         "&value[0]",    1, 12},
+	    {gl::FLOAT_VEC4,        "glm::vec4",    "Uniform4fv",         "&value[0]",    1, 16},
+	    {gl::DOUBLE,            "double",       "Uniform1dv",         "&value",       1, 8},
+	    {gl::DOUBLE_VEC2,       "glm::dvec2",   "Uniform2dv",         "&value[0]",    1, 16},
+	    {gl::DOUBLE_VEC3,       "glm::dvec3",   "Uniform3dv",         "&value[0]",    1, 24},
+	    {gl::DOUBLE_VEC4,       "glm::dvec4",   "Uniform4dv",         "&value[0]",    1, 32},
+	    {gl::INT,               "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::INT_VEC2,          "glm::ivec2",   "Uniform2iv",         "&value[0]",    1, 8},
+	    {gl::INT_VEC3,          "glm::ivec3",   "Uniform3iv",         "&value[0]",    1, 12},
+	    {gl::INT_VEC4,          "glm::ivec4",   "Uniform4iv",         "&value[0]",    1, 16},
+	    {gl::UNSIGNED_INT,      "GLuint",       "Uniform1uiv",        "&value",       1, 4},
+	    {gl::UNSIGNED_INT_VEC2, "glm::uvec2",   "Uniform2uiv",        "&value[0]",    1, 8},
+	    {gl::UNSIGNED_INT_VEC3, "glm::uvec3",   "Uniform3uiv",        "&value[0]",    1, 12},
+	    {gl::UNSIGNED_INT_VEC4, "glm::uvec4",   "Uniform4uiv",        "&value[0]",    1, 16},
+	    {gl::BOOL,              "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::BOOL_VEC2,         "glm::ivec2",   "Uniform2iv",         "&value[0]",    1, 8},
+	    {gl::BOOL_VEC3,         "glm::ivec3",   "Uniform3iv",         "&value[0]",    1, 12},
+	    {gl::BOOL_VEC4,         "glm::ivec4",   "Uniform4iv",         "&value[0]",    1, 16},
+	    {gl::FLOAT_MAT2,        "glm::mat2",    "UniformMatrix2fv",   "&value[0][0]", 2, 8},
+	    {gl::FLOAT_MAT3,        "glm::mat3",    "UniformMatrix3fv",   "&value[0][0]", 3, 12},
+	    {gl::FLOAT_MAT4,        "glm::mat4",    "UniformMatrix4fv",   "&value[0][0]", 4, 16},
+	    {gl::FLOAT_MAT2x3,      "glm::mat2x3",  "UniformMatrix2x3fv", "&value[0][0]", 2, 12},
+	    {gl::FLOAT_MAT2x4,      "glm::mat2x4",  "UniformMatrix2x4fv", "&value[0][0]", 2, 16},
+	    {gl::FLOAT_MAT3x2,      "glm::mat3x2",  "UniformMatrix3x2fv", "&value[0][0]", 3, 8},
+	    {gl::FLOAT_MAT3x4,      "glm::mat3x4",  "UniformMatrix3x4fv", "&value[0][0]", 3, 16},
+	    {gl::FLOAT_MAT4x2,      "glm::mat4x2",  "UniformMatrix4x2fv", "&value[0][0]", 4, 8},
+	    {gl::FLOAT_MAT4x3,      "glm::mat4x3",  "UniformMatrix4x3fv", "&value[0][0]", 4, 12},
+	    {gl::DOUBLE_MAT2,       "glm::dmat2",   "UniformMatrix2dv",   "&value[0][0]", 2, 16},
+	    {gl::DOUBLE_MAT3,       "glm::dmat3",   "UniformMatrix3dv",   "&value[0][0]", 3, 24},
+	    {gl::DOUBLE_MAT4,       "glm::dmat4",   "UniformMatrix4dv",   "&value[0][0]", 4, 32},
+	    {gl::SAMPLER_1D,        "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::SAMPLER_2D,        "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::SAMPLER_3D,        "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::SAMPLER_CUBE,      "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::SAMPLER_2D_SHADOW, "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::SAMPLER_2D_ARRAY,  "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::SAMPLER_BUFFER,    "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::INT_SAMPLER_2D,    "GLint",        "Uniform1iv",         "&value",       1, 4},
+	    {gl::UNSIGNED_INT_SAMPLER_2D, "GLint",  "Uniform1iv",         "&value",       1, 4},
+	    {gl::IMAGE_2D,          "GLint",        "Uniform1iv",         "&value",       1, 4}
+	};
+	
+	const type_mapping* findMapping(GLenum type)
+	{
+	    int typeCount = sizeof(types)/sizeof(type_mapping);
+	    
+	    for(int curr = 0; curr < typeCount; ++curr)
+		if(types[curr].type == type)
+		    return &types[curr];
+	    
+	    return NULL;
+	}
+	
+	// Strip the "[0]" GL appends to array uniform names
+	string baseName(const string& name)
+	{
+	    if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+		return name.substr(0, name.size() - 3);
+	    
+	    return name;
+	}
+	
+	bool byOffset(const UniformInfo& left, const UniformInfo& right) { return left.offset < right.offset; }
+	
+	// C++11 keywords and alternative tokens, none usable as a name
+	const char* keywords[] = {
+	    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break",
+	    "case", "catch", "char", "char16_t", "char32_t", "class", "compl", "const", "const_cast",
+	    "constexpr", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast",
+	    "else", "enum", "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+	    "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+	    "nullptr", "operator", "or", "or_eq", "private", "protected", "public", "register",
+	    "reinterpret_cast", "return", "short", "signed", "sizeof", "static", "static_assert",
+	    "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true",
+	    "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+	    "volatile", "wchar_t", "while", "xor", "xor_eq"
+	};
+	
+	bool isKeyword(const string& identifier)
+	{
+	    int keywordCount = sizeof(keywords)/sizeof(const char*);
+	    
+	    for(int curr = 0; curr < keywordCount; ++curr)
+		if(identifier == keywords[curr])
+		    return true;
+	    
+	    return false;
+	}
+	
+	// Take an identifier in one scope of the header, two GLSL names that
+	// come out the same cannot both have it
+	void claim(set<string>& scope, const string& identifier, const string& name, const string& scopeName)
+	    throw(ProgramException)
+	{
+	    if(!scope.insert(identifier).second)
+		throw ProgramException(scopeName + ": \"" + name + "\" would be generated as \"" + identifier + "\", which is already taken");
+	}
+	
+	// Next "_padN" a member has not taken
+	string padName(set<string>& scope, int& padding)
+	{
+	    string name;
+	    
+	    do {
+		stringstream buffer;
+		buffer << "_pad" << padding++;
+		name = buffer.str();
+	    } while(!scope.insert(name).second);
+	    
+	    return name;
+	}
+    }
+    
+    // Turn an arbitrary GLSL name ("light.color", "bones[0]") into an
+    // identifier, keywords get a trailing underscore ("default_")
+    string toIdentifier(const string& name)
+    {
+	string identifier;
+	
+	for(size_t curr = 0; curr < name.size(); ++curr) {
+	    char c = name[curr];
+	    identifier += (isalnum((unsigned char)c) || c == '_') ? c : '_';
+	}
+	
+	if(identifier.empty() || isdigit((unsigned char)identifier[0]))
+	    identifier = "_" + identifier;
+	
+	if(CodegenInfo::isKeyword(identifier))
+	    identifier += "_";
+	
+	return identifier;
+    }
+    
+    // Turn a file base name ("cube_lit") into a type name ("CubeLit")
+    string toTypeName(const string& name)
+    {
+	string typeName;
+	bool upper = true;
+	
+	for(size_t curr = 0; curr < name.size(); ++curr) {
+	    char c = name[curr];
+	    
+	    if(!isalnum((unsigned char)c)) {
+		upper = true;
+		continue;
+	    }
+	    
+	    typeName += upper ? (char)toupper((unsigned char)c) : c;
+	    upper = false;
+	}
+	
+	if(typeName.empty() || isdigit((unsigned char)typeName[0]))
+	    typeName = "Program" + typeName;
+	
+	return typeName;
+    }
+    
+    // Generate the uniform accessor/block header for a linked program
+    string generateProgramHeader(Program& program, const string& programName, const vector<string>& sources)
+	throw(ProgramException)
+    {
+	using CodegenInfo::type_mapping;
+	
+	stringstream buffer;
+	string typeName = toTypeName(programName) + "Program";
+	string guard = "GLSLU_GENERATED_" + toIdentifier(programName);
+	
+	std::transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+	
+	// Preamble
+	buffer << "// Generated by glslu-reflect from:" << endl;
+	
+	for(size_t curr = 0; curr < sources.size(); ++curr)
+	    buffer << "//     " << sources[curr] << endl;
+	
+	buffer << "// Do not edit; regenerate by rebuilding." << endl
+	       << "#ifndef " << guard << endl
+	       << "#define " << guard << endl
+	       << endl
+	       << "#include <cstddef>" << endl
+	       << "#include <string>" << endl
+	       << endl
+	       << "#include <glm/glm.hpp>" << endl
+	       << endl
+	       << "#include \"glslu.hpp\"" << endl
+	       << endl
+	       << "namespace glslu" << endl
+	       << "{" << endl
+	       << "    namespace programs" << endl
+	       << "    {" << endl
+	       << "\tstruct " << typeName << endl
+	       << "\t{" << endl;
+	
+	// Nested names share the program struct with verify() and may not
+	// repeat the struct's own name
+	set<string> programScope;
+	programScope.insert(typeName);
+	programScope.insert("verify");
+	
+	// Default-block uniform accessors
+	vector<UniformInfo> uniforms = program.getUniformInfo();
+	vector<UniformInfo> accessible;
+	
+	for(size_t curr = 0; curr < uniforms.size(); ++curr) {
+	    const UniformInfo& uniform = uniforms[curr];
+	    
+	    if(uniform.blockIndex != -1 || uniform.location < 0)
+		continue;
+	    
+	    const type_mapping* mapping = CodegenInfo::findMapping(uniform.type);
+	    string name = CodegenInfo::baseName(uniform.name);
+	    
+	    if(!mapping) {
+		buffer << "\t    // Uniform \"" << name << "\" has an unsupported type (" << program.getTypeString(uniform.type) << ")" << endl
+		       << endl;
+		continue;
+	    }
+	    
+	    bool matrix = mapping->columns > 1;
+	    CodegenInfo::claim(programScope, toIdentifier(name), name, typeName);
+	    accessible.push_back(uniform);
+	    
+	    buffer << "\t    // " << mapping->cppType << " " << name;
+	    
+	    if(uniform.arraySize > 1)
+		buffer << "[" << uniform.arraySize << "]";
+	    
+	    buffer << endl
+		   << "\t    struct " << toIdentifier(name) << endl
+		   << "\t    {" << endl
+		   << "\t\tstatic constexpr GLint location = " << uniform.location << ";" << endl
+		   << "\t\tstatic constexpr GLint size = " << uniform.arraySize << ";" << endl
+		   << "\t\t" << endl;
+	    
+	    // C++ bools are widened explicitly, everything else is passed by pointer
+	    if(uniform.type == gl::BOOL)
+		buffer << "\t\tstatic void set(bool value) { gl::Uniform1i(location, value ? 1 : 0); }" << endl;
+	    else
+		buffer << "\t\tstatic void set(const " << mapping->cppType << "& value) { gl::" << mapping->setter
+		       << "(location, 1, " << (matrix ? "gl::FALSE_, " : "") << mapping->pointer << "); }" << endl;
+	    
+	    if(uniform.arraySize > 1) {
+		string pointer = mapping->pointer;
+		pointer.replace(pointer.find("value"), 5, "values[0]");
+		
+		buffer << "\t\tstatic void set(const " << mapping->cppType << "* values, GLsizei count) { gl::" << mapping->setter
+		       << "(location, count, " << (matrix ? "gl::FALSE_, " : "") << pointer << "); }" << endl;
+	    }
+	    
+	    buffer << "\t\ttemplate<typename T> static void set(const T&) = delete;" << endl
+		   << "\t    };" << endl
+		   << "\t    " << endl;
+	}
+	
+	// Uniform block layouts
+	vector<UniformBlockInfo> blocks = program.getUniformBlockInfo();
+	
+	for(size_t block = 0; block < blocks.size(); ++block) {
+	    UniformBlockInfo& info = blocks[block];
+	    string blockType = toIdentifier(info.name);
+	    int padding = 0;
+	    GLint cursor = 0;
+	    
+	    std::sort(info.members.begin(), info.members.end(), CodegenInfo::byOffset);
+	    CodegenInfo::claim(programScope, blockType, info.name, typeName);
+	    
+	    // Members first, so padding cannot take a member's name
+	    set<string> blockScope;
+	    blockScope.insert(blockType);
+	    blockScope.insert("binding");
+	    
+	    for(size_t curr = 0; curr < info.members.size(); ++curr) {
+		string name = CodegenInfo::baseName(info.members[curr].name);
+		
+		if(name.compare(0, info.name.size() + 1, info.name + ".") == 0)
+		    name = name.substr(info.name.size() + 1);
+		
+		CodegenInfo::claim(blockScope, toIdentifier(name), name, typeName + "::" + blockType);
+	    }
+	    
+	    buffer << "\t    // Uniform block \"" << info.name << "\" (std140, " << info.dataSize << " bytes)" << endl
+		   << "\t    struct " << blockType << endl
+		   << "\t    {" << endl
+		   << "\t\tstatic constexpr GLuint binding = " << info.binding << ";" << endl
+		   << "\t\t" << endl;
+	    
+	    for(size_t curr = 0; curr < info.members.size(); ++curr) {
+		const UniformInfo& member = info.members[curr];
+		const type_mapping* mapping = CodegenInfo::findMapping(member.type);
+		string name = CodegenInfo::baseName(member.name);
+		
+		// Strip the block instance prefix ("Block.member")
+		if(name.compare(0, info.name.size() + 1, info.name + ".") == 0)
+		    name = name.substr(info.name.size() + 1);
+		
+		// Pad up to the reflected offset
+		if(member.offset > cursor)
+		    buffer << "\t\tGLubyte " << CodegenInfo::padName(blockScope, padding) << "[" << (member.offset - cursor) << "];" << endl;
+		
+		// Work out whether the natural C++ layout matches std140
+		GLint elementSize = mapping ? mapping->columns * mapping->columnSize : 0;
+		bool natural = mapping != NULL && !member.rowMajor;
+		
+		if(natural && mapping->columns > 1 && member.matrixStride != mapping->columnSize)
+		    natural = false;
+		else if(natural && member.arraySize > 1 && member.arrayStride != elementSize)
+		    natural = false;
+		
+		GLint extent;
+		
+		if(natural) {
+		    extent = elementSize * member.arraySize;
+		    
+		    buffer << "\t\t" << mapping->cppType << " " << toIdentifier(name);
+		    
+		    if(member.arraySize > 1)
+			buffer << "[" << member.arraySize << "]";
+		    
+		    buffer << ";";
+		} else {
+		    // Raw storage for layouts glm cannot express (vec3 arrays, mat3, row-major, ...)
+		    GLint element = (member.arrayStride > 0 ? member.arrayStride :
+				     (mapping && mapping->columns > 1 ? mapping->columns * member.matrixStride : elementSize));
+		    
+		    extent = element * (member.arraySize > 0 ? member.arraySize : 1);
+		    
+		    buffer << "\t\tGLubyte " << toIdentifier(name) << "[" << extent << "];";
+		}
+		
+		buffer << " // offset " << member.offset << ", " << program.getTypeString(member.type);
+		
+		if(!natural)
+		    buffer << " (raw std140 storage)";
+		
+		buffer << endl;
+		
+		cursor = member.offset + extent;
+	    }
+	    
+	    if(info.dataSize > cursor)
+		buffer << "\t\tGLubyte " << CodegenInfo::padName(blockScope, padding) << "[" << (info.dataSize - cursor) << "];" << endl;
+	    
+	    buffer << "\t    };" << endl
+		   << "\t    " << endl
+		   << "\t    static_assert(sizeof(" << blockType << ") == " << info.dataSize
+		   << ", \"" << info.name << " does not match its std140 layout\");" << endl;
+	    
+	    for(size_t curr = 0; curr < info.members.size(); ++curr) {
+		string name = CodegenInfo::baseName(info.members[curr].name);
+		
+		if(name.compare(0, info.name.size() + 1, info.name + ".") == 0)
+		    name = name.substr(info.name.size() + 1);
+		
+		buffer << "\t    static_assert(offsetof(" << blockType << ", " << toIdentifier(name) << ") == " << info.members[curr].offset
+		       << ", \"" << info.name << "." << name << " is misplaced\");" << endl;
+	    }
+	    
+	    buffer << "\t    " << endl;
+	}
+	
+	// Runtime check that the driver assigned the same locations
+	buffer << "\t    // Check the generated locations against a program linked at runtime." << endl
+	       << "\t    // Use explicit layout(location = N) qualifiers to make this hold everywhere." << endl
+	       << "\t    static void verify(Program& program)" << endl
+	       << "\t    {" << endl;
+	
+	for(size_t curr = 0; curr < accessible.size(); ++curr) {
+	    string name = CodegenInfo::baseName(accessible[curr].name);
+	    
+	    buffer << "\t\tif(gl::GetUniformLocation(program.getHandle(), \"" << name << "\") != " << toIdentifier(name) << "::location)" << endl
+		   << "\t\t    throw ProgramException(\"" << typeName << ": uniform \\\"" << name << "\\\" moved since generation\");" << endl;
+	}
+	
+	buffer << "\t    }" << endl
+	       << "\t};" << endl
+	       << "    }" << endl
+	       << "}" << endl
+	       << endl
+	       << "#endif" << endl;
+	
+	return buffer.str();
+    }
+}
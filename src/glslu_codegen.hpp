@@ -0,0 +1,26 @@
+#ifndef GLSL_UTILITIES_CODEGEN
+#define GLSL_UTILITIES_CODEGEN
+
+#include <string>
+#include <vector>
+
+#include "glslu.hpp"
+
+namespace glslu
+{
+    // Generate a C++ header describing a linked program's interface.
+    //
+    // The header contains a struct per program with one nested accessor per
+    // default-block uniform (constant location, typed set()) and a std140
+    // layout struct per uniform block. Setting a uniform through an accessor
+    // is a single gl::Uniform* call on the currently bound program. Throws
+    // when two GLSL names would share one C++ identifier.
+    std::string generateProgramHeader(Program& program, const std::string& programName,
+				      const std::vector<std::string>& sources) throw(ProgramException);
+    
+    // Helpers for building C++ identifiers from GLSL/file names
+    std::string toIdentifier(const std::string& name);
+    std::string toTypeName(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdlib>
+
+#include "gl_core_4_4.hpp"
+
+#include "glslu.hpp"
+#include "headless.hpp"
+
+#define ERRLOG(errstr) std::cerr << "ERR [" << __FILE__ << ":" << __LINE__ << "] " << errstr << std::endl;
+
+using namespace std;
+
+// Indent every line of a driver log for the console
+static string indent(const string& log)
+{
+    stringstream input(log), output;
+    string line;
+    
+    while(getline(input, line))
+	if(!line.empty())
+	    output << "\t\t" << line << endl;
+    
+    return output.str();
+}
+
+static void usage(const char* name)
+{
+    cerr << "Usage: " << name << " [options] <shader directory>" << endl
+	 << "\t--cache <dir>     write program binaries to <dir>/<program>.bin" << endl
+	 << "\t--reflect <dir>   write active resources to <dir>/<program>.txt" << endl
+	 << "\t--json <file>     write the timing report as JSON" << endl
+	 << "\t--csv <file>      write the timing report as CSV" << endl
+	 << "\t--max-ms <ms>     fail if any program takes longer to build" << endl
+	 << "\t--gl <M.m>        context version to compile against (default 4.3)" << endl;
+}
+
+// glslu-compile: build every program of a shader directory offline, report
+// per-stage timings and warnings, and optionally prime the binary cache.
+int main(int argc, char* argv[])
+{
+    string shaderDirectory, cacheDirectory, reflectDirectory, jsonFile, csvFile;
+    double maxMilliseconds = 0.0;
+    int major = 4, minor = 3;
+    
+    // Parse options
+    for(int arg = 1; arg < argc; ++arg) {
+	string option = argv[arg];
+	bool hasValue = arg + 1 < argc;
+	
+	if(option == "--cache" && hasValue)
+	    cacheDirectory = argv[++arg];
+	else if(option == "--reflect" && hasValue)
+	    reflectDirectory = argv[++arg];
+	else if(option == "--json" && hasValue)
+	    jsonFile = argv[++arg];
+	else if(option == "--csv" && hasValue)
+	    csvFile = argv[++arg];
+	else if(option == "--max-ms" && hasValue)
+	    maxMilliseconds = atof(argv[++arg]);
+	else if(option == "--gl" && hasValue) {
+	    char dot;
+	    stringstream version(argv[++arg]);
+	    version >> major >> dot >> minor;
+	} else if(option[0] != '-' && shaderDirectory.empty())
+	    shaderDirectory = option;
+	else {
+	    usage(argv[0]);
+	    return -1;
+	}
+    }
+    
+    if(shaderDirectory.empty()) {
+	usage(argv[0]);
+	return -1;
+    }
+    
+    // Bring up a context nobody will see
+    cerr << "\tContext ... \t";
+    
+    glslu::HeadlessContext* context;
+    
+    try {
+	context = new glslu::HeadlessContext(major, minor);
+    } catch(glslu::ContextException& e) {
+	ERRLOG(e.what());
+	return -1;
+    }
+    
+    if(!gl::sys::LoadFunctions()) {
+	ERRLOG("Could not load OpenGL!");
+	
+	delete context;
+	return -1;
+    }
+    
+    cerr << "OK [" << context->getBackendName() << "; " << gl::GetString(gl::RENDERER) << "; " << gl::GetString(gl::VERSION) << "]" << endl;
+    
+    // Build each program in turn
+    map<string, vector<string> > programs = glslu::findShaderPrograms(shaderDirectory);
+    int failures = 0;
+    
+    cerr << fixed << setprecision(2);
+    
+    for(map<string, vector<string> >::iterator entry = programs.begin(); entry != programs.end(); ++entry) {
+	glslu::Program program;
+	
+	cerr << "\t" << entry->first << " ... \t";
+	
+	try {
+	    for(size_t curr = 0; curr < entry->second.size(); ++curr)
+		program.compileShader(entry->second[curr]);
+	    
+	    program.setRetrievable(!cacheDirectory.empty());
+	    program.link();
+	} catch(glslu::ProgramException& e) {
+	    cerr << "FAILED" << endl;
+	    ERRLOG(e.what());
+	    
+	    ++failures;
+	    continue;
+	}
+	
+	const glslu::ProgramStats& stats = program.getStats();
+	double total = stats.compileTime + stats.linkTime;
+	
+	cerr << (maxMilliseconds > 0.0 && total > maxMilliseconds ? "SLOW" : "OK")
+	     << " [compile " << stats.compileTime << " ms, link " << stats.linkTime << " ms; "
+	     << program.getUniformInfo().size() << " uniforms, "
+	     << program.getUniformBlockInfo().size() << " blocks]" << endl;
+	
+	// Surface warnings even though the build succeeded
+	for(size_t curr = 0; curr < stats.shaders.size(); ++curr)
+	    if(!stats.shaders[curr].log.empty())
+		cerr << "\t    " << stats.shaders[curr].filename << ":" << endl << indent(stats.shaders[curr].log);
+	
+	if(!stats.linkLog.empty())
+	    cerr << "\t    link:" << endl << indent(stats.linkLog);
+	
+	if(maxMilliseconds > 0.0 && total > maxMilliseconds)
+	    ++failures;
+	
+	// Prime the binary cache, then check it loads back for a program that
+	// lists its files in another order, as the demo's do
+	if(!cacheDirectory.empty()) {
+	    string cacheFile = cacheDirectory + "/" + entry->first + ".bin";
+	    
+	    try {
+		program.saveBinary(cacheFile, glslu::getSourceKey(entry->second));
+		
+		glslu::Program cached;
+		vector<string> reversed(entry->second.rbegin(), entry->second.rend());
+		glslu::loadProgram(cached, reversed, cacheFile);
+		
+		if(!cached.getStats().cacheHit) {
+		    ERRLOG("\"" << cacheFile << "\" did not load back as a cache hit");
+		    ++failures;
+		}
+	    } catch(glslu::ProgramException& e) {
+		ERRLOG(e.what());
+		++failures;
+	    }
+	}
+	
+	// Write the active resource summary
+	if(!reflectDirectory.empty()) {
+	    string filename = reflectDirectory + "/" + entry->first + ".txt";
+	    ofstream output(filename.c_str(), ios::out | ios::trunc);
+	    
+	    if(output)
+		output << program.getActiveAttribs() << endl
+		       << program.getActiveUniforms() << endl
+		       << program.getActiveUniformBlocks();
+	    else {
+		ERRLOG("Could not write \"" << filename << "\"");
+		++failures;
+	    }
+	}
+    }
+    
+    // Timing reports
+    if(!jsonFile.empty()) {
+	ofstream output(jsonFile.c_str(), ios::out | ios::trunc);
+	glslu::writeProgramStatsJSON(output);
+    }
+    
+    if(!csvFile.empty()) {
+	ofstream output(csvFile.c_str(), ios::out | ios::trunc);
+	glslu::writeProgramStatsCSV(output);
+    }
+    
+    cerr << programs.size() << " programs, " << failures << " failures" << endl;
+    
+    delete context;
+    
+    return failures == 0 ? 0 : -1;
+}
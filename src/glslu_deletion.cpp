@@ -0,0 +1,158 @@
+#include "glslu_deletion.hpp"
+
+namespace glslu
+{
+    DeletionQueue* DeletionQueue::current = NULL;
+    
+    // Constructor
+    DeletionQueue::DeletionQueue(void):
+	deletedCount(0)
+    {
+	pending.fence = 0;
+    }
+    
+    // Deconstructor!
+    DeletionQueue::~DeletionQueue(void)
+    {
+	flush();
+	
+	if(current == this)
+	    current = NULL;
+    }
+    
+    // Delete every object of a batch, one call per object kind where GL allows
+    void DeletionQueue::destroy(Batch& batch)
+    {
+	std::vector<GLuint>* objects = batch.objects;
+	
+	for(size_t curr = 0; curr < objects[SHADER_OBJECT].size(); ++curr)
+	    gl::DeleteShader(objects[SHADER_OBJECT][curr]);
+	
+	for(size_t curr = 0; curr < objects[PROGRAM_OBJECT].size(); ++curr)
+	    gl::DeleteProgram(objects[PROGRAM_OBJECT][curr]);
+	
+	if(!objects[BUFFER_OBJECT].empty())
+	    gl::DeleteBuffers((GLsizei)objects[BUFFER_OBJECT].size(), &objects[BUFFER_OBJECT][0]);
+	
+	if(!objects[TEXTURE_OBJECT].empty())
+	    gl::DeleteTextures((GLsizei)objects[TEXTURE_OBJECT].size(), &objects[TEXTURE_OBJECT][0]);
+	
+	if(!objects[VERTEX_ARRAY_OBJECT].empty())
+	    gl::DeleteVertexArrays((GLsizei)objects[VERTEX_ARRAY_OBJECT].size(), &objects[VERTEX_ARRAY_OBJECT][0]);
+	
+	if(!objects[FRAMEBUFFER_OBJECT].empty())
+	    gl::DeleteFramebuffers((GLsizei)objects[FRAMEBUFFER_OBJECT].size(), &objects[FRAMEBUFFER_OBJECT][0]);
+	
+	if(!objects[RENDERBUFFER_OBJECT].empty())
+	    gl::DeleteRenderbuffers((GLsizei)objects[RENDERBUFFER_OBJECT].size(), &objects[RENDERBUFFER_OBJECT][0]);
+	
+	for(int type = 0; type < OBJECT_TYPE_COUNT; ++type) {
+	    deletedCount += objects[type].size();
+	    objects[type].clear();
+	}
+	
+	if(batch.fence) {
+	    gl::DeleteSync(batch.fence);
+	    batch.fence = 0;
+	}
+    }
+    
+    // Queue an object
+    void DeletionQueue::release(ObjectType type, GLuint name)
+    {
+	if(name != 0)
+	    pending.objects[type].push_back(name);
+    }
+    
+    // Frame boundary
+    void DeletionQueue::endFrame(void)
+    {
+	// Fence whatever was released this frame
+	bool empty = true;
+	
+	for(int type = 0; type < OBJECT_TYPE_COUNT; ++type)
+	    empty = empty && pending.objects[type].empty();
+	
+	if(!empty) {
+	    if(gl::FenceSync) {
+		pending.fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+		inFlight.push_back(pending);
+		
+		for(int type = 0; type < OBJECT_TYPE_COUNT; ++type)
+		    pending.objects[type].clear();
+		
+		pending.fence = 0;
+	    } else {
+		// No sync objects, nothing better to do than delete now
+		destroy(pending);
+	    }
+	}
+	
+	// Fences signal in order, so stop at the first one still pending
+	while(!inFlight.empty()) {
+	    GLenum result = gl::ClientWaitSync(inFlight.front().fence, 0, 0);
+	    
+	    if(result != gl::ALREADY_SIGNALED && result != gl::CONDITION_SATISFIED)
+		break;
+	    
+	    destroy(inFlight.front());
+	    inFlight.pop_front();
+	}
+    }
+    
+    // Drain the queue
+    void DeletionQueue::flush(void)
+    {
+	while(!inFlight.empty()) {
+	    gl::ClientWaitSync(inFlight.front().fence, gl::SYNC_FLUSH_COMMANDS_BIT, gl::TIMEOUT_IGNORED);
+	    
+	    destroy(inFlight.front());
+	    inFlight.pop_front();
+	}
+	
+	destroy(pending);
+    }
+    
+    // Objects still waiting on the GPU
+    size_t DeletionQueue::getPendingCount(void)
+    {
+	size_t count = 0;
+	
+	for(int type = 0; type < OBJECT_TYPE_COUNT; ++type)
+	    count += pending.objects[type].size();
+	
+	for(size_t batch = 0; batch < inFlight.size(); ++batch)
+	    for(int type = 0; type < OBJECT_TYPE_COUNT; ++type)
+		count += inFlight[batch].objects[type].size();
+	
+	return count;
+    }
+    
+    size_t DeletionQueue::getDeletedCount(void) { return deletedCount; }
+    
+    // Current queue accessors
+    void DeletionQueue::setCurrent(DeletionQueue* queue) { current = queue; }
+    DeletionQueue* DeletionQueue::getCurrent(void) { return current; }
+    
+    // Release helper
+    void releaseObject(ObjectType type, GLuint name)
+    {
+	if(name == 0) return;
+	
+	if(DeletionQueue* queue = DeletionQueue::getCurrent()) {
+	    queue->release(type, name);
+	    return;
+	}
+	
+	switch(type) {
+	case PROGRAM_OBJECT:      gl::DeleteProgram(name); break;
+	case SHADER_OBJECT:       gl::DeleteShader(name); break;
+	case BUFFER_OBJECT:       gl::DeleteBuffers(1, &name); break;
+	case TEXTURE_OBJECT:      gl::DeleteTextures(1, &name); break;
+	case VERTEX_ARRAY_OBJECT: gl::DeleteVertexArrays(1, &name); break;
+	case FRAMEBUFFER_OBJECT:  gl::DeleteFramebuffers(1, &name); break;
+	case RENDERBUFFER_OBJECT: gl::DeleteRenderbuffers(1, &name); break;
+	default: break;
+	}
+    }
+}
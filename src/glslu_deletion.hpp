@@ -0,0 +1,76 @@
+#ifndef GLSL_UTILITIES_DELETION
+#define GLSL_UTILITIES_DELETION
+
+#include <deque>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+
+namespace glslu
+{
+    // GL object kinds the deletion queue knows how to destroy
+    enum ObjectType
+    {
+	PROGRAM_OBJECT,
+	SHADER_OBJECT,
+	BUFFER_OBJECT,
+	TEXTURE_OBJECT,
+	VERTEX_ARRAY_OBJECT,
+	FRAMEBUFFER_OBJECT,
+	RENDERBUFFER_OBJECT,
+	OBJECT_TYPE_COUNT
+    };
+    
+    // Defers deletion of GL objects until the GPU is done with them.
+    //
+    // Objects released during a frame are fenced at endFrame() and deleted,
+    // in batches, at the first endFrame() that finds the fence signalled.
+    // All calls must come from the thread owning the context.
+    class DeletionQueue
+    {
+    private:
+	struct Batch
+	{
+	    GLsync fence;
+	    std::vector<GLuint> objects[OBJECT_TYPE_COUNT];
+	};
+	
+	Batch pending;
+	std::deque<Batch> inFlight;
+	size_t deletedCount;
+	
+	static DeletionQueue* current;
+	
+	void destroy(Batch& batch);
+	
+	// Prevent object copying
+	DeletionQueue(const DeletionQueue& other) {}
+	DeletionQueue& operator=(const DeletionQueue& other) { return *this; }
+	
+    public:
+	DeletionQueue(void);
+	~DeletionQueue(void);
+	
+	// Queue an object for deletion once the current frame has retired
+	void release(ObjectType type, GLuint name);
+	
+	// Fence this frame's releases and delete every batch the GPU has retired
+	void endFrame(void);
+	
+	// Wait for the GPU and delete everything (shutdown, context loss)
+	void flush(void);
+	
+	// Statistics
+	size_t getPendingCount(void);
+	size_t getDeletedCount(void);
+	
+	// Queue used by glslu objects when they are destroyed; NULL deletes immediately
+	static void setCurrent(DeletionQueue* queue);
+	static DeletionQueue* getCurrent(void);
+    };
+    
+    // Release through the current queue, or delete right away without one
+    void releaseObject(ObjectType type, GLuint name);
+}
+
+#endif
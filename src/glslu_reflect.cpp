@@ -0,0 +1,84 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "gl_core_4_4.hpp"
+
+#include "glslu.hpp"
+#include "glslu_codegen.hpp"
+#include "headless.hpp"
+
+#define ERRLOG(errstr) std::cerr << "ERR [" << __FILE__ << ":" << __LINE__ << "] " << errstr << std::endl;
+
+using namespace std;
+
+// glslu-reflect <shader directory> <output directory>
+//
+// Compiles and links every program found in the shader directory and writes
+// a typed uniform header per program into the output directory.
+int main(int argc, char* argv[])
+{
+    if(argc < 3) {
+	cerr << "Usage: " << argv[0] << " <shader directory> <output directory>" << endl;
+	return -1;
+    }
+    
+    string shaderDirectory = argv[1];
+    string outputDirectory = argv[2];
+    
+    // Program interface queries need 4.3
+    glslu::HeadlessContext* context;
+    
+    try {
+	context = new glslu::HeadlessContext(4, 3);
+    } catch(glslu::ContextException& e) {
+	ERRLOG(e.what());
+	return -1;
+    }
+    
+    if(!gl::sys::LoadFunctions()) {
+	ERRLOG("Could not load OpenGL!");
+	
+	delete context;
+	return -1;
+    }
+    
+    // Reflect each program in turn
+    map<string, vector<string> > programs = glslu::findShaderPrograms(shaderDirectory);
+    int failures = 0;
+    
+    for(map<string, vector<string> >::iterator entry = programs.begin(); entry != programs.end(); ++entry) {
+	string outputName = outputDirectory + "/" + entry->first + "_program.hpp";
+	
+	cerr << "\t" << entry->first << " ... \t";
+	
+	try {
+	    glslu::Program program;
+	    
+	    for(size_t curr = 0; curr < entry->second.size(); ++curr)
+		program.compileShader(entry->second[curr]);
+	    
+	    program.link();
+	    
+	    ofstream output(outputName.c_str(), ios::out | ios::trunc);
+	    
+	    if(!output)
+		throw glslu::ProgramException("Could not write \"" + outputName + "\"");
+	    
+	    output << glslu::generateProgramHeader(program, entry->first, entry->second);
+	    
+	    cerr << "OK" << endl;
+	} catch(glslu::ProgramException& e) {
+	    cerr << "FAILED" << endl;
+	    ERRLOG(e.what());
+	    
+	    ++failures;
+	}
+    }
+    
+    delete context;
+    
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,141 @@
+#ifndef GLSL_UTILITIES_UNIFORM
+#define GLSL_UTILITIES_UNIFORM
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "gl_core_4_4.hpp"
+
+namespace glslu
+{
+    // True for sampler and image types, which are set as integer texture units
+    bool isOpaqueType(GLenum type);
+    
+    // Compile-time description of how a C++ type maps onto a GLSL uniform.
+    // Unsupported types have no specialization and fail to compile.
+    template<typename T> struct UniformTraits;
+    
+    // Scalars and vectors: gl::Uniform{N}{f,d,i,ui}v
+    template<typename T, typename Component, GLenum Type, void (CODEGEN_FUNCPTR **Setter)(GLint, GLsizei, const Component*)>
+    struct VectorUniformTraits
+    {
+	static bool accepts(GLenum type) { return type == Type; }
+	static GLenum glType(void) { return Type; }
+	static void set(GLint location, GLsizei count, const T* values) { (*Setter)(location, count, reinterpret_cast<const Component*>(values)); }
+    };
+    
+    // Matrices: gl::UniformMatrix{C}x{R}{f,d}v, always column-major
+    template<typename T, typename Component, GLenum Type, void (CODEGEN_FUNCPTR **Setter)(GLint, GLsizei, GLboolean, const Component*)>
+    struct MatrixUniformTraits
+    {
+	static bool accepts(GLenum type) { return type == Type; }
+	static GLenum glType(void) { return Type; }
+	static void set(GLint location, GLsizei count, const T* values) { (*Setter)(location, count, gl::FALSE_, reinterpret_cast<const Component*>(values)); }
+    };
+    
+    // Booleans are widened to integers rather than relying on implicit conversion
+    template<> struct UniformTraits<bool>
+    {
+	static bool accepts(GLenum type) { return type == gl::BOOL; }
+	static GLenum glType(void) { return gl::BOOL; }
+	static void set(GLint location, GLsizei count, const bool* values)
+	{
+	    if(count == 1) {
+		gl::Uniform1i(location, values[0] ? 1 : 0);
+		return;
+	    }
+	    
+	    std::vector<GLint> widened(values, values + count);
+	    gl::Uniform1iv(location, count, &widened[0]);
+	}
+    };
+    
+    // Integers also address sampler and image units
+    template<> struct UniformTraits<GLint>: VectorUniformTraits<GLint, GLint, gl::INT, &gl::Uniform1iv>
+    {
+	static bool accepts(GLenum type) { return type == gl::INT || isOpaqueType(type); }
+    };
+    
+    template<> struct UniformTraits<GLuint>: VectorUniformTraits<GLuint, GLuint, gl::UNSIGNED_INT, &gl::Uniform1uiv> {};
+    template<> struct UniformTraits<GLfloat>: VectorUniformTraits<GLfloat, GLfloat, gl::FLOAT, &gl::Uniform1fv> {};
+    template<> struct UniformTraits<GLdouble>: VectorUniformTraits<GLdouble, GLdouble, gl::DOUBLE, &gl::Uniform1dv> {};
+    
+    template<> struct UniformTraits<glm::vec2>: VectorUniformTraits<glm::vec2, GLfloat, gl::FLOAT_VEC2, &gl::Uniform2fv> {};
+    template<> struct UniformTraits<glm::vec3>: VectorUniformTraits<glm::vec3, GLfloat, gl::FLOAT_VEC3, &gl::Uniform3fv> {};
+    template<> struct UniformTraits<glm::vec4>: VectorUniformTraits<glm::vec4, GLfloat, gl::FLOAT_VEC4, &gl::Uniform4fv> {};
+    template<> struct UniformTraits<glm::dvec2>: VectorUniformTraits<glm::dvec2, GLdouble, gl::DOUBLE_VEC2, &gl::Uniform2dv> {};
+    template<> struct UniformTraits<glm::dvec3>: VectorUniformTraits<glm::dvec3, GLdouble, gl::DOUBLE_VEC3, &gl::Uniform3dv> {};
+    template<> struct UniformTraits<glm::dvec4>: VectorUniformTraits<glm::dvec4, GLdouble, gl::DOUBLE_VEC4, &gl::Uniform4dv> {};
+    template<> struct UniformTraits<glm::ivec2>: VectorUniformTraits<glm::ivec2, GLint, gl::INT_VEC2, &gl::Uniform2iv> {};
+    template<> struct UniformTraits<glm::ivec3>: VectorUniformTraits<glm::ivec3, GLint, gl::INT_VEC3, &gl::Uniform3iv> {};
+    template<> struct UniformTraits<glm::ivec4>: VectorUniformTraits<glm::ivec4, GLint, gl::INT_VEC4, &gl::Uniform4iv> {};
+    template<> struct UniformTraits<glm::uvec2>: VectorUniformTraits<glm::uvec2, GLuint, gl::UNSIGNED_INT_VEC2, &gl::Uniform2uiv> {};
+    template<> struct UniformTraits<glm::uvec3>: VectorUniformTraits<glm::uvec3, GLuint, gl::UNSIGNED_INT_VEC3, &gl::Uniform3uiv> {};
+    template<> struct UniformTraits<glm::uvec4>: VectorUniformTraits<glm::uvec4, GLuint, gl::UNSIGNED_INT_VEC4, &gl::Uniform4uiv> {};
+    
+    template<> struct UniformTraits<glm::mat2>: MatrixUniformTraits<glm::mat2, GLfloat, gl::FLOAT_MAT2, &gl::UniformMatrix2fv> {};
+    template<> struct UniformTraits<glm::mat3>: MatrixUniformTraits<glm::mat3, GLfloat, gl::FLOAT_MAT3, &gl::UniformMatrix3fv> {};
+    template<> struct UniformTraits<glm::mat4>: MatrixUniformTraits<glm::mat4, GLfloat, gl::FLOAT_MAT4, &gl::UniformMatrix4fv> {};
+    template<> struct UniformTraits<glm::mat2x3>: MatrixUniformTraits<glm::mat2x3, GLfloat, gl::FLOAT_MAT2x3, &gl::UniformMatrix2x3fv> {};
+    template<> struct UniformTraits<glm::mat2x4>: MatrixUniformTraits<glm::mat2x4, GLfloat, gl::FLOAT_MAT2x4, &gl::UniformMatrix2x4fv> {};
+    template<> struct UniformTraits<glm::mat3x2>: MatrixUniformTraits<glm::mat3x2, GLfloat, gl::FLOAT_MAT3x2, &gl::UniformMatrix3x2fv> {};
+    template<> struct UniformTraits<glm::mat3x4>: MatrixUniformTraits<glm::mat3x4, GLfloat, gl::FLOAT_MAT3x4, &gl::UniformMatrix3x4fv> {};
+    template<> struct UniformTraits<glm::mat4x2>: MatrixUniformTraits<glm::mat4x2, GLfloat, gl::FLOAT_MAT4x2, &gl::UniformMatrix4x2fv> {};
+    template<> struct UniformTraits<glm::mat4x3>: MatrixUniformTraits<glm::mat4x3, GLfloat, gl::FLOAT_MAT4x3, &gl::UniformMatrix4x3fv> {};
+    template<> struct UniformTraits<glm::dmat2>: MatrixUniformTraits<glm::dmat2, GLdouble, gl::DOUBLE_MAT2, &gl::UniformMatrix2dv> {};
+    template<> struct UniformTraits<glm::dmat3>: MatrixUniformTraits<glm::dmat3, GLdouble, gl::DOUBLE_MAT3, &gl::UniformMatrix3dv> {};
+    template<> struct UniformTraits<glm::dmat4>: MatrixUniformTraits<glm::dmat4, GLdouble, gl::DOUBLE_MAT4, &gl::UniformMatrix4dv> {};
+    
+    // Typed handle to a uniform of a linked program. Obtain one through
+    // Program::getUniform<T>(), which checks T against the reflected type.
+    // set() applies to the currently bound program, like gl::Uniform*.
+    template<typename T>
+    class Uniform
+    {
+    private:
+	GLint location;
+	GLint size;
+	
+	// No more elements than the reflected array holds
+	GLsizei clamp(GLsizei count) const { return size > 0 ? std::min(count, (GLsizei)size) : count; }
+	
+    public:
+	Uniform(void): location(-1), size(0) {}
+	Uniform(GLint location, GLint size): location(location), size(size) {}
+	
+	GLint getLocation(void) const { return location; }
+	GLint getSize(void) const { return size; }
+	bool isValid(void) const { return location >= 0; }
+	
+	void set(const T& value) const { UniformTraits<T>::set(location, 1, &value); }
+	
+	// Arrays, counts past the reflected size are cut to it and empty ones
+	// set nothing
+	void set(const T* values, GLsizei count) const
+	{
+	    if(count > 0)
+		UniformTraits<T>::set(location, clamp(count), values);
+	}
+	
+	void set(const std::vector<T>& values) const
+	{
+	    if(!values.empty())
+		UniformTraits<T>::set(location, clamp((GLsizei)values.size()), &values[0]);
+	}
+    };
+    
+    // std::vector<bool> packs its bits, so it is widened a value at a time
+    template<>
+    inline void Uniform<bool>::set(const std::vector<bool>& values) const
+    {
+	if(values.empty())
+	    return;
+	
+	std::vector<GLint> widened(values.begin(), values.end());
+	gl::Uniform1iv(location, clamp((GLsizei)widened.size()), &widened[0]);
+    }
+}
+
+#endif
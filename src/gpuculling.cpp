@@ -0,0 +1,105 @@
+#include "gpuculling.hpp"
+
+#include "capabilities.hpp"
+#include "glslu_deletion.hpp"
+#include "generated/cull_program.hpp"
+
+using std::vector;
+using glslu::programs::CullProgram;
+
+namespace forever
+{
+    // Must match local_size_x in cull.comp
+    static const GLuint CULL_GROUP_SIZE = 64;
+    
+    // Constructor
+    GpuCuller::GpuCuller(glslu::Program& program, Mesh& mesh, GLuint sourceBuffer, const vector<GLuint>& partCounts, float radius) throw(glslu::ProgramException):
+	program(program), sourceBuffer(sourceBuffer), visibleBuffer(0), commandBuffer(0), instanceCount(0), radius(radius)
+    {
+	if(!getCapabilities().computeShader || !getCapabilities().multiDrawIndirect)
+	    throw glslu::ProgramException("GPU culling needs compute shaders and multi-draw-indirect");
+	
+	// Uniforms are set through glslu-reflect's constant locations
+	CullProgram::verify(program);
+	
+	// One command per part, empty parts included so the shader can find
+	// a part from the base instances alone
+	for(size_t part = 0; part < partCounts.size() && part < mesh.getPartCount(); ++part) {
+	    const MeshPart& range = mesh.getPart(part);
+	    DrawElementsIndirectCommand command = {(GLuint)range.indexCount, 0, range.firstIndex, range.baseVertex, instanceCount};
+	    
+	    resetCommands.push_back(command);
+	    instanceCount += partCounts[part];
+	}
+	
+	if(resetCommands.empty())
+	    throw glslu::ProgramException("GPU culling needs at least one mesh part");
+	
+	gl::GenBuffers(1, &visibleBuffer);
+	gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, visibleBuffer);
+	gl::BufferData(gl::SHADER_STORAGE_BUFFER, instanceCount * sizeof(Instance), NULL, gl::DYNAMIC_COPY);
+	
+	gl::GenBuffers(1, &commandBuffer);
+	gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, commandBuffer);
+	gl::BufferData(gl::SHADER_STORAGE_BUFFER, resetCommands.size() * sizeof(DrawElementsIndirectCommand), &resetCommands[0], gl::DYNAMIC_DRAW);
+	gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+	
+	mesh.setInstanceBuffer(visibleBuffer);
+    }
+    
+    // Deconstructor!
+    GpuCuller::~GpuCuller(void)
+    {
+	glslu::releaseObject(glslu::BUFFER_OBJECT, visibleBuffer);
+	glslu::releaseObject(glslu::BUFFER_OBJECT, commandBuffer);
+    }
+    
+    // Accessors
+    GLuint GpuCuller::getVisibleBuffer(void) { return visibleBuffer; }
+    GLuint GpuCuller::getCommandBuffer(void) { return commandBuffer; }
+    
+    // Compute pass
+    void GpuCuller::cull(const Frustum& frustum)
+    {
+	if(resetCommands.empty())
+	    return;
+	
+	// Zero the counts, a small write rather than a readback
+	gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, commandBuffer);
+	gl::BufferSubData(gl::SHADER_STORAGE_BUFFER, 0, resetCommands.size() * sizeof(DrawElementsIndirectCommand), &resetCommands[0]);
+	gl::BindBuffer(gl::SHADER_STORAGE_BUFFER, 0);
+	
+	glm::vec4 planes[6];
+	
+	for(int plane = 0; plane < 6; ++plane)
+	    planes[plane] = glm::vec4(frustum.planes[plane][0], frustum.planes[plane][1], frustum.planes[plane][2], frustum.planes[plane][3]);
+	
+	program.use();
+	CullProgram::planes::set(planes, 6);
+	CullProgram::radius::set(radius);
+	CullProgram::instanceCount::set(instanceCount);
+	CullProgram::partCount::set((GLuint)resetCommands.size());
+	
+	gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, 0, sourceBuffer);
+	gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+	gl::BindBufferBase(gl::SHADER_STORAGE_BUFFER, 2, commandBuffer);
+	
+	gl::DispatchCompute((instanceCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	
+	// The draw reads the counts as commands and the survivors as
+	// attributes, and the next pass's reset overwrites the counts
+	gl::MemoryBarrier_(gl::COMMAND_BARRIER_BIT | gl::VERTEX_ATTRIB_ARRAY_BARRIER_BIT | gl::BUFFER_UPDATE_BARRIER_BIT);
+    }
+    
+    // Indirect draw of the survivors
+    void GpuCuller::draw(Mesh& mesh)
+    {
+	if(resetCommands.empty())
+	    return;
+	
+	mesh.bind();
+	gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, commandBuffer);
+	gl::MultiDrawElementsIndirect(gl::TRIANGLES, gl::UNSIGNED_SHORT, 0, (GLsizei)resetCommands.size(), 0);
+	gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, 0);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef FOREVER_GPU_CULLING
+#define FOREVER_GPU_CULLING
+
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+#include "glslu.hpp"
+#include "mesh.hpp"
+#include "culling.hpp"
+#include "indirect.hpp"
+
+namespace forever
+{
+    // Frustum culling and draw command generation on the GPU.
+    //
+    // A compute pass (shaders/cull.comp) tests every instance's bounding
+    // sphere, copies survivors into a visible instance buffer grouped by
+    // part, and counts them into one DrawElementsIndirectCommand per part
+    // with atomics. The draw then reads those commands directly, so nothing
+    // is read back. Needs compute shaders and multi-draw-indirect.
+    class GpuCuller
+    {
+    private:
+	glslu::Program& program;
+	GLuint sourceBuffer;
+	GLuint visibleBuffer;
+	GLuint commandBuffer;
+	GLuint instanceCount;
+	float radius;
+	
+	// Commands as they stand before each pass, every count zeroed
+	std::vector<DrawElementsIndirectCommand> resetCommands;
+	
+	// Prevent object copying
+	GpuCuller(const GpuCuller& other);
+	GpuCuller& operator=(const GpuCuller& other);
+	
+    public:
+	// Instances are read from sourceBuffer, laid out part by part as
+	// partCounts gives them, which must name at least one part. The mesh
+	// is pointed at the visible buffer.
+	GpuCuller(glslu::Program& program, Mesh& mesh, GLuint sourceBuffer, const std::vector<GLuint>& partCounts, float radius) throw(glslu::ProgramException);
+	~GpuCuller(void);
+	
+	GLuint getVisibleBuffer(void);
+	GLuint getCommandBuffer(void);
+	
+	// Run the compute pass for this frame's frustum
+	void cull(const Frustum& frustum);
+	
+	// Draw whatever the last pass kept, in one MultiDrawElementsIndirect
+	void draw(Mesh& mesh);
+    };
+}
+
+#endif
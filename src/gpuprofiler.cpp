@@ -0,0 +1,271 @@
+#include "gpuprofiler.hpp"
+
+#include <algorithm>
+
+#include "capabilities.hpp"
+#include "profiler.hpp"
+
+using std::vector;
+using std::string;
+
+namespace forever
+{
+    // Frames the rolling average spans, roughly
+    static const double ROLLING_FRAMES = 30.0;
+    
+    // Constructor
+    GpuProfiler::GpuProfiler(int framesDeep):
+	supported(getCapabilities().timerQuery), frames(std::max(framesDeep, 2)), slot(0),
+	frameNumber(0), resetFrame(0), measuring(false), droppedFrames(0)
+    {
+	for(size_t curr = 0; curr < frames.size(); ++curr) {
+	    frames[curr].number = 0;
+	    frames[curr].offset = 0;
+	    frames[curr].pending = false;
+	    frames[curr].used = 0;
+	}
+    }
+    
+    // Deconstructor!
+    GpuProfiler::~GpuProfiler(void)
+    {
+	for(size_t curr = 0; curr < frames.size(); ++curr)
+	    if(!frames[curr].queries.empty())
+		gl::DeleteQueries((GLsizei)frames[curr].queries.size(), &frames[curr].queries[0]);
+    }
+    
+    // Accessors
+    bool GpuProfiler::isSupported(void) const { return supported; }
+    const vector<GpuPassStats>& GpuProfiler::getStats(void) const { return stats; }
+    int GpuProfiler::getDroppedFrames(void) const { return droppedFrames; }
+    
+    // Queries are kept per slot and reused every time round
+    GLuint GpuProfiler::nextQuery(Frame& frame)
+    {
+	if(frame.used == frame.queries.size()) {
+	    GLuint query;
+	    gl::GenQueries(1, &query);
+	    frame.queries.push_back(query);
+	}
+	
+	return frame.queries[frame.used++];
+    }
+    
+    // Stats entry for a pass, added the first time it is seen
+    int GpuProfiler::findPass(const string& name, int depth)
+    {
+	for(size_t curr = 0; curr < stats.size(); ++curr)
+	    if(stats[curr].name == name && stats[curr].depth == depth)
+		return (int)curr;
+	
+	GpuPassStats pass = {name, depth, 0.0, 0.0, 0.0, 0.0, 0};
+	stats.push_back(pass);
+	totals.push_back(0.0);
+	
+	return (int)stats.size() - 1;
+    }
+    
+    // Frame brackets
+    void GpuProfiler::beginFrame(void)
+    {
+	Frame& frame = frames[slot];
+	
+	measuring = supported && !frame.pending;
+	open.clear();
+	
+	if(!measuring) {
+	    if(supported)
+		++droppedFrames;
+	    
+	    return;
+	}
+	
+	frame.number = frameNumber;
+	frame.passes.clear();
+	frame.used = 0;
+	
+	// The GPU clock as commands reach it, against the CPU's; close enough
+	// to line the tracks up, and redone each frame so they never drift
+	if(Profiler::isEnabled()) {
+	    GLint64 gpuTime = 0;
+	    gl::GetInteger64v(gl::TIMESTAMP, &gpuTime);
+	    frame.offset = Profiler::now() - gpuTime;
+	}
+    }
+    
+    void GpuProfiler::endFrame(void)
+    {
+	if(measuring) {
+	    while(!open.empty())
+		end();
+	    
+	    frames[slot].pending = true;
+	    slot = (slot + 1) % frames.size();
+	    measuring = false;
+	}
+	
+	++frameNumber;
+	collect(false);
+    }
+    
+    void GpuProfiler::finish(void)
+    {
+	collect(true);
+    }
+    
+    // Oldest first; the GPU finishes frames in order, so stop at the first
+    // one still running unless waiting for it
+    void GpuProfiler::collect(bool wait)
+    {
+	for(size_t curr = 0; curr < frames.size(); ++curr) {
+	    Frame& frame = frames[(slot + curr) % frames.size()];
+	    
+	    if(!frame.pending)
+		continue;
+	    
+	    if(!wait && !isAvailable(frame))
+		break;
+	    
+	    read(frame);
+	}
+    }
+    
+    // Pass brackets
+    void GpuProfiler::begin(const string& name)
+    {
+	if(!measuring)
+	    return;
+	
+	Frame& frame = frames[slot];
+	Pass pass;
+	
+	pass.name = findPass(name, (int)open.size());
+	pass.begin = nextQuery(frame);
+	pass.end = 0;
+	gl::QueryCounter(pass.begin, gl::TIMESTAMP);
+	
+	open.push_back(frame.passes.size());
+	frame.passes.push_back(pass);
+    }
+    
+    void GpuProfiler::end(void)
+    {
+	if(!measuring || open.empty())
+	    return;
+	
+	Frame& frame = frames[slot];
+	Pass& pass = frame.passes[open.back()];
+	
+	pass.end = nextQuery(frame);
+	gl::QueryCounter(pass.end, gl::TIMESTAMP);
+	open.pop_back();
+    }
+    
+    // Without a wait
+    bool GpuProfiler::isAvailable(const Frame& frame)
+    {
+	for(size_t curr = 0; curr < frame.used; ++curr) {
+	    GLuint available = gl::FALSE_;
+	    gl::GetQueryObjectuiv(frame.queries[curr], gl::QUERY_RESULT_AVAILABLE, &available);
+	    
+	    if(!available)
+		return false;
+	}
+	
+	return true;
+    }
+    
+    // Fold a finished frame into the stats; a pass run several times in a
+    // frame counts once, with its times summed
+    void GpuProfiler::read(Frame& frame)
+    {
+	vector<double> times(stats.size(), -1.0);
+	
+	for(size_t curr = 0; curr < frame.passes.size(); ++curr) {
+	    GLuint64 begin = 0, end = 0;
+	    gl::GetQueryObjectui64v(frame.passes[curr].begin, gl::QUERY_RESULT, &begin);
+	    gl::GetQueryObjectui64v(frame.passes[curr].end, gl::QUERY_RESULT, &end);
+	    
+	    double& time = times[frame.passes[curr].name];
+	    time = std::max(time, 0.0) + (end > begin ? (end - begin) / 1000000.0 : 0.0);
+	    
+	    if(Profiler::isEnabled())
+		Profiler::recordGpu(stats[frame.passes[curr].name].name, (long long)begin + frame.offset, (long long)end + frame.offset);
+	}
+	
+	for(size_t curr = 0; curr < stats.size(); ++curr) {
+	    if(times[curr] < 0.0)
+		continue;
+	    
+	    GpuPassStats& pass = stats[curr];
+	    pass.last = times[curr];
+	    pass.average = pass.average > 0.0 ? pass.average + (pass.last - pass.average) / ROLLING_FRAMES : pass.last;
+	    
+	    if(frame.number >= resetFrame) {
+		totals[curr] += pass.last;
+		++pass.samples;
+		pass.mean = totals[curr] / pass.samples;
+		pass.max = std::max(pass.max, pass.last);
+	    }
+	}
+	
+	frame.pending = false;
+    }
+    
+    // New measuring window
+    void GpuProfiler::resetStats(void)
+    {
+	resetFrame = frameNumber;
+	droppedFrames = 0;
+	
+	for(size_t curr = 0; curr < stats.size(); ++curr) {
+	    stats[curr].mean = 0.0;
+	    stats[curr].max = 0.0;
+	    stats[curr].samples = 0;
+	    totals[curr] = 0.0;
+	}
+    }
+    
+    // Bars
+    void GpuProfiler::drawOverlay(int width, int height, double budget) const
+    {
+	static const GLfloat colours[][3] = {
+	    {0.90f, 0.35f, 0.30f}, {0.30f, 0.75f, 0.40f}, {0.30f, 0.50f, 0.90f},
+	    {0.90f, 0.75f, 0.25f}, {0.70f, 0.40f, 0.85f}, {0.25f, 0.80f, 0.80f}
+	};
+	
+	const int rowHeight = 6, gap = 2, margin = 4, indent = 8;
+	int track = width / 2;
+	
+	if(stats.empty() || track <= 0 || budget <= 0.0)
+	    return;
+	
+	GLfloat clearColour[4];
+	gl::GetFloatv(gl::COLOR_CLEAR_VALUE, clearColour);
+	gl::Enable(gl::SCISSOR_TEST);
+	
+	for(size_t curr = 0; curr < stats.size(); ++curr) {
+	    int x = margin + stats[curr].depth * indent;
+	    int y = height - margin - (int)(curr + 1) * (rowHeight + gap);
+	    int bar = std::min(track, (int)(track * stats[curr].average / budget + 0.5));
+	    const GLfloat* colour = colours[curr % (sizeof(colours) / sizeof(colours[0]))];
+	    
+	    if(y < 0)
+		break;
+	    
+	    // Dim track for the whole budget, the pass's share over it
+	    gl::Scissor(x, y, track, rowHeight);
+	    gl::ClearColor(0.15f * colour[0], 0.15f * colour[1], 0.15f * colour[2], 1.0f);
+	    gl::Clear(gl::COLOR_BUFFER_BIT);
+	    
+	    if(bar > 0) {
+		gl::Scissor(x, y, bar, rowHeight);
+		gl::ClearColor(colour[0], colour[1], colour[2], 1.0f);
+		gl::Clear(gl::COLOR_BUFFER_BIT);
+	    }
+	}
+	
+	gl::Disable(gl::SCISSOR_TEST);
+	gl::ClearColor(clearColour[0], clearColour[1], clearColour[2], clearColour[3]);
+    }
+}
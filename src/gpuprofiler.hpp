@@ -0,0 +1,119 @@
+#ifndef FOREVER_GPU_PROFILER
+#define FOREVER_GPU_PROFILER
+
+#include <string>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    // Timings of one named pass, milliseconds
+    struct GpuPassStats
+    {
+	std::string name;
+	int depth;              // nesting level, 0 for outermost
+	double last;
+	double average;         // rolling, over roughly the last 30 frames
+	double mean;            // since the last resetStats()
+	double max;
+	int samples;
+    };
+    
+    // GPU time per render pass from TIMESTAMP query pairs.
+    //
+    // Passes are bracketed by begin()/end(), and may nest. Each frame's
+    // queries live in one of framesDeep slots; a slot is read back only once
+    // every query in it reports QUERY_RESULT_AVAILABLE, so results arrive a
+    // few frames late but the CPU never waits. Should the GPU fall so far
+    // behind that the next slot is still pending, that frame goes unmeasured
+    // instead.
+    //
+    // While the CPU Profiler is enabled, passes also land on its GPU track.
+    class GpuProfiler
+    {
+    private:
+	struct Pass
+	{
+	    int name;           // index into stats
+	    GLuint begin, end;
+	};
+	
+	struct Frame
+	{
+	    long number;
+	    long long offset;   // GPU to Profiler::now() time, for traces
+	    bool pending;
+	    std::vector<Pass> passes;
+	    std::vector<GLuint> queries;
+	    size_t used;
+	};
+	
+	bool supported;
+	std::vector<Frame> frames;
+	size_t slot;
+	long frameNumber;
+	long resetFrame;
+	bool measuring;
+	std::vector<size_t> open;
+	int droppedFrames;
+	
+	std::vector<GpuPassStats> stats;
+	std::vector<double> totals;
+	
+	GLuint nextQuery(Frame& frame);
+	int findPass(const std::string& name, int depth);
+	bool isAvailable(const Frame& frame);
+	void read(Frame& frame);
+	void collect(bool wait);
+	
+	// No copies, it owns the queries
+	GpuProfiler(const GpuProfiler&);
+	GpuProfiler& operator=(const GpuProfiler&);
+	
+    public:
+	GpuProfiler(int framesDeep = 4);
+	~GpuProfiler(void);
+	
+	bool isSupported(void) const;
+	
+	// Frame brackets; endFrame() also picks up whatever has finished
+	void beginFrame(void);
+	void endFrame(void);
+	
+	// Wait for every frame still in flight, for a final report
+	void finish(void);
+	
+	// Pass brackets, within a frame
+	void begin(const std::string& name);
+	void end(void);
+	
+	// Passes in the order first seen
+	const std::vector<GpuPassStats>& getStats(void) const;
+	int getDroppedFrames(void) const;
+	
+	// Restart the means and maxima from the current frame on
+	void resetStats(void);
+	
+	// One bar per pass along the top left of the bound framebuffer, full
+	// width at budget milliseconds; drawn with scissored clears, so it
+	// needs no program
+	void drawOverlay(int width, int height, double budget = 1000.0 / 60.0) const;
+	
+	// begin()/end() for a scope
+	class Scope
+	{
+	private:
+	    GpuProfiler* profiler;
+	    
+	    Scope(const Scope&);
+	    Scope& operator=(const Scope&);
+	    
+	public:
+	    Scope(GpuProfiler* profiler, const std::string& name): profiler(profiler) { if(profiler) profiler->begin(name); }
+	    ~Scope(void) { if(profiler) profiler->end(); }
+	};
+    };
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include "headless.hpp"
+
+#include <sstream>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+
+#if defined(GLSLU_USE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(GLSLU_USE_OSMESA)
+#ifndef GLAPIENTRY
+#define GLAPIENTRY APIENTRY
+#endif
+#include <GL/osmesa.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+using std::string;
+using std::stringstream;
+
+namespace glslu
+{
+#if defined(GLSLU_USE_EGL)
+    struct HeadlessContext::Implementation
+    {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface;
+	string backend;
+    };
+    
+    namespace HeadlessInfo {
+	bool hasExtension(const char* extensions, const string& name)
+	{
+	    if(!extensions) return false;
+	    
+	    string list = string(" ") + extensions + " ";
+	    return list.find(" " + name + " ") != string::npos;
+	}
+	
+	// Prefer Mesa's surfaceless platform, it needs neither X11 nor a GPU
+	EGLDisplay openDisplay(string& backend)
+	{
+	    const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	    
+	    if(hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		    (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		
+		if(getPlatformDisplay) {
+		    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		    
+		    if(display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+			backend = "EGL surfaceless";
+			return display;
+		    }
+		}
+	    }
+	    
+	    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	    
+	    if(display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+		backend = "EGL default display";
+		return display;
+	    }
+	    
+	    return EGL_NO_DISPLAY;
+	}
+    }
+    
+    HeadlessContext::HeadlessContext(int major, int minor, int width, int height)
+	throw(ContextException):
+	impl(new Implementation)
+    {
+	impl->context = EGL_NO_CONTEXT;
+	impl->surface = EGL_NO_SURFACE;
+	impl->display = HeadlessInfo::openDisplay(impl->backend);
+	
+	if(impl->display == EGL_NO_DISPLAY) {
+	    delete impl;
+	    throw ContextException("Could not open an EGL display.");
+	}
+	
+	// Pick a desktop GL config that can back a pbuffer should surfaceless be missing
+	EGLint configAttribs[] = {
+	    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+	    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+	    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+	    EGL_DEPTH_SIZE, 24,
+	    EGL_NONE
+	};
+	
+	EGLConfig config;
+	EGLint configCount = 0;
+	
+	if(!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(impl->display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+	    eglTerminate(impl->display);
+	    delete impl;
+	    throw ContextException("No EGL config supports desktop OpenGL.");
+	}
+	
+	EGLint contextAttribs[] = {
+	    EGL_CONTEXT_MAJOR_VERSION, major,
+	    EGL_CONTEXT_MINOR_VERSION, minor,
+	    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+	    EGL_NONE
+	};
+	
+	impl->context = eglCreateContext(impl->display, config, EGL_NO_CONTEXT, contextAttribs);
+	
+	if(impl->context == EGL_NO_CONTEXT) {
+	    stringstream buffer;
+	    buffer << "Could not create an OpenGL " << major << "." << minor << " core context through EGL.";
+	    
+	    eglTerminate(impl->display);
+	    delete impl;
+	    throw ContextException(buffer.str());
+	}
+	
+	// Render without any surface if allowed, otherwise through a pbuffer
+	if(!HeadlessInfo::hasExtension(eglQueryString(impl->display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+	    EGLint surfaceAttribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE};
+	    impl->surface = eglCreatePbufferSurface(impl->display, config, surfaceAttribs);
+	    impl->backend += " (pbuffer)";
+	    
+	    if(impl->surface == EGL_NO_SURFACE) {
+		eglDestroyContext(impl->display, impl->context);
+		eglTerminate(impl->display);
+		delete impl;
+		throw ContextException("Could not create an EGL pbuffer surface.");
+	    }
+	}
+	
+	if(eglMakeCurrent(impl->display, impl->surface, impl->surface, impl->context) == EGL_FALSE) {
+	    if(impl->surface != EGL_NO_SURFACE)
+		eglDestroySurface(impl->display, impl->surface);
+	    
+	    eglDestroyContext(impl->display, impl->context);
+	    eglTerminate(impl->display);
+	    delete impl;
+	    throw ContextException("Could not make the EGL context current.");
+	}
+    }
+    
+    HeadlessContext::~HeadlessContext(void)
+    {
+	eglMakeCurrent(impl->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	
+	if(impl->surface != EGL_NO_SURFACE)
+	    eglDestroySurface(impl->display, impl->surface);
+	
+	eglDestroyContext(impl->display, impl->context);
+	eglTerminate(impl->display);
+	
+	delete impl;
+    }
+    
+    void HeadlessContext::makeCurrent(void)
+	throw(ContextException)
+    {
+	if(eglMakeCurrent(impl->display, impl->surface, impl->surface, impl->context) == EGL_FALSE)
+	    throw ContextException("Could not make the EGL context current.");
+    }
+    
+#elif defined(GLSLU_USE_OSMESA)
+    struct HeadlessContext::Implementation
+    {
+	OSMesaContext context;
+	std::vector<GLubyte> buffer;
+	int width, height;
+	string backend;
+    };
+    
+    HeadlessContext::HeadlessContext(int major, int minor, int width, int height)
+	throw(ContextException):
+	impl(new Implementation)
+    {
+	int attribs[] = {
+	    OSMESA_FORMAT, OSMESA_RGBA,
+	    OSMESA_DEPTH_BITS, 24,
+	    OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+	    OSMESA_CONTEXT_MAJOR_VERSION, major,
+	    OSMESA_CONTEXT_MINOR_VERSION, minor,
+	    0
+	};
+	
+	impl->context = OSMesaCreateContextAttribs(attribs, NULL);
+	
+	if(!impl->context) {
+	    stringstream buffer;
+	    buffer << "Could not create an OpenGL " << major << "." << minor << " core context through OSMesa.";
+	    
+	    delete impl;
+	    throw ContextException(buffer.str());
+	}
+	
+	// OSMesa always renders into client memory, even when an FBO is bound
+	impl->width = width;
+	impl->height = height;
+	impl->buffer.resize(width * height * 4);
+	impl->backend = "OSMesa";
+	
+	if(!OSMesaMakeCurrent(impl->context, &impl->buffer[0], gl::UNSIGNED_BYTE, width, height)) {
+	    OSMesaDestroyContext(impl->context);
+	    delete impl;
+	    throw ContextException("Could not make the OSMesa context current.");
+	}
+    }
+    
+    HeadlessContext::~HeadlessContext(void)
+    {
+	OSMesaDestroyContext(impl->context);
+	delete impl;
+    }
+    
+    void HeadlessContext::makeCurrent(void)
+	throw(ContextException)
+    {
+	if(!OSMesaMakeCurrent(impl->context, &impl->buffer[0], gl::UNSIGNED_BYTE, impl->width, impl->height))
+	    throw ContextException("Could not make the OSMesa context current.");
+    }
+    
+#else
+    struct HeadlessContext::Implementation
+    {
+	GLFWwindow* window;
+	string backend;
+    };
+    
+    HeadlessContext::HeadlessContext(int major, int minor, int width, int height)
+	throw(ContextException):
+	impl(new Implementation)
+    {
+	if(!glfwInit()) {
+	    delete impl;
+	    throw ContextException("Could not initialize GLFW.");
+	}
+	
+	// The window exists only to own the context, it is never shown
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	
+	impl->window = glfwCreateWindow(width, height, "headless", NULL, NULL);
+	impl->backend = "hidden GLFW window";
+	
+	if(!impl->window) {
+	    stringstream buffer;
+	    buffer << "Could not create an OpenGL " << major << "." << minor << " core context through GLFW.";
+	    
+	    glfwTerminate();
+	    delete impl;
+	    throw ContextException(buffer.str());
+	}
+	
+	makeCurrent();
+    }
+    
+    HeadlessContext::~HeadlessContext(void)
+    {
+	glfwDestroyWindow(impl->window);
+	glfwTerminate();
+	
+	delete impl;
+    }
+    
+    void HeadlessContext::makeCurrent(void) throw(ContextException) { glfwMakeContextCurrent(impl->window); }
+    
+#endif
+    
+    string HeadlessContext::getBackendName(void) { return impl->backend; }
+}
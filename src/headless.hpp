@@ -0,0 +1,42 @@
+#ifndef GLSL_UTILITIES_HEADLESS
+#define GLSL_UTILITIES_HEADLESS
+
+#include <stdexcept>
+#include <string>
+
+namespace glslu
+{
+    class ContextException: public std::runtime_error
+    {
+    public:
+	ContextException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // An OpenGL context without a visible window.
+    //
+    // The backend is picked at build time to match the loader:
+    //   -DGLSLU_USE_EGL     EGL on a surfaceless (or pbuffer) display, e.g. Mesa llvmpipe
+    //   -DGLSLU_USE_OSMESA  Mesa's off-screen renderer into client memory
+    //   (neither)           a hidden GLFW window, for desktop builds
+    // The context is current on the creating thread once constructed.
+    class HeadlessContext
+    {
+    private:
+	struct Implementation;
+	Implementation* impl;
+	
+	// Prevent object copying
+	HeadlessContext(const HeadlessContext& other) {}
+	HeadlessContext& operator=(const HeadlessContext& other) { return *this; }
+	
+    public:
+	HeadlessContext(int major, int minor, int width = 1, int height = 1) throw (ContextException);
+	~HeadlessContext(void);
+	
+	// Throws when the context cannot be made current
+	void makeCurrent(void) throw (ContextException);
+	std::string getBackendName(void);
+    };
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "indirect.hpp"
+
+#include "capabilities.hpp"
+#include "glslu_deletion.hpp"
+#include "jobs.hpp"
+
+namespace forever
+{
+    // Path names for reports
+    const char* getDrawPathName(DrawPath path)
+    {
+	switch(path) {
+	case DIRECT_DRAW_PATH:
+	    return "direct";
+	    
+	case INDIRECT_DRAW_PATH:
+	    return "indirect";
+	    
+	default:
+	    return "unknown";
+	}
+    }
+    
+    // Constructor
+    DrawBatch::DrawBatch(void):
+	commandBuffer(0), commandBufferSize(0), dirty(false)
+    {}
+    
+    // Deconstructor!
+    DrawBatch::~DrawBatch(void)
+    {
+	glslu::releaseObject(glslu::BUFFER_OBJECT, commandBuffer);
+    }
+    
+    // Drop every command
+    void DrawBatch::clear(void)
+    {
+	commands.clear();
+	dirty = true;
+    }
+    
+    // Queue a range of instances of one part
+    void DrawBatch::add(const MeshPart& part, GLuint firstInstance, GLuint instanceCount)
+    {
+	DrawElementsIndirectCommand command = {(GLuint)part.indexCount, instanceCount, part.firstIndex, part.baseVertex, firstInstance};
+	
+	commands.push_back(command);
+	dirty = true;
+    }
+    
+    // One command per instance, written in place
+    void DrawBatch::addEach(const MeshPart& part, GLuint firstInstance, GLuint instanceCount, JobSystem* jobs)
+    {
+	if(instanceCount == 0)
+	    return;
+	
+	size_t first = commands.size();
+	commands.resize(first + instanceCount);
+	dirty = true;
+	
+	DrawElementsIndirectCommand* target = &commands[first];
+	auto fill = [=](size_t begin, size_t end) {
+	    for(size_t curr = begin; curr < end; ++curr) {
+		DrawElementsIndirectCommand command = {(GLuint)part.indexCount, 1, part.firstIndex, part.baseVertex, firstInstance + (GLuint)curr};
+		target[curr] = command;
+	    }
+	};
+	
+	if(jobs)
+	    jobs->parallelFor(0, instanceCount, 4096, fill);
+	else
+	    fill(0, instanceCount);
+    }
+    
+    // Accessors
+    GLsizei DrawBatch::getCommandCount(void) { return (GLsizei)commands.size(); }
+    GLuint DrawBatch::getCommandBuffer(void) { return commandBuffer; }
+    
+    // Instances across every command
+    GLuint DrawBatch::getInstanceCount(void)
+    {
+	GLuint instanceCount = 0;
+	
+	for(size_t curr = 0; curr < commands.size(); ++curr)
+	    instanceCount += commands[curr].instanceCount;
+	
+	return instanceCount;
+    }
+    
+    // Copy changed commands to the GPU, growing the buffer as needed
+    void DrawBatch::upload(void)
+    {
+	GLsizeiptr size = commands.size() * sizeof(DrawElementsIndirectCommand);
+	
+	if(commandBuffer == 0)
+	    gl::GenBuffers(1, &commandBuffer);
+	
+	gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, commandBuffer);
+	
+	if(size > commandBufferSize) {
+	    gl::BufferData(gl::DRAW_INDIRECT_BUFFER, size, &commands[0], gl::STATIC_DRAW);
+	    commandBufferSize = size;
+	} else if(size > 0) {
+	    gl::BufferSubData(gl::DRAW_INDIRECT_BUFFER, 0, size, &commands[0]);
+	}
+	
+	dirty = false;
+    }
+    
+    // Submission
+    GLsizei DrawBatch::draw(Mesh& mesh, DrawPath path)
+    {
+	if(commands.empty())
+	    return 0;
+	
+	if(path == INDIRECT_DRAW_PATH && getCapabilities().multiDrawIndirect) {
+	    if(dirty)
+		upload();
+	    
+	    mesh.bind();
+	    gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, commandBuffer);
+	    gl::MultiDrawElementsIndirect(gl::TRIANGLES, gl::UNSIGNED_SHORT, 0, (GLsizei)commands.size(), 0);
+	    gl::BindBuffer(gl::DRAW_INDIRECT_BUFFER, 0);
+	    
+	    return 1;
+	}
+	
+	// One call per command
+	for(size_t curr = 0; curr < commands.size(); ++curr) {
+	    const DrawElementsIndirectCommand& command = commands[curr];
+	    MeshPart part = {command.firstIndex, (GLsizei)command.count, command.baseVertex};
+	    
+	    mesh.drawInstanced(part, command.baseInstance, (GLsizei)command.instanceCount);
+	}
+	
+	return (GLsizei)commands.size();
+    }
+    
+    // Scene commands
+    void addPartDraws(DrawBatch& batch, Mesh& mesh, const std::vector<GLuint>& partCounts, bool perObject, JobSystem* jobs)
+    {
+	GLuint firstInstance = 0;
+	
+	for(size_t part = 0; part < partCounts.size() && part < mesh.getPartCount(); ++part) {
+	    if(perObject) {
+		batch.addEach(mesh.getPart(part), firstInstance, partCounts[part], jobs);
+	    } else if(partCounts[part] > 0) {
+		batch.add(mesh.getPart(part), firstInstance, partCounts[part]);
+	    }
+	    
+	    firstInstance += partCounts[part];
+	}
+    }
+}
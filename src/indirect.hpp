@@ -0,0 +1,80 @@
+#ifndef FOREVER_INDIRECT
+#define FOREVER_INDIRECT
+
+#include <cstddef>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+#include "mesh.hpp"
+
+namespace forever
+{
+    class JobSystem;
+    
+    // Record layout GL reads from DRAW_INDIRECT_BUFFER
+    struct DrawElementsIndirectCommand
+    {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+    };
+    
+    // How a DrawBatch reaches the GPU
+    enum DrawPath
+    {
+	DIRECT_DRAW_PATH,       // one draw call per command
+	INDIRECT_DRAW_PATH      // every command in one MultiDrawElementsIndirect
+    };
+    
+    const char* getDrawPathName(DrawPath path);
+    
+    // Draw commands against one mesh, kept in a GPU-side command buffer.
+    // Each command draws a range of instances of one part; per-draw data is
+    // reached through the instance attributes, offset by baseInstance.
+    class DrawBatch
+    {
+    private:
+	GLuint commandBuffer;
+	GLsizeiptr commandBufferSize;
+	std::vector<DrawElementsIndirectCommand> commands;
+	bool dirty;
+	
+	// Prevent object copying
+	DrawBatch(const DrawBatch& other) {}
+	DrawBatch& operator=(const DrawBatch& other) { return *this; }
+	
+	void upload(void);
+	
+    public:
+	DrawBatch(void);
+	~DrawBatch(void);
+	
+	void clear(void);
+	void add(const MeshPart& part, GLuint firstInstance, GLuint instanceCount);
+	
+	// A single-instance command for each of instanceCount instances,
+	// filled in across jobs when given
+	void addEach(const MeshPart& part, GLuint firstInstance, GLuint instanceCount, JobSystem* jobs = NULL);
+	
+	GLsizei getCommandCount(void);
+	GLuint getInstanceCount(void);
+	
+	// Command buffer as of the last draw
+	GLuint getCommandBuffer(void);
+	
+	// Submit every command, returns the number of draw calls it took.
+	// The indirect path falls back to direct draws on contexts without
+	// multi-draw-indirect.
+	GLsizei draw(Mesh& mesh, DrawPath path);
+    };
+    
+    // Queue instances laid out part by part, partCounts[part] each as
+    // buildInstanceGrid leaves them: one command per part, or one per
+    // instance to stand in for a scene of individual objects, built across
+    // jobs when given.
+    void addPartDraws(DrawBatch& batch, Mesh& mesh, const std::vector<GLuint>& partCounts, bool perObject, JobSystem* jobs = NULL);
+}
+
+#endif
@@ -0,0 +1,154 @@
+#include "instances.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+using std::vector;
+
+namespace forever
+{
+    // Cubes per grid edge
+    static size_t getGridSide(size_t count)
+    {
+	size_t side = (size_t)std::ceil(std::cbrt((double)count));
+	
+	// cbrt can land just short on exact cubes
+	while(side * side * side < count)
+	    ++side;
+	
+	return side > 0 ? side : 1;
+    }
+    
+    // Seeded grid of shapes
+    void buildInstanceGrid(vector<Instance>& instances, vector<GLuint>& partCounts, size_t count, size_t partCount, float spacing, unsigned int seed)
+    {
+	std::mt19937 random(seed);
+	std::uniform_int_distribution<int> channel(64, 255);
+	std::uniform_int_distribution<size_t> shape(0, partCount > 0 ? partCount - 1 : 0);
+	std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+	
+	size_t side = getGridSide(count);
+	float origin = -0.5f * spacing * (side - 1);
+	
+	// Pick every cell's part first so the instances can be bucketed
+	vector<size_t> cellParts(count, 0);
+	partCounts.assign(partCount, 0);
+	
+	for(size_t index = 0; index < count; ++index) {
+	    if(count > 1)
+		cellParts[index] = shape(random);
+	    
+	    ++partCounts[cellParts[index]];
+	}
+	
+	vector<size_t> next(partCount, 0);
+	
+	for(size_t part = 1; part < partCount; ++part)
+	    next[part] = next[part - 1] + partCounts[part - 1];
+	
+	instances.resize(count);
+	
+	for(size_t index = 0; index < count; ++index) {
+	    Instance& instance = instances[next[cellParts[index]]++];
+	    
+	    // Identity rotation and scale, translation in the last column
+	    for(int element = 0; element < 16; ++element)
+		instance.transform[element] = (element % 5 == 0) ? 1.0f : 0.0f;
+	    
+	    instance.transform[12] = origin + spacing * (index % side);
+	    instance.transform[13] = origin + spacing * ((index / side) % side);
+	    instance.transform[14] = origin + spacing * (index / (side * side));
+	    
+	    // A lone cube keeps the plain white look
+	    for(int component = 0; component < 3; ++component)
+		instance.colour[component] = count > 1 ? (GLubyte)channel(random) : 255;
+	    
+	    instance.colour[3] = 255;
+	    instance.phase = count > 1 ? phase(random) : 0.0f;
+	    
+	    // The whole of layer 0 until given a texture
+	    instance.surface[0] = instance.surface[1] = 0;
+	    instance.surface[2] = instance.surface[3] = 65535;
+	    instance.layer = 0.0f;
+	}
+    }
+    
+    // Hub, pivot, then the satellites, depth first
+    void buildInstanceClusters(const vector<Instance>& instances, size_t clusterSize, SceneGraph& graph, vector<int>& instanceNodes, vector<ClusterPivot>& pivots, unsigned int seed)
+    {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	
+	graph.clear();
+	instanceNodes.assign(instances.size(), -1);
+	pivots.clear();
+	
+	if(clusterSize < 1)
+	    clusterSize = 1;
+	
+	for(size_t first = 0; first < instances.size(); first += clusterSize) {
+	    const float* translation = instances[first].transform + 12;
+	    glm::mat4 hub = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(translation[0], translation[1], translation[2])), glm::vec3(0.5f));
+	    
+	    int root = graph.addNode(-1, hub);
+	    instanceNodes[first] = root;
+	    
+	    size_t satellites = std::min(clusterSize, instances.size() - first) - 1;
+	    
+	    if(satellites == 0)
+		continue;
+	    
+	    // Tilted a little off vertical so the rings do not all line up
+	    ClusterPivot pivot;
+	    pivot.node = graph.addNode(root, glm::mat4(1.0f));
+	    pivot.rate = unit(random) < 0.5f ? 0.0f : 0.3f + 0.9f * unit(random);
+	    pivot.axis = glm::normalize(glm::vec3(unit(random) - 0.5f, 2.0f, unit(random) - 0.5f));
+	    pivots.push_back(pivot);
+	    
+	    // A ring around the pivot axis, inside the grid cell
+	    glm::vec3 side = glm::normalize(glm::cross(pivot.axis, glm::vec3(1.0f, 0.0f, 0.0f)));
+	    
+	    for(size_t satellite = 0; satellite < satellites; ++satellite) {
+		float angle = 6.2831853f * satellite / satellites;
+		glm::mat4 local = glm::translate(glm::rotate(glm::mat4(1.0f), angle, pivot.axis), side * 1.5f);
+		
+		instanceNodes[first + 1 + satellite] = graph.addNode(pivot.node, glm::scale(local, glm::vec3(0.5f)));
+	    }
+	}
+    }
+    
+    // Still clusters are left alone, so their nodes stay clean
+    void orbitClusters(SceneGraph& graph, const vector<ClusterPivot>& pivots, double time)
+    {
+	for(size_t curr = 0; curr < pivots.size(); ++curr)
+	    if(pivots[curr].rate != 0.0f)
+		graph.setLocal(pivots[curr].node, glm::rotate(glm::mat4(1.0f), (float)std::fmod(pivots[curr].rate * time, 6.283185307179586), pivots[curr].axis));
+    }
+    
+    // Rects go in as normalized shorts
+    void assignInstanceSurfaces(vector<Instance>& instances, const vector<TextureRegion>& regions)
+    {
+	if(regions.empty())
+	    return;
+	
+	for(size_t curr = 0; curr < instances.size(); ++curr) {
+	    const TextureRegion& region = regions[curr % regions.size()];
+	    
+	    for(int axis = 0; axis < 2; ++axis) {
+		instances[curr].surface[axis] = (GLushort)std::lround(region.offset[axis] * 65535.0f);
+		instances[curr].surface[axis + 2] = (GLushort)std::lround(region.scale[axis] * 65535.0f);
+	    }
+	    
+	    instances[curr].layer = (GLfloat)region.layer;
+	}
+    }
+    
+    // Grid half-width
+    float getGridExtent(size_t count, float spacing)
+    {
+	return 0.5f * spacing * getGridSide(count);
+    }
+}
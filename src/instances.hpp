@@ -0,0 +1,46 @@
+#ifndef FOREVER_INSTANCES
+#define FOREVER_INSTANCES
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+#include "scenegraph.hpp"
+#include "texturearray.hpp"
+
+namespace forever
+{
+    // Lay count instances out on the smallest cubic grid that holds them,
+    // centered on the origin, spacing units apart. Colours, phases and which
+    // of partCount mesh parts each cell shows are random but seeded, so
+    // every run draws the same scene. Instances come out grouped by part,
+    // partCounts[part] of them each, so a part's instances are contiguous.
+    void buildInstanceGrid(std::vector<Instance>& instances, std::vector<GLuint>& partCounts, size_t count, size_t partCount, float spacing, unsigned int seed = 1);
+    
+    // Spinning node a cluster's satellites hang from
+    struct ClusterPivot
+    {
+	int node;
+	float rate;             // radians a second, zero for a still cluster
+	glm::vec3 axis;
+    };
+    
+    // Regroup the instances into clusters of clusterSize in graph: the first
+    // of each stays on its grid cell at half size, the rest ring it on a
+    // pivot. Half the clusters hold still. instanceNodes gets the node each
+    // instance is drawn at.
+    void buildInstanceClusters(const std::vector<Instance>& instances, size_t clusterSize, SceneGraph& graph, std::vector<int>& instanceNodes, std::vector<ClusterPivot>& pivots, unsigned int seed = 1);
+    
+    // Turn every moving pivot to where it is at time
+    void orbitClusters(SceneGraph& graph, const std::vector<ClusterPivot>& pivots, double time);
+    
+    // Give the instances the regions of a texture array in turn
+    void assignInstanceSurfaces(std::vector<Instance>& instances, const std::vector<TextureRegion>& regions);
+    
+    // Half the width of the grid buildInstanceGrid would lay out
+    float getGridExtent(size_t count, float spacing);
+}
+
+#endif
@@ -0,0 +1,327 @@
+#include "jobs.hpp"
+
+#include <sstream>
+
+#include "profiler.hpp"
+
+using std::vector;
+
+namespace forever
+{
+    // Unit of work
+    struct Job
+    {
+	std::function<void()> work;
+	JobCounter* counter;
+    };
+    
+    namespace JobInfo {
+	// Which pool, and which worker in it, the calling thread is
+	thread_local const JobSystem* system = NULL;
+	thread_local int worker = -1;
+	
+	// Idle rounds before a worker goes to sleep
+	const int SPIN_ROUNDS = 64;
+    }
+    
+    // Constructor
+    JobDeque::JobDeque(size_t capacity):
+	top(0), bottom(0)
+    {
+	size_t size = 16;
+	
+	while(size < capacity)
+	    size *= 2;
+	
+	jobs = vector<std::atomic<Job*> >(size);
+	mask = size - 1;
+    }
+    
+    // Owner end
+    bool JobDeque::push(Job* job)
+    {
+	long long b = bottom.load(std::memory_order_relaxed);
+	long long t = top.load(std::memory_order_acquire);
+	
+	if(b - t > (long long)mask)
+	    return false;
+	
+	jobs[b & mask].store(job, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_release);
+	bottom.store(b + 1, std::memory_order_relaxed);
+	
+	return true;
+    }
+    
+    Job* JobDeque::pop(void)
+    {
+	long long b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = top.load(std::memory_order_relaxed);
+	
+	if(t > b) {
+	    bottom.store(b + 1, std::memory_order_relaxed);
+	    return NULL;
+	}
+	
+	Job* job = jobs[b & mask].load(std::memory_order_acquire);
+	
+	// Last one left, race the thieves for it
+	if(t == b) {
+	    if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		job = NULL;
+	    
+	    bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	
+	return job;
+    }
+    
+    // Thief end
+    Job* JobDeque::steal(void)
+    {
+	long long t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = bottom.load(std::memory_order_acquire);
+	
+	if(t >= b)
+	    return NULL;
+	
+	Job* job = jobs[t & mask].load(std::memory_order_acquire);
+	
+	if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	    return NULL;
+	
+	return job;
+    }
+    
+    // Constructor
+    JobSystem::JobSystem(int threadCount):
+	sleeping(0), stopping(false)
+    {
+	if(threadCount <= 0)
+	    threadCount = std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : 1;
+	
+	for(int curr = 0; curr < threadCount; ++curr)
+	    deques.push_back(new JobDeque());
+	
+	JobInfo::system = this;
+	JobInfo::worker = 0;
+	
+	for(int curr = 1; curr < threadCount; ++curr)
+	    threads.push_back(std::thread(&JobSystem::workerMain, this, curr));
+    }
+    
+    // Deconstructor! Outstanding jobs are dropped, wait on them first
+    JobSystem::~JobSystem(void)
+    {
+	{
+	    std::lock_guard<std::mutex> guard(sleepLock);
+	    stopping.store(true);
+	    wake.notify_all();
+	}
+	
+	for(size_t curr = 0; curr < threads.size(); ++curr)
+	    threads[curr].join();
+	
+	for(size_t curr = 0; curr < deques.size(); ++curr)
+	    delete deques[curr];
+	
+	if(JobInfo::system == this) {
+	    JobInfo::system = NULL;
+	    JobInfo::worker = -1;
+	}
+    }
+    
+    // Accessors
+    int JobSystem::getThreadCount(void) const { return (int)deques.size(); }
+    
+    int JobSystem::getWorkerIndex(void) const
+    {
+	return JobInfo::system == this ? JobInfo::worker : -1;
+    }
+    
+    // Make a job runnable, waking a sleeper if there is one
+    void JobSystem::push(Job* job)
+    {
+	int worker = getWorkerIndex();
+	
+	if(worker < 0 || !deques[worker]->push(job)) {
+	    std::lock_guard<std::mutex> guard(injectLock);
+	    injected.push_back(job);
+	}
+	
+	// Pairs with the sleeper's fence, so either it sees the job or we see it
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	
+	if(sleeping.load(std::memory_order_relaxed) > 0) {
+	    std::lock_guard<std::mutex> guard(sleepLock);
+	    wake.notify_one();
+	}
+    }
+    
+    // Own deque first, newest first; then the shared queue; then steal
+    Job* JobSystem::find(int worker)
+    {
+	if(worker >= 0)
+	    if(Job* job = deques[worker]->pop())
+		return job;
+	
+	{
+	    std::lock_guard<std::mutex> guard(injectLock);
+	    
+	    if(!injected.empty()) {
+		Job* job = injected.front();
+		injected.pop_front();
+		return job;
+	    }
+	}
+	
+	for(size_t curr = 1; curr <= deques.size(); ++curr) {
+	    size_t victim = (worker + curr) % deques.size();
+	    
+	    if((int)victim != worker)
+		if(Job* job = deques[victim]->steal())
+		    return job;
+	}
+	
+	return NULL;
+    }
+    
+    // Run one, then let its dependents go if it was the last of its counter
+    void JobSystem::run(Job* job)
+    {
+	job->work();
+	
+	if(JobCounter* counter = job->counter) {
+	    vector<Job*> ready;
+	    
+	    {
+		std::lock_guard<std::mutex> guard(counter->lock);
+		
+		if(counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		    ready.swap(counter->waiting);
+	    }
+	    
+	    for(size_t curr = 0; curr < ready.size(); ++curr)
+		push(ready[curr]);
+	}
+	
+	delete job;
+    }
+    
+    // Queue work
+    void JobSystem::submit(const std::function<void()>& work, JobCounter* counter, JobCounter* dependency)
+    {
+	Job* job = new Job;
+	job->work = work;
+	job->counter = counter;
+	
+	if(counter)
+	    counter->count.fetch_add(1, std::memory_order_acq_rel);
+	
+	if(dependency) {
+	    std::lock_guard<std::mutex> guard(dependency->lock);
+	    
+	    if(!dependency->isDone()) {
+		dependency->waiting.push_back(job);
+		return;
+	    }
+	}
+	
+	push(job);
+    }
+    
+    // Help out until done
+    void JobSystem::wait(JobCounter& counter)
+    {
+	int worker = getWorkerIndex();
+	
+	while(!counter.isDone()) {
+	    if(Job* job = find(worker))
+		run(job);
+	    else
+		std::this_thread::yield();
+	}
+	
+	// The last job may still be inside the counter's lock; wait it out
+	// before the caller is free to destroy the counter
+	std::lock_guard<std::mutex> guard(counter.lock);
+    }
+    
+    // Ranges as jobs, the calling thread taking the first
+    void JobSystem::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+	if(end <= begin)
+	    return;
+	
+	if(grain < 1)
+	    grain = 1;
+	
+	if(end - begin <= grain || deques.size() == 1) {
+	    body(begin, end);
+	    return;
+	}
+	
+	JobCounter counter;
+	
+	for(size_t first = begin + grain; first < end; first += grain) {
+	    size_t last = end - first > grain ? first + grain : end;
+	    submit([&body, first, last]() { body(first, last); }, &counter);
+	}
+	
+	body(begin, begin + grain);
+	wait(counter);
+    }
+    
+    // Worker loop: run, steal, spin a little, then sleep until woken
+    void JobSystem::workerMain(int worker)
+    {
+	JobInfo::system = this;
+	JobInfo::worker = worker;
+	
+	if(Profiler::isEnabled()) {
+	    std::stringstream name;
+	    name << "worker " << worker;
+	    Profiler::setThreadName(name.str());
+	}
+	
+	int idle = 0;
+	
+	while(!stopping.load(std::memory_order_relaxed)) {
+	    if(Job* job = find(worker)) {
+		run(job);
+		idle = 0;
+		continue;
+	    }
+	    
+	    if(++idle < JobInfo::SPIN_ROUNDS) {
+		std::this_thread::yield();
+		continue;
+	    }
+	    
+	    // Announce the sleep and take a last look under the lock, so a push
+	    // in between either is seen here or finds us waiting to notify
+	    Job* job = NULL;
+	    
+	    {
+		std::unique_lock<std::mutex> guard(sleepLock);
+		sleeping.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		
+		job = find(worker);
+		
+		if(!job && !stopping.load())
+		    wake.wait_for(guard, std::chrono::milliseconds(10));
+		
+		sleeping.fetch_sub(1);
+	    }
+	    
+	    if(job) {
+		run(job);
+		idle = 0;
+	    }
+	}
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef FOREVER_JOBS
+#define FOREVER_JOBS
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace forever
+{
+    struct Job;
+    class JobSystem;
+    
+    // Counts the jobs tied to it that have yet to finish. Jobs submitted
+    // after a counter start only once it reaches zero, which is how job
+    // graphs are put together; JobSystem::wait() blocks on one.
+    class JobCounter
+    {
+    private:
+	friend class JobSystem;
+	
+	std::atomic<int> count;
+	std::mutex lock;
+	std::vector<Job*> waiting;
+	
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+	
+    public:
+	JobCounter(void): count(0) {}
+	
+	bool isDone(void) const { return count.load(std::memory_order_acquire) == 0; }
+    };
+    
+    // Chase-Lev work-stealing deque of fixed capacity. The owning thread
+    // pushes and pops at the bottom, any thread steals from the top.
+    class JobDeque
+    {
+    private:
+	std::vector<std::atomic<Job*> > jobs;
+	size_t mask;
+	std::atomic<long long> top;
+	std::atomic<long long> bottom;
+	
+	JobDeque(const JobDeque&);
+	JobDeque& operator=(const JobDeque&);
+	
+    public:
+	// Capacity is rounded up to a power of two
+	JobDeque(size_t capacity = 4096);
+	
+	// Owner only; false when full
+	bool push(Job* job);
+	Job* pop(void);
+	
+	// Any thread; NULL when empty or on losing a race
+	Job* steal(void);
+    };
+    
+    // Work-stealing thread pool.
+    //
+    // The creating thread counts as worker 0 and runs jobs whenever it waits;
+    // threads - 1 more are started. Each worker keeps a deque of the jobs it
+    // submitted and steals from the others when it runs dry. Jobs submitted
+    // from threads outside the pool go through a shared queue.
+    class JobSystem
+    {
+    private:
+	std::vector<JobDeque*> deques;
+	std::vector<std::thread> threads;
+	
+	std::mutex injectLock;
+	std::deque<Job*> injected;
+	
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::atomic<int> sleeping;
+	std::atomic<bool> stopping;
+	
+	int getWorkerIndex(void) const;
+	void push(Job* job);
+	Job* find(int worker);
+	void run(Job* job);
+	void release(JobCounter& counter);
+	void workerMain(int worker);
+	
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+	
+    public:
+	// Zero threads for one per core
+	JobSystem(int threads = 0);
+	~JobSystem(void);
+	
+	int getThreadCount(void) const;
+	
+	// Queue work. Counter, if given, counts it until done; it starts only
+	// after dependency, if given, reaches zero.
+	void submit(const std::function<void()>& work, JobCounter* counter = NULL, JobCounter* dependency = NULL);
+	
+	// Run jobs until the counter reaches zero
+	void wait(JobCounter& counter);
+	
+	// body(begin, end) over [begin, end) in ranges of about grain, across
+	// the pool and the calling thread, returning once all are done
+	void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+    };
+}
+
+#endif
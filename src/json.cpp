@@ -0,0 +1,39 @@
+#include "json.hpp"
+
+#include <cstdio>
+
+using std::string;
+
+namespace forever
+{
+    // Escapes
+    string quoteJson(const string& text)
+    {
+	string result = "\"";
+	
+	for(size_t curr = 0; curr < text.size(); ++curr) {
+	    unsigned char c = (unsigned char)text[curr];
+	    
+	    switch(c) {
+	    case '"':  result += "\\\""; break;
+	    case '\\': result += "\\\\"; break;
+	    case '\b': result += "\\b"; break;
+	    case '\f': result += "\\f"; break;
+	    case '\n': result += "\\n"; break;
+	    case '\r': result += "\\r"; break;
+	    case '\t': result += "\\t"; break;
+		
+	    default:
+		if(c < 0x20) {
+		    char escape[8];
+		    snprintf(escape, sizeof(escape), "\\u%04x", c);
+		    result += escape;
+		} else {
+		    result += (char)c;
+		}
+	    }
+	}
+	
+	return result + "\"";
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef FOREVER_JSON
+#define FOREVER_JSON
+
+#include <string>
+
+namespace forever
+{
+    // A JSON string literal of text, quotes included. Quotes, backslashes
+    // and control characters are escaped, anything else is passed through
+    // as UTF-8.
+    std::string quoteJson(const std::string& text);
+}
+
+#endif
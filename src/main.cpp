@@ -1,18 +1,311 @@
 #include <iostream>
+#include <iomanip>
 #include <sstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 #include "gl_core_4_4.hpp"
 #include <GLFW/glfw3.h>
 
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "glslu.hpp"
+#include "headless.hpp"
+#include "capabilities.hpp"
+#include "mesh.hpp"
+#include "instances.hpp"
+#include "indirect.hpp"
+#include "benchmarks.hpp"
+#include "streaming.hpp"
+#include "culling.hpp"
+#include "gpuculling.hpp"
+#include "clock.hpp"
+#include "pacing.hpp"
+#include "throttle.hpp"
+#include "rendertarget.hpp"
+#include "scenebench.hpp"
+#include "gpuprofiler.hpp"
+#include "profiler.hpp"
+#include "jobs.hpp"
+#include "transforms.hpp"
+#include "scenegraph.hpp"
+#include "renderqueue.hpp"
+#include "materials.hpp"
+#include "textures.hpp"
+#include "texturearray.hpp"
+#include "generated/cube_program.hpp"
+
 #define ERRLOG(errstr) std::cerr << "ERR [" << __FILE__ << ":" << __LINE__ << "] " << errstr << std::endl;
 
 void glfw_err_callback(int code, const char* message);
 
 using namespace std;
 
+// The cube program's interface, generated by glslu-reflect at build time
+typedef glslu::programs::CubeProgram CubeProgram;
+
+static_assert(sizeof(forever::Material) == sizeof(CubeProgram::Material), "forever::Material does not match cube.frag's Material block");
+
+static void usage(const char* name)
+{
+    cerr << "Usage: " << name << " [options]" << endl
+	 << "\t--instances <n>   number of shapes to draw (default 1)" << endl
+	 << "\t--draw <path>     instanced: one draw per shape type (default)" << endl
+	 << "\t                  objects: one draw per shape" << endl
+	 << "\t                  indirect: one multi-draw-indirect over every shape" << endl
+	 << "\t                  queue: one draw per shape, sorted by state and depth" << endl
+	 << "\t--materials <n>   queue draws cycle through n materials, one of them pulsing" << endl
+	 << "\t--texture <file>  shapes cycle through the TGA textures given, packed into one" << endl
+	 << "\t                  texture array (repeatable)" << endl
+	 << "\t--bind-textures   queue draws bind each texture on its own instead, streamed in" << endl
+	 << "\t                  in the background" << endl
+	 << "\t--upload-budget <KiB>  texture bytes uploaded per frame at most (default 1024)" << endl
+	 << "\t--stream <mode>   animate on the CPU and stream the instances every frame" << endl
+	 << "\t                  through persistent, unsynchronized, map-range or subdata" << endl
+	 << "\t--cull <shape>    frustum cull sphere or box bounds on the CPU every frame," << endl
+	 << "\t                  or gpu to cull spheres and build the draws in a compute pass" << endl
+	 << "\t--cull-isa <isa>  scalar, sse or avx2 (default: the widest available)" << endl
+	 << "\t--clusters <n>    group the shapes n at a time, the rest orbiting the first," << endl
+	 << "\t                  through a scene graph (streamed, no culling)" << endl
+	 << "\t--threads <n>     job threads for culling, animation and draw building" << endl
+	 << "\t                  (default: one per core)" << endl
+	 << "\t--tick-rate <hz>  fixed simulation rate (default 60)" << endl
+	 << "\t--pacing <mode>   vsync (default), adaptive vsync, or uncapped" << endl
+	 << "\t--fps <n>         no vsync, limit to n frames a second on the CPU" << endl
+	 << "\t--frames-in-flight <n>  frames the CPU may queue ahead of the GPU (default 2," << endl
+	 << "\t                  0 leaves it to the driver)" << endl
+	 << "\t--headless        render off-screen through EGL or OSMesa, no window" << endl
+	 << "\t--size <w>x<h>    window or off-screen frame size (default 640x480)" << endl
+	 << "\t--frames <n>      stop after n frames" << endl
+	 << "\t--profile         time each GPU pass, drawn as bars and shown in the title" << endl
+	 << "\t--trace <file>    write a Chrome trace of CPU zones and GPU passes at exit" << endl
+	 << "\t--bench           scripted run over a fixed camera path, JSON results to stdout" << endl
+	 << "\t--warmup <n>      frames run before --bench records (default 60)" << endl
+	 << "\t--bench-draws     time every draw path over the scene and exit" << endl
+	 << "\t--bench-uploads   time every instance upload path and exit" << endl
+	 << "\t--bench-cull      time every culling kernel and exit" << endl
+	 << "\t--bench-jobs      time the per-frame CPU work across job thread counts and exit" << endl
+	 << "\t--bench-transforms  time model matrix composition against plain glm and exit" << endl
+	 << "\t--bench-queue     compare render queue submission unsorted and sorted and exit" << endl
+	 << "\t--bench-textures  compare synchronous and streamed loading of the --texture" << endl
+	 << "\t                  files, or generated ones, and exit" << endl;
+}
+
+// Settings as text for the benchmark report
+template<typename T>
+static string toString(const T& value)
+{
+    stringstream buffer;
+    buffer << value;
+    return buffer.str();
+}
+
+// Seconds on a steady clock, the same with or without a window
+static double getTime(void)
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Bind whatever the frame is drawn into and cover it with the viewport
+static void bindFramebuffer(GLFWwindow* window, forever::RenderTarget* target, int& width, int& height)
+{
+    if(target) {
+	target->bind();
+	width = target->getWidth();
+	height = target->getHeight();
+    } else {
+	glfwGetFramebufferSize(window, &width, &height);
+	gl::Viewport(0, 0, width, height);
+    }
+}
+
+// Tear down whichever kind of context was created
+static void closeDisplay(GLFWwindow* window, glslu::HeadlessContext* context)
+{
+    if(context) {
+	delete context;
+    } else {
+	glfwDestroyWindow(window);
+	glfwTerminate();
+    }
+}
+
+// Delete whatever is still queued or in flight while the context is
+// current, then tear it down; neither may outlive the context with GL
+// objects left in it
+static void closeDisplay(GLFWwindow* window, glslu::HeadlessContext* context, forever::FrameThrottle& throttle, glslu::DeletionQueue& deletionQueue)
+{
+    throttle.release();
+    deletionQueue.flush();
+    glslu::DeletionQueue::setCurrent(NULL);
+    
+    closeDisplay(window, context);
+}
+
 int main(int argc, char* argv[])
 {
-    GLFWwindow* hWindow;
+    GLFWwindow* hWindow = NULL;
+    glslu::HeadlessContext* headlessContext = NULL;
+    bool headless = false;
+    int frameWidth = 640, frameHeight = 480;
+    long frameLimit = 0;
+    bool bench = false;
+    bool profile = false;
+    string traceFile;
+    int warmupFrames = 60;
+    size_t instanceCount = 1;
+    string drawPath = "instanced";
+    bool benchDraws = false;
+    bool benchUploads = false;
+    bool streaming = false;
+    forever::StreamMode streamMode = forever::PERSISTENT_STREAM;
+    bool culling = false;
+    bool gpuCulling = false;
+    double tickRate = 60.0;
+    forever::PacingMode pacingMode = forever::VSYNC_PACING;
+    double targetFps = 60.0;
+    int framesInFlight = 2;
+    bool benchCull = false;
+    bool benchJobs = false;
+    bool benchTransforms = false;
+    bool benchQueue = false;
+    bool benchTextures = false;
+    vector<string> textureFiles;
+    bool bindTextures = false;
+    GLsizeiptr uploadBudget = 1024 << 10;
+    size_t clusterSize = 0;
+    GLuint materialCount = 1;
+    forever::CullShape cullShape = forever::SPHERE_CULL;
+    forever::CullISA cullISA = forever::getBestCullISA();
+    int jobThreads = std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : 1;
+    
+    // Parse options
+    for(int arg = 1; arg < argc; ++arg) {
+	string option = argv[arg];
+	bool hasValue = arg + 1 < argc;
+	
+	if(option == "--instances" && hasValue && atol(argv[arg + 1]) > 0)
+	    instanceCount = (size_t)atol(argv[++arg]);
+	else if(option == "--draw" && hasValue && (string(argv[arg + 1]) == "instanced" || string(argv[arg + 1]) == "objects" || string(argv[arg + 1]) == "indirect" || string(argv[arg + 1]) == "queue"))
+	    drawPath = argv[++arg];
+	else if(option == "--headless")
+	    headless = true;
+	else if(option == "--size" && hasValue && sscanf(argv[arg + 1], "%dx%d", &frameWidth, &frameHeight) == 2 && frameWidth > 0 && frameHeight > 0)
+	    ++arg;
+	else if(option == "--frames" && hasValue && atol(argv[arg + 1]) > 0)
+	    frameLimit = atol(argv[++arg]);
+	else if(option == "--bench")
+	    bench = true;
+	else if(option == "--profile")
+	    profile = true;
+	else if(option == "--trace" && hasValue)
+	    traceFile = argv[++arg];
+	else if(option == "--warmup" && hasValue && isdigit(argv[arg + 1][0]))
+	    warmupFrames = atoi(argv[++arg]);
+	else if(option == "--bench-draws")
+	    benchDraws = true;
+	else if(option == "--bench-uploads")
+	    benchUploads = true;
+	else if(option == "--bench-cull")
+	    benchCull = true;
+	else if(option == "--bench-jobs")
+	    benchJobs = true;
+	else if(option == "--bench-transforms")
+	    benchTransforms = true;
+	else if(option == "--bench-queue")
+	    benchQueue = true;
+	else if(option == "--bench-textures")
+	    benchTextures = true;
+	else if(option == "--texture" && hasValue)
+	    textureFiles.push_back(argv[++arg]);
+	else if(option == "--bind-textures")
+	    bindTextures = true;
+	else if(option == "--upload-budget" && hasValue && atol(argv[arg + 1]) > 0)
+	    uploadBudget = (GLsizeiptr)atol(argv[++arg]) << 10;
+	else if(option == "--cull" && hasValue && string(argv[arg + 1]) == "gpu") {
+	    gpuCulling = true;
+	    ++arg;
+	} else if(option == "--cull" && hasValue && (string(argv[arg + 1]) == "sphere" || string(argv[arg + 1]) == "box")) {
+	    cullShape = string(argv[++arg]) == "box" ? forever::BOX_CULL : forever::SPHERE_CULL;
+	    culling = true;
+	} else if(option == "--cull-isa" && hasValue) {
+	    string name = argv[++arg];
+	    int isa = 0;
+	    
+	    while(isa < forever::CULL_ISA_COUNT && name != forever::getCullISAName((forever::CullISA)isa))
+		++isa;
+	    
+	    if(isa == forever::CULL_ISA_COUNT || !forever::isCullISASupported((forever::CullISA)isa)) {
+		cerr << "Culling kernel " << name << " is not available here" << endl;
+		return -1;
+	    }
+	    
+	    cullISA = (forever::CullISA)isa;
+	} else if(option == "--clusters" && hasValue && atol(argv[arg + 1]) > 1)
+	    clusterSize = (size_t)atol(argv[++arg]);
+	else if(option == "--materials" && hasValue && atol(argv[arg + 1]) > 0)
+	    materialCount = (GLuint)atol(argv[++arg]);
+	else if(option == "--threads" && hasValue && atoi(argv[arg + 1]) > 0)
+	    jobThreads = atoi(argv[++arg]);
+	else if(option == "--tick-rate" && hasValue && atof(argv[arg + 1]) > 0.0)
+	    tickRate = atof(argv[++arg]);
+	else if(option == "--pacing" && hasValue && (string(argv[arg + 1]) == "vsync" || string(argv[arg + 1]) == "adaptive" || string(argv[arg + 1]) == "uncapped")) {
+	    string name = argv[++arg];
+	    pacingMode = name == "vsync" ? forever::VSYNC_PACING : name == "adaptive" ? forever::ADAPTIVE_VSYNC_PACING : forever::UNCAPPED_PACING;
+	} else if(option == "--fps" && hasValue && atof(argv[arg + 1]) > 0.0) {
+	    targetFps = atof(argv[++arg]);
+	    pacingMode = forever::TARGET_FPS_PACING;
+	}
+	else if(option == "--frames-in-flight" && hasValue && isdigit(argv[arg + 1][0]))
+	    framesInFlight = atoi(argv[++arg]);
+	else if(option == "--stream" && hasValue && !streaming) {
+	    string name = argv[++arg];
+	    
+	    for(int mode = 0; mode < forever::STREAM_MODE_COUNT && !streaming; ++mode) {
+		if(name == forever::getStreamModeName((forever::StreamMode)mode)) {
+		    streamMode = (forever::StreamMode)mode;
+		    streaming = true;
+		}
+	    }
+	    
+	    if(!streaming) {
+		usage(argv[0]);
+		return -1;
+	    }
+	}
+	else {
+	    usage(argv[0]);
+	    return -1;
+	}
+    }
+    
+    // GPU culling keeps the instances on the GPU, nothing to stream;
+    // clusters move away from the bounds culling was given; only queued
+    // draws carry a material or bound texture of their own
+    bool perDrawState = materialCount > 1 || (bindTextures && !textureFiles.empty() && !benchTextures);
+    
+    if((gpuCulling && (culling || streaming)) || (clusterSize > 0 && (culling || gpuCulling)) || (perDrawState && (drawPath != "queue" || gpuCulling))) {
+	usage(argv[0]);
+	return -1;
+    }
+    
+    // Zones record from here on when tracing
+    if(!traceFile.empty()) {
+	forever::Profiler::setEnabled(true);
+	forever::Profiler::setThreadName("main");
+    }
+    
+    // Per-frame CPU work is spread over these, this thread included
+    forever::JobSystem jobs(jobThreads);
     
     // Set error callback, because GLFW is being persnickety.
     glfwSetErrorCallback([](int code, const char* message) -> void {
@@ -22,48 +315,70 @@ int main(int argc, char* argv[])
     cerr << "INITIALIZING SYSTEMS" << endl
          << "--------------------" << endl;
     
-    // Initialize GLFW and check for errors.
-    cerr << "\tGLFW ... \t";
-    
-    if(!glfwInit()) {
-	ERRLOG("Could not initialize GLFW!");
+    if(headless) {
+	// No display at all, the frames go to an off-screen target
+	cerr << "\tContext ... \t";
 	
-	glfwTerminate();
+	try {
+	    headlessContext = new glslu::HeadlessContext(3, 3, frameWidth, frameHeight);
+	} catch(glslu::ContextException& e) {
+	    ERRLOG(e.what());
+	    return -1;
+	}
 	
-	return -1;
+	cerr << "OK [" << headlessContext->getBackendName() << "]" << endl;
     } else {
-	cerr << "OK" << endl;
-    }
-
-    // Window Creation
-    cerr << "\tWindow ... \t";
-    
-    // Window hints to ensure GLFW context is proper.
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-
-    // Attempt to create window based on context.
-    hWindow = glfwCreateWindow(640, 480, "WINDOW", NULL, NULL);
-    if(!hWindow) {
-	ERRLOG("Could not create a window!");
-
-	glfwTerminate();
-	return -1;
-    } else {
-	cerr << "OK" << endl;
+	// Initialize GLFW and check for errors.
+	cerr << "\tGLFW ... \t";
+	
+	if(!glfwInit()) {
+	    ERRLOG("Could not initialize GLFW!");
+	    
+	    glfwTerminate();
+	    
+	    return -1;
+	} else {
+	    cerr << "OK" << endl;
+	}
+	
+	// Window Creation
+	cerr << "\tWindow ... \t";
+	
+	// Window hints to ensure GLFW context is proper.
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	
+	// Attempt to create window based on context.
+	hWindow = glfwCreateWindow(frameWidth, frameHeight, "WINDOW", NULL, NULL);
+	if(!hWindow) {
+	    ERRLOG("Could not create a window!");
+	    
+	    glfwTerminate();
+	    return -1;
+	} else {
+	    cerr << "OK" << endl;
+	}
+	
+	// Focus window context.
+	glfwMakeContextCurrent(hWindow);
     }
 
-    // Focus window context.
-    glfwMakeContextCurrent(hWindow);
-
     // Initialize GL using created loader.
     cerr << "\tLoad GL ... \t";
     
-    if(!gl::sys::LoadFunctions()) {
+    gl::exts::LoadTest loaded;
+    
+    {
+	PROFILE_ZONE("load GL");
+	loaded = gl::sys::LoadFunctions();
+    }
+    
+    if(!loaded) {
 	ERRLOG("Could not load OpenGL!");
 
-	glfwDestroyWindow(hWindow);
-	glfwTerminate();
+	closeDisplay(hWindow, headlessContext);
 	return -1;
     } else {
 	cerr << "OK [v" << gl::sys::GetMajorVersion() << "." << gl::sys::GetMinorVersion() << endl;
@@ -72,32 +387,741 @@ int main(int argc, char* argv[])
     // Attempt to get context
     cerr << "\tGL Context ... \t";
     
-    if(!glfwGetCurrentContext()) {
+    if(!headless && !glfwGetCurrentContext()) {
 	ERRLOG("Could not get context!");
 	
-	glfwDestroyWindow(hWindow);
-	glfwTerminate();
+	closeDisplay(hWindow, headlessContext);
 	return -1;
     } else {
 	cerr << "OK [v" << (gl::GetString(gl::VERSION) != NULL ? (const char*)gl::GetString(gl::VERSION) : "NULL") << "; GLSL v" << gl::GetString(gl::SHADING_LANGUAGE_VERSION) << "]" << endl;
     }
     
+    // Nothing to sync to off-screen and benchmarks run flat out; adaptive
+    // vsync needs the tear control extension, plain vsync otherwise
+    if((headless || bench) && (pacingMode == forever::VSYNC_PACING || pacingMode == forever::ADAPTIVE_VSYNC_PACING)) {
+	pacingMode = forever::UNCAPPED_PACING;
+    } else if(pacingMode == forever::ADAPTIVE_VSYNC_PACING && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+	cerr << "\tno adaptive vsync, using vsync" << endl;
+	pacingMode = forever::VSYNC_PACING;
+    }
+    
+    forever::FramePacer pacer(pacingMode, targetFps);
+    
+    if(!headless)
+	glfwSwapInterval(pacer.getSwapInterval());
+    
+    // Keeps the CPU from queueing frames ahead, in place of glFinish
+    forever::FrameThrottle throttle(framesInFlight);
+    
+    // Objects released from here on are deleted once the GPU is done with them
+    glslu::DeletionQueue deletionQueue;
+    glslu::DeletionQueue::setCurrent(&deletionQueue);
+    
+    // Everything the scene builds, released by releaseScene whichever of
+    // it exists when the run ends or a step fails
+    forever::RenderTarget* renderTarget = NULL;
+    glslu::Program* cubeProgram = NULL;
+    forever::MaterialBuffer* materials = NULL;
+    GLuint whiteTexture = 0, whiteArray = 0;
+    forever::TextureArray* textureArray = NULL;
+    forever::TextureStreamer* textureStreamer = NULL;
+    forever::Mesh* shapes = NULL;
+    GLuint instanceBuffer = 0;
+    forever::DrawBatch* batch = NULL;
+    glslu::Program* cullProgram = NULL;
+    forever::GpuCuller* gpuCuller = NULL;
+    forever::StreamBuffer* stream = NULL;
+    
+    // Newest first, then the context goes
+    auto releaseScene = [&]() {
+	delete stream;
+	delete gpuCuller;
+	delete cullProgram;
+	delete batch;
+	glslu::releaseObject(glslu::BUFFER_OBJECT, instanceBuffer);
+	delete shapes;
+	delete textureStreamer;
+	delete textureArray;
+	glslu::releaseObject(glslu::TEXTURE_OBJECT, whiteArray);
+	glslu::releaseObject(glslu::TEXTURE_OBJECT, whiteTexture);
+	delete materials;
+	delete cubeProgram;
+	delete renderTarget;
+	closeDisplay(hWindow, headlessContext, throttle, deletionQueue);
+    };
+    
+    // Off-screen frames are drawn into an FBO of the requested size
+    if(headless) {
+	cerr << "\tRender target ... \t";
+	
+	try {
+	    renderTarget = new forever::RenderTarget(frameWidth, frameHeight);
+	} catch(forever::RenderTargetException& e) {
+	    ERRLOG(e.what());
+	    
+	    releaseScene();
+	    return -1;
+	}
+	
+	cerr << "OK [" << frameWidth << "x" << frameHeight << "]" << endl;
+    }
+    
+    // Load the cube program, through the binary cache when possible
+    cerr << "\tShaders ... \t";
+    
+    cubeProgram = new glslu::Program();
+    
+    try {
+	// The generated uniform constants rely on layout(location = N)
+	if(!forever::getCapabilities().explicitUniformLocation)
+	    throw glslu::ProgramException("The cube program needs OpenGL 4.3 or GL_ARB_explicit_uniform_location");
+	
+	vector<string> sources;
+	sources.push_back("shaders/cube.vert");
+	sources.push_back("shaders/cube.frag");
+	
+	glslu::loadProgram(*cubeProgram, sources, "cache/cube.bin");
+	
+	// Uniforms go through glslu-reflect's constant locations from here on
+	CubeProgram::verify(*cubeProgram);
+	cubeProgram->setUniformBlockBinding("Material", 0);
+	
+	cubeProgram->use();
+	CubeProgram::surfaceArray::set(1);
+    } catch(glslu::ProgramException& e) {
+	ERRLOG(e.what());
+	
+	releaseScene();
+	return -1;
+    }
+    
+    cerr << "OK [" << (cubeProgram->getStats().cacheHit ? "cached" : "compiled") << "]" << endl;
+    
+    // Every material in one uniform buffer, the first the plain default
+    cerr << "\tMaterials ... \t";
+    
+    try {
+	materials = new forever::MaterialBuffer(materialCount);
+	forever::buildMaterials(*materials, materialCount);
+	materials->upload();
+	materials->bind(0, 0);
+    } catch(forever::MaterialException& e) {
+	ERRLOG(e.what());
+	
+	releaseScene();
+	return -1;
+    }
+    
+    cerr << "OK [" << materials->getCount() << ", " << materials->getStride() << "-byte slots]" << endl;
+    
+    // Untextured draws sample plain white. Textures pack into one array
+    // every instance indexes, or bound per draw they stream in over the
+    // first frames, drawn with a placeholder until then
+    whiteTexture = forever::createSolidTexture(255, 255, 255, 255);
+    whiteArray = forever::createSolidTexture(255, 255, 255, 255, gl::TEXTURE_2D_ARRAY);
+    vector<GLuint> surfaces;
+    
+    if(!textureFiles.empty() && !benchTextures) {
+	cerr << "\tTextures ... \t";
+	
+	try {
+	    if(bindTextures) {
+		textureStreamer = new forever::TextureStreamer(32 << 20, uploadBudget);
+		
+		for(size_t curr = 0; curr < textureFiles.size(); ++curr)
+		    surfaces.push_back(textureStreamer->load(textureFiles[curr]));
+	    } else {
+		textureArray = new forever::TextureArray(textureFiles, jobs);
+	    }
+	} catch(forever::TextureException& e) {
+	    ERRLOG(e.what());
+	    
+	    releaseScene();
+	    return -1;
+	}
+	
+	if(textureArray)
+	    cerr << "OK [" << textureFiles.size() << " in " << textureArray->getLayerCount() << " " << textureArray->getLayerSize() << "px layers, " << (int)(textureArray->getCoverage() * 100.0 + 0.5) << "% covered]" << endl;
+	else
+	    cerr << "OK [" << surfaces.size() << " requested, " << (textureStreamer->isPersistent() ? "persistent" : "client") << " staging]" << endl;
+    }
+    
+    // Upload every shape once into shared buffers
+    vector<forever::Vertex> vertices;
+    vector<GLushort> indices;
+    vector<forever::MeshPart> parts;
+    parts.push_back(forever::Mesh::buildCube(vertices, indices));
+    parts.push_back(forever::Mesh::buildOctahedron(vertices, indices));
+    parts.push_back(forever::Mesh::buildPyramid(vertices, indices));
+    
+    shapes = new forever::Mesh(vertices, indices, parts);
+    
+    // Per-instance transforms, colours and phases never change either, the
+    // animation runs in the vertex shader off the time uniform
+    cerr << "\tInstances ... \t";
+    
+    const float spacing = 2.0f;
+    vector<forever::Instance> instances;
+    vector<GLuint> partCounts;
+    forever::buildInstanceGrid(instances, partCounts, instanceCount, parts.size(), spacing);
+    
+    if(textureArray)
+	forever::assignInstanceSurfaces(instances, textureArray->getRegions());
+    
+    instanceBuffer = forever::createStaticBuffer(gl::ARRAY_BUFFER, instances.size() * sizeof(forever::Instance), &instances[0]);
+    shapes->setInstanceBuffer(instanceBuffer);
+    
+    cerr << "OK [" << instanceCount << "; " << (instances.size() * sizeof(forever::Instance)) / 1024 << " KiB]" << endl;
+    
+    // Build the scene's draw commands once
+    batch = new forever::DrawBatch();
+    forever::addPartDraws(*batch, *shapes, partCounts, drawPath != "instanced");
+    
+    forever::DrawPath path = drawPath == "indirect" ? forever::INDIRECT_DRAW_PATH : forever::DIRECT_DRAW_PATH;
+    
+    if(path == forever::INDIRECT_DRAW_PATH && !forever::getCapabilities().multiDrawIndirect)
+	cerr << "\tno multi-draw-indirect, drawing directly" << endl;
+    
+    // Compute culling over the static instances, writing its own draws
+    if(gpuCulling) {
+	cerr << "\tGPU culling ... \t";
+	cullProgram = new glslu::Program();
+	
+	try {
+	    glslu::loadProgram(*cullProgram, vector<string>(1, "shaders/cull.comp"), "cache/cull.bin");
+	    gpuCuller = new forever::GpuCuller(*cullProgram, *shapes, instanceBuffer, partCounts, 0.8660254f);
+	} catch(glslu::ProgramException& e) {
+	    ERRLOG(e.what());
+	    
+	    releaseScene();
+	    return -1;
+	}
+	
+	cerr << "OK [" << (cullProgram->getStats().cacheHit ? "cached" : "compiled") << "]" << endl;
+    }
+    
+    // Bounds for culling: the sphere every shape fits in whatever its spin
+    forever::CullingSet cullingSet;
+    vector<GLuint> visible, visibleCounts;
+    
+    if(culling || benchCull || benchJobs)
+	cullingSet.assign(instances, 0.8660254f);
+    
+    // Instances animated on the CPU or culled are rewritten every frame,
+    // culling gathering just the survivors
+    GLsizeiptr instanceBytes = instances.size() * sizeof(forever::Instance);
+    
+    if(streaming || culling || clusterSize > 0) {
+	cerr << "\tStreaming ... \t";
+	
+	// Persistent where the context has buffer storage, unless --stream chose
+	if(!streaming)
+	    streamMode = forever::getDefaultStreamMode();
+	
+	try {
+	    stream = new forever::StreamBuffer(gl::ARRAY_BUFFER, instanceBytes, streamMode);
+	} catch(forever::StreamException& e) {
+	    ERRLOG(e.what());
+	    
+	    releaseScene();
+	    return -1;
+	}
+	
+	cerr << "OK [" << forever::getStreamModeName(streamMode) << "]" << endl;
+    }
+    
+    // Streamed instances are composed from their decomposed transforms,
+    // spun about the same axis as cube.vert
+    const glm::vec3 spinAxis(0.70710678f, 0.70710678f, 0.0f);
+    forever::TransformSet transforms;
+    
+    if((streaming && clusterSize == 0) || benchTransforms || benchJobs)
+	transforms.assign(instances, spinAxis);
+    
+    // Per-shape draws for --draw queue, rebuilt and sorted every frame
+    forever::RenderQueue renderQueue;
+    renderQueue.setMaterials(materials, 0);
+    
+    // Clustered instances are drawn at scene graph nodes instead
+    forever::SceneGraph sceneGraph;
+    vector<int> instanceNodes;
+    vector<forever::ClusterPivot> clusterPivots;
+    
+    if(clusterSize > 0)
+	forever::buildInstanceClusters(instances, clusterSize, sceneGraph, instanceNodes, clusterPivots);
+    
+    // Pull the camera back far enough to take in the whole grid
+    float extent = forever::getGridExtent(instanceCount, spacing);
+    glm::vec3 eye = glm::vec3(0.0f, 1.5f, 3.0f) * (extent > 1.0f ? 1.4f * extent : 1.0f);
+    
     cerr << "SYSTEM ... OK" << endl
 	 << "RUNNING" << endl;
-
+    
+    gl::Enable(gl::DEPTH_TEST);
+    gl::Enable(gl::CULL_FACE);
+    gl::ClearColor(0.05f, 0.05f, 0.08f, 1.0f);
+    
+    bool running = true;
+    long framesRun = 0;
+    
+    // Draw path and upload comparisons, in place of the demo
+    if(benchDraws || benchUploads || benchCull || benchJobs || benchTransforms || benchQueue || benchTextures) {
+	int width, height;
+	bindFramebuffer(hWindow, renderTarget, width, height);
+	
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), height > 0 ? (float)width / height : 1.0f, 0.1f, 10.0f * extent + 100.0f);
+	
+	cubeProgram->use();
+	CubeProgram::viewProjection::set(projection * glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	CubeProgram::lightDirection::set(glm::normalize(glm::vec3(-0.5f, -1.0f, -0.8f)));
+	CubeProgram::eyePosition::set(eye);
+	CubeProgram::time::set(0.0f);
+	gl::ActiveTexture(gl::TEXTURE1);
+	gl::BindTexture(gl::TEXTURE_2D_ARRAY, whiteArray);
+	gl::ActiveTexture(gl::TEXTURE0);
+	gl::BindTexture(gl::TEXTURE_2D, whiteTexture);
+	
+	if(benchDraws)
+	    forever::printBenchmarkResults(cout, forever::benchmarkDrawPaths(*shapes, partCounts, 60));
+	
+	if(benchUploads)
+	    forever::printBenchmarkResults(cout, forever::benchmarkUploads(*shapes, instances, partCounts, 60));
+	
+	// Culling from the middle of the grid, so only some of it is in view
+	forever::Frustum inside = forever::extractFrustum(projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	
+	if(benchCull)
+	    forever::printBenchmarkResults(cout, forever::benchmarkCulling(cullingSet, inside, jobThreads, 20));
+	
+	if(benchJobs)
+	    forever::printBenchmarkResults(cout, forever::benchmarkJobs(cullingSet, transforms, inside, *shapes, instances, partCounts, jobThreads, 20));
+	
+	if(benchTransforms)
+	    forever::printBenchmarkResults(cout, forever::benchmarkTransforms(transforms, instances, jobs, 20));
+	
+	if(benchQueue)
+	    forever::printBenchmarkResults(cout, forever::benchmarkRenderQueue(*shapes, *cubeProgram, partCounts, jobs, 20));
+	
+	if(benchTextures) {
+	    try {
+		forever::printBenchmarkResults(cout, forever::benchmarkTextureLoading(textureFiles, uploadBudget));
+	    } catch(std::runtime_error& e) {
+		ERRLOG(e.what());
+	    }
+	}
+	
+	running = false;
+    }
+    
+    // Frame time baseline, reported once a second
+    double reportStart = getTime();
+    double lastFrame = reportStart;
+    double frameTimeTotal = 0.0;
+    double submitTimeTotal = 0.0;
+    long drawCallTotal = 0;
+    double cullTimeTotal = 0.0;
+    size_t visibleTotal = 0;
+    size_t nodesTotal = 0;
+    double queueTimeTotal = 0.0;
+    forever::RenderQueueStats queueTotals = {0, 0, 0, 0, 0};
+    materials->resetStats();
+    int frameCount = 0;
+    
+    // Simulation runs in fixed steps whatever the frame rate; the spin is
+    // its whole state, kept for the last two steps and blended for drawing
+    const double spinRate = 1.0;
+    forever::SimulationClock simulationClock(tickRate);
+    double previousSpin = 0.0, currentSpin = 0.0;
+    long long tickStart = 0;
+    
+    // Scripted run: the scene follows the frame count, not the clock
+    forever::SceneBenchmark* benchmark = NULL;
+    
+    if(bench) {
+	benchmark = new forever::SceneBenchmark(warmupFrames, frameLimit > 0 ? (int)frameLimit : 600);
+	benchmark->addSetting("instances", (long long)instanceCount);
+	benchmark->addSetting("draw", gpuCulling ? "gpu culled" : drawPath);
+	benchmark->addSetting("stream", stream ? forever::getStreamModeName(streamMode) : "static");
+	benchmark->addSetting("cull", gpuCulling ? "gpu" : culling ? (cullShape == forever::BOX_CULL ? "box" : "sphere") : "off");
+	benchmark->addSetting("cull_isa", culling ? forever::getCullISAName(cullISA) : "");
+	benchmark->addSetting("clusters", (long long)clusterSize);
+	benchmark->addSetting("threads", jobThreads);
+	benchmark->addSetting("tick_rate", tickRate);
+	benchmark->addSetting("pacing", forever::getPacingModeName(pacingMode));
+	benchmark->addSetting("frames_in_flight", framesInFlight);
+	benchmark->addSetting("size", toString(frameWidth) + "x" + toString(frameHeight));
+	benchmark->addSetting("headless", headless);
+	
+	frameLimit = 0;
+    }
+    
+    simulationClock.reset(benchmark ? 0.0 : getTime());
+    
+    // Per-pass GPU times, for the overlay and the benchmark report
+    forever::GpuProfiler* profiler = NULL;
+    
+    if(profile || bench || !traceFile.empty()) {
+	profiler = new forever::GpuProfiler();
+	
+	if(!profiler->isSupported())
+	    cerr << "\tno timer queries, not profiling the GPU" << endl;
+    }
+    
     // Enter main loop of application.
-    while(!glfwWindowShouldClose(hWindow)) {
+    while(running) {
+	PROFILE_ZONE("frame");
+	
+	// Before reading the clock, so the frame starts from fresh state
+	{
+	    PROFILE_ZONE("throttle");
+	    throttle.wait();
+	}
+	
+	double now = getTime();
+	int frameCalls;
+	long long frameBytes = 0;
+	
+	if(benchmark)
+	    benchmark->beginFrame();
+	
+	// Recording starts after the warm-up, for the passes too
+	if(profiler) {
+	    if(benchmark && benchmark->getFrame() == warmupFrames)
+		profiler->resetStats();
+	    
+	    profiler->beginFrame();
+	    profiler->begin("frame");
+	}
+	
+	// SIMULATE
+	{
+	    PROFILE_ZONE("simulate");
+	    
+	    for(int steps = simulationClock.advance(benchmark ? benchmark->getSceneTime() : now); steps > 0; --steps) {
+		previousSpin = currentSpin;
+		currentSpin += spinRate * simulationClock.getStep();
+	    }
+	}
+	
 	// RENDER
-
+	int width, height;
+	bindFramebuffer(hWindow, renderTarget, width, height);
+	
+	{
+	    forever::GpuProfiler::Scope pass(profiler, "clear");
+	    gl::Clear(gl::COLOR_BUFFER_BIT | gl::DEPTH_BUFFER_BIT);
+	}
+	
+	// A frame's worth of texture uploads, ahead of the draws sampling them
+	if(textureStreamer) {
+	    forever::GpuProfiler::Scope pass(profiler, "textures");
+	    textureStreamer->update();
+	}
+	
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), height > 0 ? (float)width / height : 1.0f, 0.1f, 10.0f * extent + 100.0f);
+	glm::vec3 frameEye = benchmark ? benchmark->getEye(glm::length(eye)) : eye;
+	glm::mat4 view = glm::lookAt(frameEye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	
+	// Compute pass first, it binds its own program
+	if(gpuCuller) {
+	    forever::GpuProfiler::Scope pass(profiler, "cull");
+	    gpuCuller->cull(forever::extractFrustum(projection * view));
+	}
+	
+	cubeProgram->use();
+	CubeProgram::viewProjection::set(projection * view);
+	CubeProgram::lightDirection::set(glm::normalize(glm::vec3(-0.5f, -1.0f, -0.8f)));
+	CubeProgram::eyePosition::set(frameEye);
+	
+	// Wrap the spin to one turn so the float keeps its precision
+	double spin = forever::interpolate(previousSpin, currentSpin, simulationClock.getAlpha());
+	GLfloat turn = (GLfloat)fmod(spin, 6.283185307179586);
+	
+	// Only the moving clusters have their nodes recomputed
+	if(clusterSize > 0) {
+	    forever::orbitClusters(sceneGraph, clusterPivots, spin);
+	    sceneGraph.update(&jobs);
+	    nodesTotal += sceneGraph.getRecomputedCount();
+	}
+	
+	// Survivors only, their draws rebuilt to match
+	if(culling) {
+	    PROFILE_ZONE("cull");
+	    double cullStart = getTime();
+	    cullingSet.cull(forever::extractFrustum(projection * view), cullShape, cullISA, visible, jobs);
+	    cullTimeTotal += getTime() - cullStart;
+	    visibleTotal += visible.size();
+	    
+	    forever::countVisibleParts(visible, partCounts, visibleCounts);
+	    batch->clear();
+	    forever::addPartDraws(*batch, *shapes, visibleCounts, drawPath != "instanced", &jobs);
+	}
+	
+	// Streamed instances animated on the CPU carry their spin already
+	if(stream) {
+	    PROFILE_ZONE("stream");
+	    forever::GpuProfiler::Scope pass(profiler, "upload");
+	    size_t count = culling ? visible.size() : instances.size();
+	    frameBytes = count * sizeof(forever::Instance);
+	    
+	    // Nothing in view leaves nothing to write, and a zero-length map fails
+	    if(count > 0) {
+		forever::Instance* target = (forever::Instance*)stream->map(frameBytes);
+		
+		// Each job writes its own stretch of the mapping
+		if(clusterSize > 0)
+		    jobs.parallelFor(0, count, 4096, [&](size_t begin, size_t end) {
+			    for(size_t curr = begin; curr < end; ++curr) {
+				forever::Instance instance = instances[curr];
+				memcpy(instance.transform, &sceneGraph.getWorld(instanceNodes[curr])[0][0], sizeof(instance.transform));
+				target[curr] = instance;
+			    }
+			});
+		else if(streaming)
+		    transforms.compose(target, count, glm::angleAxis(turn, spinAxis), cullISA, jobs, culling ? visible.data() : NULL);
+		else
+		    jobs.parallelFor(0, count, 4096, [&](size_t begin, size_t end) {
+			    for(size_t curr = begin; curr < end; ++curr)
+				target[curr] = instances[visible[curr]];
+			});
+		
+		shapes->setInstanceBuffer(stream->getBuffer(), stream->unmap());
+	    }
+	    
+	    if(streaming && clusterSize == 0)
+		turn = 0.0f;
+	}
+	
+	CubeProgram::time::set(turn);
+	
+	// The last material glows and fades, one slot re-sent a frame
+	if(materialCount > 1) {
+	    forever::Material pulse = materials->get(materialCount - 1);
+	    float glow = 0.25f + 0.25f * (float)sin(4.0 * spin);
+	    
+	    pulse.emissive[0] = glow * pulse.tint[0];
+	    pulse.emissive[1] = glow * pulse.tint[1];
+	    pulse.emissive[2] = glow * pulse.tint[2];
+	    materials->set(materialCount - 1, pulse);
+	}
+	
+	// Draws outside the queue all take the defaults, the queue binds its
+	// own; the texture array is shared by every draw
+	materials->upload();
+	materials->bind(0, 0);
+	gl::ActiveTexture(gl::TEXTURE1);
+	gl::BindTexture(gl::TEXTURE_2D_ARRAY, textureArray ? textureArray->getTexture() : whiteArray);
+	gl::ActiveTexture(gl::TEXTURE0);
+	gl::BindTexture(gl::TEXTURE_2D, whiteTexture);
+	
+	// Every shape a draw of its own, in key order rather than grid order
+	if(drawPath == "queue" && !gpuCuller) {
+	    PROFILE_ZONE("queue");
+	    double queueStart = getTime();
+	    const vector<GLuint>& counts = culling ? visibleCounts : partCounts;
+	    GLuint instance = 0;
+	    
+	    renderQueue.clear();
+	    renderQueue.setDepthRange(0.1f, 10.0f * extent + 100.0f);
+	    
+	    for(size_t part = 0; part < counts.size(); ++part) {
+		forever::RenderItem item = {cubeProgram, shapes, shapes->getPart(part), 0, 1, 0, whiteTexture};
+		
+		for(GLuint curr = 0; curr < counts[part]; ++curr, ++instance) {
+		    const float* translation = instances[culling ? visible[instance] : instance].transform + 12;
+		    
+		    item.firstInstance = instance;
+		    item.material = instance % materialCount;
+		    
+		    if(!surfaces.empty())
+			item.texture = surfaces[instance % surfaces.size()];
+		    renderQueue.add(forever::OPAQUE_PASS, item, -(view[0][2] * translation[0] + view[1][2] * translation[1] + view[2][2] * translation[2] + view[3][2]));
+		}
+	    }
+	    
+	    renderQueue.sort(&jobs);
+	    queueTimeTotal += getTime() - queueStart;
+	}
+	
+	{
+	    PROFILE_ZONE("draw");
+	    forever::GpuProfiler::Scope pass(profiler, "draw");
+	    
+	    if(gpuCuller) {
+		gpuCuller->draw(*shapes);
+		frameCalls = 1;
+	    } else if(drawPath == "queue") {
+		forever::RenderQueueStats stats = renderQueue.submit();
+		
+		queueTotals.draws += stats.draws;
+		queueTotals.programBinds += stats.programBinds;
+		queueTotals.vertexArrayBinds += stats.vertexArrayBinds;
+		queueTotals.textureBinds += stats.textureBinds;
+		queueTotals.materialChanges += stats.materialChanges;
+		frameCalls = stats.draws;
+	    } else {
+		frameCalls = batch->draw(*shapes, path);
+	    }
+	}
+	
+	drawCallTotal += frameCalls;
+	
+	if(stream)
+	    stream->fence();
+	
+	// The overlay itself goes unmeasured
+	if(profiler) {
+	    profiler->end();
+	    profiler->endFrame();
+	    
+	    if(profile)
+		profiler->drawOverlay(width, height);
+	}
+	
+	// CPU cost of issuing the frame, not waiting on it
+	double submitTime = getTime() - now;
+	submitTimeTotal += submitTime;
+	
 	// Window housekeeping...
-	glfwSwapBuffers(hWindow);
-	glfwPollEvents();
+	// Off-screen there is nothing to present, just get the frame started
+	{
+	    PROFILE_ZONE("pacing");
+	    pacer.wait();
+	}
+	
+	{
+	    PROFILE_ZONE("swap");
+	    
+	    if(hWindow)
+		glfwSwapBuffers(hWindow);
+	    else
+		gl::Flush();
+	}
+	
+	throttle.fence();
+	pacer.markFrame();
+	deletionQueue.endFrame();
+	
+	if(hWindow) {
+	    glfwPollEvents();
+	    running = !glfwWindowShouldClose(hWindow);
+	}
+	
+	if(frameLimit > 0 && ++framesRun >= frameLimit)
+	    running = false;
+	
+	// Frame timing
+	now = getTime();
+	frameTimeTotal += now - lastFrame;
+	
+	if(benchmark) {
+	    benchmark->endFrame(1000.0 * (now - lastFrame), 1000.0 * submitTime, frameCalls, frameBytes,
+				culling ? (long)visible.size() : gpuCuller ? -1 : (long)instanceCount);
+	    running = running && !benchmark->isDone();
+	}
+	
+	lastFrame = now;
+	++frameCount;
+	
+	if(now - reportStart >= 1.0) {
+	    double average = 1000.0 * frameTimeTotal / frameCount;
+	    
+	    cerr << "\tframe " << fixed << setprecision(3) << average << " ms (" << setprecision(1) << 1000.0 / average << " fps)"
+		 << ", submit " << setprecision(3) << 1000.0 * submitTimeTotal / frameCount << " ms"
+		 << ", " << instanceCount << " instances in " << drawCallTotal / frameCount << " draw calls (" << (gpuCuller ? "gpu culled" : drawPath) << ")";
+	    
+	    if(culling)
+		cerr << ", cull " << setprecision(3) << 1000.0 * cullTimeTotal / frameCount << " ms ("
+		     << setprecision(0) << instanceCount * frameCount / (1000.0 * cullTimeTotal) << " objects/ms, "
+		     << visibleTotal / frameCount << " visible, " << forever::getCullISAName(cullISA) << ")";
+	    
+	    if(clusterSize > 0)
+		cerr << ", " << nodesTotal / frameCount << " of " << sceneGraph.size() << " nodes recomputed";
+	    
+	    if(drawPath == "queue" && !gpuCuller)
+		cerr << ", queue " << setprecision(3) << 1000.0 * queueTimeTotal / frameCount << " ms ("
+		     << queueTotals.programBinds / frameCount << " program, " << queueTotals.vertexArrayBinds / frameCount << " vertex array, "
+		     << queueTotals.textureBinds / frameCount << " texture binds, " << queueTotals.materialChanges / frameCount << " material changes)";
+	    
+	    if(materialCount > 1)
+		cerr << ", " << materialCount << " materials, " << materials->getUploadedBytes() / frameCount << " bytes uploaded";
+	    
+	    if(textureStreamer) {
+		const forever::TextureStreamStats& textureStats = textureStreamer->getStats();
+		
+		cerr << ", textures " << textureStats.resident << " of " << textureStats.requested << " resident";
+		
+		if(textureStats.failed > 0)
+		    cerr << " (" << textureStats.failed << " failed)";
+		
+		cerr << ", " << textureStats.uploadedBytes / 1024 / frameCount << " KiB in " << textureStats.uploads / frameCount
+		     << " uploads, update max " << setprecision(3) << textureStats.maxUpdateTime << " ms";
+		
+		textureStreamer->resetStats();
+	    }
+	    
+	    forever::FrameStats frameStats = pacer.getStats();
+	    
+	    cerr << ", " << simulationClock.getTick() - tickStart << " ticks" << endl
+		 << "\t\t" << forever::getPacingModeName(pacingMode) << " p50 " << setprecision(3) << frameStats.p50
+		 << " p95 " << frameStats.p95 << " p99 " << frameStats.p99 << " max " << frameStats.max
+		 << " jitter " << frameStats.jitter << " ms"
+		 << ", " << throttle.getFramesInFlight() << " in flight, latency " << throttle.getLatency()
+		 << " ms (max " << throttle.getMaxLatency() << "), waited " << throttle.getWaitTime() / frameCount << " ms" << endl;
+	    
+	    // Rolling averages, so they settle rather than jump each second
+	    if(profile) {
+		stringstream passes;
+		const vector<forever::GpuPassStats>& stats = profiler->getStats();
+		
+		passes << fixed << setprecision(3) << "gpu";
+		
+		for(size_t curr = 0; curr < stats.size(); ++curr)
+		    passes << (curr > 0 ? ", " : " ") << stats[curr].name << " " << stats[curr].average;
+		
+		passes << " ms";
+		cerr << "\t\t" << passes.str() << endl;
+		
+		if(hWindow)
+		    glfwSetWindowTitle(hWindow, passes.str().c_str());
+	    }
+	    
+	    pacer.resetStats();
+	    throttle.resetStats();
+	    
+	    reportStart = now;
+	    tickStart = simulationClock.getTick();
+	    frameTimeTotal = 0.0;
+	    submitTimeTotal = 0.0;
+	    drawCallTotal = 0;
+	    cullTimeTotal = 0.0;
+	    visibleTotal = 0;
+	    nodesTotal = 0;
+	    queueTimeTotal = 0.0;
+	    queueTotals = forever::RenderQueueStats();
+	    materials->resetStats();
+	    frameCount = 0;
+	}
 	
 	// SPAAAAAAAAACESHIP!
 	[=](){;;;;};
     }
 
+    // Frames still in flight, for the reports
+    if(profiler && (benchmark || !traceFile.empty()))
+	profiler->finish();
+    
+    if(benchmark) {
+	benchmark->write(cout, profiler ? profiler->getStats() : vector<forever::GpuPassStats>());
+	delete benchmark;
+    }
+    
+    delete profiler;
+    
+    if(!traceFile.empty() && !forever::Profiler::writeChromeTrace(traceFile))
+	cerr << "Could not write trace " << traceFile << endl;
+    
     // Cleanup application and exit.
-    glfwTerminate();
+    releaseScene();
     return 0;
 }
@@ -0,0 +1,124 @@
+#include "materials.hpp"
+
+#include <cstring>
+#include <cmath>
+
+#include "glslu_deletion.hpp"
+
+namespace forever
+{
+    // White
+    Material getDefaultMaterial(void)
+    {
+	Material material = {{1.0f, 1.0f, 1.0f, 1.0f}, {0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f, 0.0f}};
+	return material;
+    }
+    
+    // Tints around the colour wheel, shininess climbing with them
+    void buildMaterials(MaterialBuffer& materials, GLuint count)
+    {
+	materials.create(getDefaultMaterial());
+	
+	for(GLuint curr = 1; curr < count; ++curr) {
+	    float hue = 6.2831853f * curr / count;
+	    Material material = {
+		{0.75f + 0.25f * std::cos(hue), 0.75f + 0.25f * std::cos(hue - 2.0943951f), 0.75f + 0.25f * std::cos(hue + 2.0943951f), 1.0f},
+		{0.4f, 0.4f, 0.4f, 8.0f + 56.0f * (curr % 8) / 7.0f},
+		{0.0f, 0.0f, 0.0f, 0.0f}
+	    };
+	    
+	    materials.create(material);
+	}
+    }
+    
+    // Constructor
+    MaterialBuffer::MaterialBuffer(GLuint capacity) throw(MaterialException):
+	buffer(0), stride(0), capacity(capacity), dirtyBegin(0), dirtyEnd(0), uploadedBytes(0)
+    {
+	if(capacity == 0)
+	    throw MaterialException("Material buffer needs room for at least one material");
+	
+	GLint alignment = 0, maxBlockSize = 0;
+	gl::GetIntegerv(gl::UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	gl::GetIntegerv(gl::MAX_UNIFORM_BLOCK_SIZE, &maxBlockSize);
+	
+	if(alignment < 1)
+	    alignment = 256;
+	
+	stride = ((GLsizeiptr)sizeof(Material) + alignment - 1) / alignment * alignment;
+	
+	if((GLsizeiptr)sizeof(Material) > maxBlockSize)
+	    throw MaterialException("Material block is larger than a uniform block may be");
+	
+	staging.assign(capacity * stride, 0);
+	
+	gl::GenBuffers(1, &buffer);
+	gl::BindBuffer(gl::UNIFORM_BUFFER, buffer);
+	gl::BufferData(gl::UNIFORM_BUFFER, capacity * stride, NULL, gl::DYNAMIC_DRAW);
+	gl::BindBuffer(gl::UNIFORM_BUFFER, 0);
+    }
+    
+    // Deconstructor!
+    MaterialBuffer::~MaterialBuffer(void)
+    {
+	glslu::releaseObject(glslu::BUFFER_OBJECT, buffer);
+    }
+    
+    // Claim the next slot
+    GLuint MaterialBuffer::create(const Material& material) throw(MaterialException)
+    {
+	if(materials.size() >= capacity)
+	    throw MaterialException("Material buffer is full");
+	
+	materials.push_back(material);
+	set((GLuint)materials.size() - 1, material);
+	
+	return (GLuint)materials.size() - 1;
+    }
+    
+    // Stage a change, widening the dirty range
+    void MaterialBuffer::set(GLuint index, const Material& material)
+    {
+	materials[index] = material;
+	std::memcpy(&staging[index * stride], &material, sizeof(Material));
+	
+	if(dirtyBegin == dirtyEnd) {
+	    dirtyBegin = index;
+	    dirtyEnd = index + 1;
+	} else {
+	    dirtyBegin = index < dirtyBegin ? index : dirtyBegin;
+	    dirtyEnd = index + 1 > dirtyEnd ? index + 1 : dirtyEnd;
+	}
+    }
+    
+    // Accessors
+    const Material& MaterialBuffer::get(GLuint index) const { return materials[index]; }
+    GLuint MaterialBuffer::getCount(void) const { return (GLuint)materials.size(); }
+    GLsizeiptr MaterialBuffer::getStride(void) const { return stride; }
+    GLuint MaterialBuffer::getBuffer(void) const { return buffer; }
+    GLsizeiptr MaterialBuffer::getUploadedBytes(void) const { return uploadedBytes; }
+    
+    void MaterialBuffer::resetStats(void) { uploadedBytes = 0; }
+    
+    // One copy covering every change since the last
+    void MaterialBuffer::upload(void)
+    {
+	if(dirtyBegin == dirtyEnd)
+	    return;
+	
+	GLsizeiptr size = (dirtyEnd - dirtyBegin) * stride;
+	
+	gl::BindBuffer(gl::UNIFORM_BUFFER, buffer);
+	gl::BufferSubData(gl::UNIFORM_BUFFER, dirtyBegin * stride, size, &staging[dirtyBegin * stride]);
+	gl::BindBuffer(gl::UNIFORM_BUFFER, 0);
+	
+	uploadedBytes += size;
+	dirtyBegin = dirtyEnd = 0;
+    }
+    
+    // Select by range
+    void MaterialBuffer::bind(GLuint binding, GLuint index)
+    {
+	gl::BindBufferRange(gl::UNIFORM_BUFFER, binding, buffer, index * stride, sizeof(Material));
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef FOREVER_MATERIALS
+#define FOREVER_MATERIALS
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    class MaterialException: public std::runtime_error
+    {
+    public:
+	MaterialException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // Surface parameters, laid out as the std140 Material block in
+    // cube.frag: 48 bytes
+    struct Material
+    {
+	GLfloat tint[4];        // multiplies the instance colour
+	GLfloat specular[4];    // rgb colour, a shininess exponent
+	GLfloat emissive[4];    // rgb added unlit, a unused
+    };
+    
+    // Plain white, no highlight, the look before materials
+    Material getDefaultMaterial(void);
+    
+    class MaterialBuffer;
+    
+    // The default, then count - 1 tinted and shiny variations
+    void buildMaterials(MaterialBuffer& materials, GLuint count);
+    
+    // Every material in one uniform buffer, a slot each.
+    //
+    // Slots are padded to UNIFORM_BUFFER_OFFSET_ALIGNMENT so a draw selects
+    // its material by binding that slot's range, with no uniform calls.
+    // Changes go to a copy in client memory and widen a dirty range, which
+    // upload() sends in one BufferSubData before the frame's draws.
+    class MaterialBuffer
+    {
+    private:
+	GLuint buffer;
+	GLsizeiptr stride;
+	GLuint capacity;
+	std::vector<Material> materials;
+	std::vector<unsigned char> staging;
+	GLuint dirtyBegin, dirtyEnd;
+	GLsizeiptr uploadedBytes;
+	
+	// Prevent object copying
+	MaterialBuffer(const MaterialBuffer& other) {}
+	MaterialBuffer& operator=(const MaterialBuffer& other) { return *this; }
+	
+    public:
+	MaterialBuffer(GLuint capacity = 1024) throw(MaterialException);
+	~MaterialBuffer(void);
+	
+	// A new slot, returning its index
+	GLuint create(const Material& material) throw(MaterialException);
+	
+	void set(GLuint index, const Material& material);
+	const Material& get(GLuint index) const;
+	
+	GLuint getCount(void) const;
+	GLsizeiptr getStride(void) const;
+	GLuint getBuffer(void) const;
+	
+	// Send the dirty slots, if any
+	void upload(void);
+	
+	// Point binding at one material's slot
+	void bind(GLuint binding, GLuint index);
+	
+	// Bytes upload() has sent since the last reset
+	GLsizeiptr getUploadedBytes(void) const;
+	void resetStats(void);
+    };
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include "mesh.hpp"
+
+#include <cstddef>
+#include <cmath>
+
+#include "capabilities.hpp"
+#include "glslu_deletion.hpp"
+
+using std::vector;
+
+namespace forever
+{
+    // Immutable buffer upload
+    GLuint createStaticBuffer(GLenum target, GLsizeiptr size, const void* data)
+    {
+	GLuint buffer = 0;
+	gl::GenBuffers(1, &buffer);
+	gl::BindBuffer(target, buffer);
+	
+	if(getCapabilities().bufferStorage)
+	    gl::BufferStorage(target, size, data, 0);
+	else
+	    gl::BufferData(target, size, data, gl::STATIC_DRAW);
+	
+	return buffer;
+    }
+    
+    // Constructor
+    Mesh::Mesh(const vector<Vertex>& vertices, const vector<GLushort>& indices):
+	vertexArray(0), vertexBuffer(0), indexBuffer(0), instanceBuffer(0), instanceOffset(0)
+    {
+	MeshPart part = {0, (GLsizei)indices.size(), 0};
+	parts.push_back(part);
+	
+	upload(vertices, indices);
+    }
+    
+    // Constructor, several parts
+    Mesh::Mesh(const vector<Vertex>& vertices, const vector<GLushort>& indices, const vector<MeshPart>& parts):
+	vertexArray(0), vertexBuffer(0), indexBuffer(0), instanceBuffer(0), instanceOffset(0), parts(parts)
+    {
+	upload(vertices, indices);
+    }
+    
+    // Deconstructor!
+    Mesh::~Mesh(void)
+    {
+	glslu::releaseObject(glslu::VERTEX_ARRAY_OBJECT, vertexArray);
+	glslu::releaseObject(glslu::BUFFER_OBJECT, vertexBuffer);
+	glslu::releaseObject(glslu::BUFFER_OBJECT, indexBuffer);
+    }
+    
+    // One-time upload
+    void Mesh::upload(const vector<Vertex>& vertices, const vector<GLushort>& indices)
+    {
+	gl::GenVertexArrays(1, &vertexArray);
+	gl::BindVertexArray(vertexArray);
+	
+	// Upload geometry once, the element binding is captured by the VAO
+	vertexBuffer = createStaticBuffer(gl::ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0]);
+	indexBuffer = createStaticBuffer(gl::ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0]);
+	
+	gl::EnableVertexAttribArray(POSITION_ATTRIBUTE);
+	gl::VertexAttribPointer(POSITION_ATTRIBUTE, 3, gl::FLOAT, gl::FALSE_, sizeof(Vertex), (const void*)offsetof(Vertex, position));
+	
+	gl::EnableVertexAttribArray(NORMAL_ATTRIBUTE);
+	gl::VertexAttribPointer(NORMAL_ATTRIBUTE, 4, gl::BYTE, gl::TRUE_, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+	
+	gl::BindVertexArray(0);
+    }
+    
+    // Accessors
+    GLuint Mesh::getVertexArray(void) { return vertexArray; }
+    size_t Mesh::getPartCount(void) { return parts.size(); }
+    const MeshPart& Mesh::getPart(size_t part) { return parts.at(part); }
+    
+    // Indices across every part
+    GLsizei Mesh::getIndexCount(void)
+    {
+	GLsizei indexCount = 0;
+	
+	for(size_t part = 0; part < parts.size(); ++part)
+	    indexCount += parts[part].indexCount;
+	
+	return indexCount;
+    }
+    
+    // Instance attributes advance once per instance instead of per vertex
+    void Mesh::setInstanceBuffer(GLuint buffer, GLintptr offset)
+    {
+	instanceBuffer = buffer;
+	instanceOffset = offset;
+	
+	gl::BindVertexArray(vertexArray);
+	setInstanceAttributes(offset);
+	gl::BindVertexArray(0);
+    }
+    
+    // Point the instance attributes of the bound VAO at offset
+    void Mesh::setInstanceAttributes(GLintptr offset)
+    {
+	gl::BindBuffer(gl::ARRAY_BUFFER, instanceBuffer);
+	
+	// A mat4 attribute is four vec4 columns
+	for(GLuint column = 0; column < 4; ++column) {
+	    gl::EnableVertexAttribArray(TRANSFORM_ATTRIBUTE + column);
+	    gl::VertexAttribPointer(TRANSFORM_ATTRIBUTE + column, 4, gl::FLOAT, gl::FALSE_, sizeof(Instance), (const void*)(offset + offsetof(Instance, transform) + column * 4 * sizeof(GLfloat)));
+	    gl::VertexAttribDivisor(TRANSFORM_ATTRIBUTE + column, 1);
+	}
+	
+	gl::EnableVertexAttribArray(COLOUR_ATTRIBUTE);
+	gl::VertexAttribPointer(COLOUR_ATTRIBUTE, 4, gl::UNSIGNED_BYTE, gl::TRUE_, sizeof(Instance), (const void*)(offset + offsetof(Instance, colour)));
+	gl::VertexAttribDivisor(COLOUR_ATTRIBUTE, 1);
+	
+	gl::EnableVertexAttribArray(PHASE_ATTRIBUTE);
+	gl::VertexAttribPointer(PHASE_ATTRIBUTE, 1, gl::FLOAT, gl::FALSE_, sizeof(Instance), (const void*)(offset + offsetof(Instance, phase)));
+	gl::VertexAttribDivisor(PHASE_ATTRIBUTE, 1);
+	
+	gl::EnableVertexAttribArray(SURFACE_ATTRIBUTE);
+	gl::VertexAttribPointer(SURFACE_ATTRIBUTE, 4, gl::UNSIGNED_SHORT, gl::TRUE_, sizeof(Instance), (const void*)(offset + offsetof(Instance, surface)));
+	gl::VertexAttribDivisor(SURFACE_ATTRIBUTE, 1);
+	
+	gl::EnableVertexAttribArray(LAYER_ATTRIBUTE);
+	gl::VertexAttribPointer(LAYER_ATTRIBUTE, 1, gl::FLOAT, gl::FALSE_, sizeof(Instance), (const void*)(offset + offsetof(Instance, layer)));
+	gl::VertexAttribDivisor(LAYER_ATTRIBUTE, 1);
+    }
+    
+    // Bind the VAO for drawing
+    void Mesh::bind(void) { gl::BindVertexArray(vertexArray); }
+    
+    // Instance range of one part
+    void Mesh::drawInstanced(const MeshPart& range, GLuint firstInstance, GLsizei instanceCount)
+    {
+	gl::BindVertexArray(vertexArray);
+	drawBoundInstanced(range, firstInstance, instanceCount);
+    }
+    
+    // Without the bind, for callers tracking it
+    void Mesh::drawBoundInstanced(const MeshPart& range, GLuint firstInstance, GLsizei instanceCount)
+    {
+	const void* indexOffset = (const void*)(range.firstIndex * sizeof(GLushort));
+	
+	if(getCapabilities().baseInstance) {
+	    gl::DrawElementsInstancedBaseVertexBaseInstance(gl::TRIANGLES, range.indexCount, gl::UNSIGNED_SHORT, indexOffset, instanceCount, range.baseVertex, firstInstance);
+	} else {
+	    setInstanceAttributes(instanceOffset + firstInstance * sizeof(Instance));
+	    gl::DrawElementsInstancedBaseVertex(gl::TRIANGLES, range.indexCount, gl::UNSIGNED_SHORT, indexOffset, instanceCount, range.baseVertex);
+	    setInstanceAttributes(instanceOffset);
+	}
+    }
+    
+    // Append one flat polygon, corners in order around its edge. The
+    // winding is flipped where needed so the front faces away from the
+    // origin, every shape here being convex and centered.
+    static void appendFace(vector<Vertex>& vertices, vector<GLushort>& indices, GLint baseVertex, const float corners[][3], int cornerCount)
+    {
+	float edges[2][3], normal[3], center[3] = {0.0f, 0.0f, 0.0f};
+	
+	for(int axis = 0; axis < 3; ++axis) {
+	    edges[0][axis] = corners[1][axis] - corners[0][axis];
+	    edges[1][axis] = corners[2][axis] - corners[0][axis];
+	    
+	    for(int corner = 0; corner < cornerCount; ++corner)
+		center[axis] += corners[corner][axis] / cornerCount;
+	}
+	
+	normal[0] = edges[0][1] * edges[1][2] - edges[0][2] * edges[1][1];
+	normal[1] = edges[0][2] * edges[1][0] - edges[0][0] * edges[1][2];
+	normal[2] = edges[0][0] * edges[1][1] - edges[0][1] * edges[1][0];
+	
+	float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	bool flip = normal[0] * center[0] + normal[1] * center[1] + normal[2] * center[2] < 0.0f;
+	GLushort first = (GLushort)(vertices.size() - baseVertex);
+	
+	for(int corner = 0; corner < cornerCount; ++corner) {
+	    Vertex vertex;
+	    
+	    for(int axis = 0; axis < 3; ++axis) {
+		vertex.position[axis] = corners[corner][axis];
+		vertex.normal[axis] = (GLbyte)std::floor(127.0f * (flip ? -normal[axis] : normal[axis]) / length + 0.5f);
+	    }
+	    
+	    vertex.normal[3] = 0;
+	    vertices.push_back(vertex);
+	}
+	
+	// Triangle fan, counter-clockwise seen from outside
+	for(int corner = 1; corner + 1 < cornerCount; ++corner) {
+	    indices.push_back(first);
+	    indices.push_back((GLushort)(first + (flip ? corner + 1 : corner)));
+	    indices.push_back((GLushort)(first + (flip ? corner : corner + 1)));
+	}
+    }
+    
+    // Start a part at the end of the arrays
+    static MeshPart beginPart(const vector<Vertex>& vertices, const vector<GLushort>& indices)
+    {
+	MeshPart part = {(GLuint)indices.size(), 0, (GLint)vertices.size()};
+	return part;
+    }
+    
+    // Close a part started by beginPart
+    static MeshPart endPart(MeshPart part, const vector<GLushort>& indices)
+    {
+	part.indexCount = (GLsizei)(indices.size() - part.firstIndex);
+	return part;
+    }
+    
+    // Cube geometry: four vertices per face so each face keeps a flat normal
+    MeshPart Mesh::buildCube(vector<Vertex>& vertices, vector<GLushort>& indices)
+    {
+	// Face normal and the two axes spanning the face
+	static const int faces[6][3][3] = {
+	    {{ 1, 0, 0}, {0, 0, -1}, {0, 1, 0}},
+	    {{-1, 0, 0}, {0, 0,  1}, {0, 1, 0}},
+	    {{ 0, 1, 0}, {1, 0,  0}, {0, 0, -1}},
+	    {{ 0,-1, 0}, {1, 0,  0}, {0, 0,  1}},
+	    {{ 0, 0, 1}, {1, 0,  0}, {0, 1, 0}},
+	    {{ 0, 0,-1}, {-1, 0, 0}, {0, 1, 0}}
+	};
+	static const int quad[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+	
+	MeshPart part = beginPart(vertices, indices);
+	
+	for(int face = 0; face < 6; ++face) {
+	    const int (*axes)[3] = faces[face];
+	    float corners[4][3];
+	    
+	    for(int corner = 0; corner < 4; ++corner)
+		for(int axis = 0; axis < 3; ++axis)
+		    corners[corner][axis] = 0.5f * (axes[0][axis] + quad[corner][0] * axes[1][axis] + quad[corner][1] * axes[2][axis]);
+	    
+	    appendFace(vertices, indices, part.baseVertex, corners, 4);
+	}
+	
+	return endPart(part, indices);
+    }
+    
+    // Octahedron: a vertex on each axis, eight triangular faces
+    MeshPart Mesh::buildOctahedron(vector<Vertex>& vertices, vector<GLushort>& indices)
+    {
+	MeshPart part = beginPart(vertices, indices);
+	
+	for(int face = 0; face < 8; ++face) {
+	    float corners[3][3] = {{0.0f}};
+	    
+	    // Face signs come from the bits of its index
+	    for(int axis = 0; axis < 3; ++axis)
+		corners[axis][axis] = (face >> axis) & 1 ? -0.6f : 0.6f;
+	    
+	    appendFace(vertices, indices, part.baseVertex, corners, 3);
+	}
+	
+	return endPart(part, indices);
+    }
+    
+    // Square pyramid standing on its base
+    MeshPart Mesh::buildPyramid(vector<Vertex>& vertices, vector<GLushort>& indices)
+    {
+	static const float base[4][3] = {{-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, 0.5f}, {-0.5f, -0.5f, 0.5f}};
+	
+	MeshPart part = beginPart(vertices, indices);
+	
+	appendFace(vertices, indices, part.baseVertex, base, 4);
+	
+	for(int side = 0; side < 4; ++side) {
+	    float corners[3][3] = {{0.0f, 0.5f, 0.0f}};
+	    
+	    for(int axis = 0; axis < 3; ++axis) {
+		corners[1][axis] = base[side][axis];
+		corners[2][axis] = base[(side + 1) % 4][axis];
+	    }
+	    
+	    appendFace(vertices, indices, part.baseVertex, corners, 3);
+	}
+	
+	return endPart(part, indices);
+    }
+}
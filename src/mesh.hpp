@@ -0,0 +1,105 @@
+#ifndef FOREVER_MESH
+#define FOREVER_MESH
+
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    // Interleaved, tightly packed vertex: 16 bytes
+    struct Vertex
+    {
+	GLfloat position[3];
+	GLbyte normal[4];       // normalized, w unused
+    };
+    
+    // Per-instance attributes, advanced once per instance: 84 bytes
+    struct Instance
+    {
+	GLfloat transform[16];  // column-major model matrix
+	GLubyte colour[4];      // normalized RGBA
+	GLfloat phase;          // animation phase in radians
+	GLushort surface[4];    // texture array rect, normalized: u, v offset then u, v scale
+	GLfloat layer;          // texture array layer
+    };
+    
+    // Attribute locations shared by every mesh shader
+    enum VertexAttribute
+    {
+	POSITION_ATTRIBUTE = 0,
+	NORMAL_ATTRIBUTE = 1,
+	TRANSFORM_ATTRIBUTE = 2,    // mat4, takes 2 through 5
+	COLOUR_ATTRIBUTE = 6,
+	PHASE_ATTRIBUTE = 7,
+	SURFACE_ATTRIBUTE = 8,
+	LAYER_ATTRIBUTE = 9
+    };
+    
+    // One shape inside a mesh's shared vertex and index buffers
+    struct MeshPart
+    {
+	GLuint firstIndex;
+	GLsizei indexCount;
+	GLint baseVertex;
+    };
+    
+    // Create a buffer whose contents never change after this call, using
+    // immutable storage where the context has it.
+    GLuint createStaticBuffer(GLenum target, GLsizeiptr size, const void* data);
+    
+    // Indexed geometry uploaded once into a single VAO. Several parts can
+    // share the buffers, each addressed through its MeshPart.
+    class Mesh
+    {
+    private:
+	GLuint vertexArray;
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	GLuint instanceBuffer;
+	GLintptr instanceOffset;
+	std::vector<MeshPart> parts;
+	
+	// Prevent object copying
+	Mesh(const Mesh& other) {}
+	Mesh& operator=(const Mesh& other) { return *this; }
+	
+	void upload(const std::vector<Vertex>& vertices, const std::vector<GLushort>& indices);
+	void setInstanceAttributes(GLintptr offset);
+	
+    public:
+	// Single part covering every index
+	Mesh(const std::vector<Vertex>& vertices, const std::vector<GLushort>& indices);
+	Mesh(const std::vector<Vertex>& vertices, const std::vector<GLushort>& indices, const std::vector<MeshPart>& parts);
+	~Mesh(void);
+	
+	GLuint getVertexArray(void);
+	GLsizei getIndexCount(void);
+	size_t getPartCount(void);
+	const MeshPart& getPart(size_t part);
+	
+	// Source per-instance attributes from buffer, laid out as Instance
+	// from offset on. Streamed instances move the offset every frame.
+	void setInstanceBuffer(GLuint buffer, GLintptr offset = 0);
+	
+	void bind(void);
+	
+	// Instances [firstInstance, firstInstance + instanceCount) of one part.
+	// Without base instance support the instance attributes are re-pointed
+	// for the call instead.
+	void drawInstanced(const MeshPart& part, GLuint firstInstance, GLsizei instanceCount);
+	
+	// The same with this mesh already bound
+	void drawBoundInstanced(const MeshPart& part, GLuint firstInstance, GLsizei instanceCount);
+	
+	// Shape builders append to the arrays and return the new part, one
+	// normal per face, centered on the origin. The cube and pyramid fit the
+	// unit cube; the octahedron's tips reach 0.6 along each axis, still
+	// inside the 0.866 culling radius.
+	static MeshPart buildCube(std::vector<Vertex>& vertices, std::vector<GLushort>& indices);
+	static MeshPart buildOctahedron(std::vector<Vertex>& vertices, std::vector<GLushort>& indices);
+	static MeshPart buildPyramid(std::vector<Vertex>& vertices, std::vector<GLushort>& indices);
+    };
+}
+
+#endif
@@ -0,0 +1,174 @@
+#include "pacing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#if defined(__linux__)
+#include <time.h>
+#include <errno.h>
+#endif
+
+using std::vector;
+
+namespace forever
+{
+    // Limits on the sleep margin, seconds. Elsewhere sleeps round up to
+    // the scheduler tick, so allow for a much larger margin.
+    static const double MIN_SPIN_MARGIN = 0.0002;
+#if defined(__linux__)
+    static const double MAX_SPIN_MARGIN = 0.002;
+#else
+    static const double MAX_SPIN_MARGIN = 0.02;
+#endif
+    
+    // Mode names for reports
+    const char* getPacingModeName(PacingMode mode)
+    {
+	switch(mode) {
+	case UNCAPPED_PACING:
+	    return "uncapped";
+	    
+	case VSYNC_PACING:
+	    return "vsync";
+	    
+	case ADAPTIVE_VSYNC_PACING:
+	    return "adaptive";
+	    
+	case TARGET_FPS_PACING:
+	    return "target";
+	    
+	default:
+	    return "unknown";
+	}
+    }
+    
+    // Constructor
+    FramePacer::FramePacer(PacingMode mode, double targetFps):
+	mode(mode), started(false), spinMargin(MAX_SPIN_MARGIN)
+    {
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(targetFps > 0.0 ? 1.0 / targetFps : 1.0 / 60.0));
+    }
+    
+    // Accessors
+    PacingMode FramePacer::getMode(void) const { return mode; }
+    
+    // Swap interval for the mode
+    int FramePacer::getSwapInterval(void) const
+    {
+	switch(mode) {
+	case VSYNC_PACING:
+	    return 1;
+	    
+	case ADAPTIVE_VSYNC_PACING:
+	    return -1;
+	    
+	default:
+	    return 0;
+	}
+    }
+    
+    // Coarse sleep. On Linux an absolute clock_nanosleep on the monotonic
+    // clock, which steady_clock reads too, so an interrupted or late-started
+    // sleep never drifts past the target.
+    void FramePacer::sleepUntil(Clock::time_point time)
+    {
+#if defined(__linux__)
+	std::chrono::nanoseconds since = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch());
+	struct timespec target;
+	
+	target.tv_sec = (time_t)(since.count() / 1000000000LL);
+	target.tv_nsec = (long)(since.count() % 1000000000LL);
+	
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) == EINTR)
+	    ;
+#else
+	std::this_thread::sleep_until(time);
+#endif
+    }
+    
+    // Limiter
+    void FramePacer::wait(void)
+    {
+	if(mode != TARGET_FPS_PACING)
+	    return;
+	
+	Clock::time_point now = Clock::now();
+	
+	if(!started) {
+	    deadline = now;
+	    started = true;
+	}
+	
+	deadline += period;
+	
+	// More than a frame behind, restart the grid instead of rushing frames
+	if(deadline + period < now) {
+	    deadline = now;
+	    return;
+	}
+	
+	// Sleep most of the way, then spin to the deadline
+	Clock::time_point wake = deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spinMargin));
+	
+	if(wake > now) {
+	    sleepUntil(wake);
+	    
+	    // Learn how late wake-ups run, with headroom for the bad ones
+	    double late = std::chrono::duration<double>(Clock::now() - wake).count();
+	    spinMargin = std::min(MAX_SPIN_MARGIN, std::max(MIN_SPIN_MARGIN, 0.9 * spinMargin + 0.1 * 2.0 * late));
+	}
+	
+	while(Clock::now() < deadline)
+	    ;
+    }
+    
+    // Recorder
+    void FramePacer::markFrame(void)
+    {
+	Clock::time_point now = Clock::now();
+	
+	if(lastFrame.time_since_epoch().count() != 0)
+	    intervals.push_back(std::chrono::duration<double, std::milli>(now - lastFrame).count());
+	
+	lastFrame = now;
+    }
+    
+    // Percentiles over the window
+    FrameStats FramePacer::getStats(void) const
+    {
+	FrameStats stats = {(int)intervals.size(), 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	
+	if(intervals.empty())
+	    return stats;
+	
+	for(size_t curr = 0; curr < intervals.size(); ++curr) {
+	    stats.mean += intervals[curr];
+	    
+	    if(curr > 0)
+		stats.jitter += std::fabs(intervals[curr] - intervals[curr - 1]);
+	}
+	
+	stats.mean /= intervals.size();
+	
+	if(intervals.size() > 1)
+	    stats.jitter /= intervals.size() - 1;
+	
+	vector<double> sorted(intervals);
+	std::sort(sorted.begin(), sorted.end());
+	
+	// Nearest rank
+	stats.p50 = sorted[(size_t)(0.50 * (sorted.size() - 1) + 0.5)];
+	stats.p95 = sorted[(size_t)(0.95 * (sorted.size() - 1) + 0.5)];
+	stats.p99 = sorted[(size_t)(0.99 * (sorted.size() - 1) + 0.5)];
+	stats.max = sorted.back();
+	
+	return stats;
+    }
+    
+    // Start a new window
+    void FramePacer::resetStats(void)
+    {
+	intervals.clear();
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef FOREVER_PACING
+#define FOREVER_PACING
+
+#include <vector>
+#include <chrono>
+
+namespace forever
+{
+    // How frames are paced
+    enum PacingMode
+    {
+	UNCAPPED_PACING,        // no swap interval, no limiter
+	VSYNC_PACING,           // swap interval 1
+	ADAPTIVE_VSYNC_PACING,  // swap interval -1, tears instead of halving when late
+	TARGET_FPS_PACING,      // no swap interval, CPU limiter at the target rate
+	PACING_MODE_COUNT
+    };
+    
+    const char* getPacingModeName(PacingMode mode);
+    
+    // Frame interval distribution over a window of frames, milliseconds
+    struct FrameStats
+    {
+	int frames;
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+	double jitter;          // mean change between consecutive intervals
+    };
+    
+    // Frame limiter and frame time recorder.
+    //
+    // In TARGET_FPS_PACING wait() holds each frame back to its deadline on a
+    // fixed grid of 1 / fps seconds: it sleeps until just short of the
+    // deadline, then spins the rest, the sleep margin tuned from how late the
+    // OS has been waking us. The other modes leave pacing to the swap
+    // interval, getSwapInterval(), and only record.
+    class FramePacer
+    {
+    private:
+	typedef std::chrono::steady_clock Clock;
+	
+	PacingMode mode;
+	Clock::duration period;
+	Clock::time_point deadline;
+	Clock::time_point lastFrame;
+	bool started;
+	
+	// Expected oversleep, kept as a running average of observed lateness
+	double spinMargin;
+	
+	std::vector<double> intervals;
+	
+	void sleepUntil(Clock::time_point time);
+	
+    public:
+	FramePacer(PacingMode mode = VSYNC_PACING, double targetFps = 60.0);
+	
+	PacingMode getMode(void) const;
+	
+	// For glfwSwapInterval: 0, 1, or -1 for adaptive
+	int getSwapInterval(void) const;
+	
+	// Hold the frame until its deadline, just before swapping
+	void wait(void);
+	
+	// Note a frame delivered, just after swapping
+	void markFrame(void);
+	
+	// Statistics since the last reset
+	FrameStats getStats(void) const;
+	void resetStats(void);
+    };
+}
+
+#endif
@@ -0,0 +1,230 @@
+#include "profiler.hpp"
+#include "json.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+
+using std::string;
+using std::vector;
+using std::endl;
+
+namespace forever
+{
+    // Events kept per thread and for the GPU track
+    static const size_t THREAD_EVENTS = 1 << 16;
+    static const size_t GPU_EVENTS = 1 << 14;
+    
+    std::atomic<bool> Profiler::enabled(false);
+    
+    namespace ProfilerInfo {
+	struct Event
+	{
+	    const char* name;
+	    long long begin, end;
+	};
+	
+	struct GpuEvent
+	{
+	    string name;
+	    long long begin, end;
+	};
+	
+	// Written by its thread alone; count is published after each event
+	struct ThreadBuffer
+	{
+	    int id;
+	    string name;
+	    vector<Event> events;
+	    std::atomic<size_t> count;
+	    
+	    ThreadBuffer(int id): id(id), events(THREAD_EVENTS), count(0) {}
+	};
+	
+	// Buffers outlive their threads, so a trace written at exit still has
+	// the events of workers long gone. A finished thread's buffer goes to
+	// the next new one, which keeps short-lived workers from piling them up
+	// and shows them in the trace as one track per concurrent worker.
+	struct Registry
+	{
+	    std::mutex lock;
+	    vector<ThreadBuffer*> threads;
+	    vector<ThreadBuffer*> spare;
+	    vector<GpuEvent> gpu;
+	    size_t gpuCount;
+	    
+	    Registry(void): gpuCount(0) {}
+	    
+	    ~Registry(void)
+	    {
+		for(size_t curr = 0; curr < threads.size(); ++curr)
+		    delete threads[curr];
+	    }
+	};
+	
+	Registry& getRegistry(void)
+	{
+	    static Registry registry;
+	    return registry;
+	}
+	
+	// Hands the buffer back as its thread exits
+	struct ThreadHandle
+	{
+	    ThreadBuffer* buffer;
+	    
+	    ThreadHandle(void): buffer(NULL) {}
+	    
+	    ~ThreadHandle(void)
+	    {
+		if(buffer) {
+		    Registry& registry = getRegistry();
+		    std::lock_guard<std::mutex> guard(registry.lock);
+		    
+		    registry.spare.push_back(buffer);
+		}
+	    }
+	};
+	
+	thread_local ThreadHandle current;
+	
+	ThreadBuffer* getThreadBuffer(void)
+	{
+	    if(!current.buffer) {
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> guard(registry.lock);
+		
+		if(!registry.spare.empty()) {
+		    current.buffer = registry.spare.back();
+		    registry.spare.pop_back();
+		} else {
+		    current.buffer = new ThreadBuffer((int)registry.threads.size() + 1);
+		    registry.threads.push_back(current.buffer);
+		}
+	    }
+	    
+	    return current.buffer;
+	}
+	
+	// Complete event, microseconds
+	void writeEvent(std::ostream& out, bool& first, const string& name, const char* category, int pid, int tid, long long begin, long long end)
+	{
+	    out << (first ? "" : ",\n") << "{\"name\": " << quoteJson(name) << ", \"cat\": \"" << category
+		<< "\", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << tid
+		<< ", \"ts\": " << begin / 1000.0 << ", \"dur\": " << (end - begin) / 1000.0 << "}";
+	    first = false;
+	}
+	
+	void writeName(std::ostream& out, bool& first, const char* kind, int pid, int tid, const string& name)
+	{
+	    out << (first ? "" : ",\n") << "{\"name\": \"" << kind << "\", \"ph\": \"M\", \"pid\": " << pid
+		<< ", \"tid\": " << tid << ", \"args\": {\"name\": " << quoteJson(name) << "}}";
+	    first = false;
+	}
+    }
+    
+    // Switch
+    void Profiler::setEnabled(bool enabled)
+    {
+	now();
+	Profiler::enabled.store(enabled, std::memory_order_relaxed);
+    }
+    
+    // Time base, from the first call
+    long long Profiler::now(void)
+    {
+	static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+    
+    void Profiler::setThreadName(const string& name)
+    {
+	ProfilerInfo::ThreadBuffer* buffer = ProfilerInfo::getThreadBuffer();
+	std::lock_guard<std::mutex> guard(ProfilerInfo::getRegistry().lock);
+	
+	buffer->name = name;
+    }
+    
+    // Recording
+    void Profiler::record(const char* name, long long begin, long long end)
+    {
+	ProfilerInfo::ThreadBuffer* buffer = ProfilerInfo::getThreadBuffer();
+	size_t count = buffer->count.load(std::memory_order_relaxed);
+	ProfilerInfo::Event& event = buffer->events[count % THREAD_EVENTS];
+	
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	buffer->count.store(count + 1, std::memory_order_release);
+    }
+    
+    void Profiler::recordGpu(const string& name, long long begin, long long end)
+    {
+	ProfilerInfo::Registry& registry = ProfilerInfo::getRegistry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	ProfilerInfo::GpuEvent event = {name, begin, end};
+	
+	if(registry.gpu.size() < GPU_EVENTS)
+	    registry.gpu.push_back(event);
+	else
+	    registry.gpu[registry.gpuCount % GPU_EVENTS] = event;
+	
+	++registry.gpuCount;
+    }
+    
+    // Export: the CPU threads under one process, the GPU as another
+    void Profiler::writeChromeTrace(std::ostream& out)
+    {
+	using namespace ProfilerInfo;
+	
+	Registry& registry = getRegistry();
+	std::lock_guard<std::mutex> guard(registry.lock);
+	std::streamsize precision = out.precision();
+	std::ios::fmtflags flags = out.flags();
+	bool first = true;
+	
+	out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+	
+	writeName(out, first, "process_name", 1, 0, "CPU");
+	writeName(out, first, "process_name", 2, 0, "GPU");
+	writeName(out, first, "thread_name", 2, 1, "passes");
+	
+	for(size_t thread = 0; thread < registry.threads.size(); ++thread) {
+	    ThreadBuffer* buffer = registry.threads[thread];
+	    size_t count = buffer->count.load(std::memory_order_acquire);
+	    
+	    std::stringstream name;
+	    name << "thread " << buffer->id;
+	    writeName(out, first, "thread_name", 1, buffer->id, buffer->name.empty() ? name.str() : buffer->name);
+	    
+	    for(size_t curr = count > THREAD_EVENTS ? count - THREAD_EVENTS : 0; curr < count; ++curr) {
+		const Event& event = buffer->events[curr % THREAD_EVENTS];
+		writeEvent(out, first, event.name, "cpu", 1, buffer->id, event.begin, event.end);
+	    }
+	}
+	
+	for(size_t curr = registry.gpuCount > GPU_EVENTS ? registry.gpuCount - GPU_EVENTS : 0; curr < registry.gpuCount; ++curr) {
+	    const GpuEvent& event = registry.gpu[curr % GPU_EVENTS];
+	    writeEvent(out, first, event.name, "gpu", 2, 1, event.begin, event.end);
+	}
+	
+	out << endl << "]}" << endl;
+	
+	out.precision(precision);
+	out.flags(flags);
+    }
+    
+    bool Profiler::writeChromeTrace(const string& filename)
+    {
+	std::ofstream output(filename.c_str());
+	
+	if(!output)
+	    return false;
+	
+	writeChromeTrace(output);
+	return (bool)output;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef FOREVER_PROFILER
+#define FOREVER_PROFILER
+
+#include <ostream>
+#include <string>
+#include <atomic>
+
+namespace forever
+{
+    // CPU instrumentation, exported as a Chrome trace.
+    //
+    // PROFILE_ZONE("name") times the rest of its scope. Every thread records
+    // into its own ring buffer, so recording takes no lock; only a thread's
+    // first zone registers its buffer. Names must outlive the profiler,
+    // string literals in practice. The newest events per thread are kept once
+    // a ring wraps.
+    //
+    // Zones cost an atomic load and a branch while the profiler is disabled,
+    // the default. Build with -DFOREVER_NO_PROFILING to compile them out.
+    class Profiler
+    {
+    private:
+	static std::atomic<bool> enabled;
+	
+    public:
+	static void setEnabled(bool enabled);
+	static bool isEnabled(void) { return enabled.load(std::memory_order_relaxed); }
+	
+	// Nanoseconds on steady_clock, the trace's time base
+	static long long now(void);
+	
+	// Name the calling thread in the trace
+	static void setThreadName(const std::string& name);
+	
+	// A finished zone on the calling thread
+	static void record(const char* name, long long begin, long long end);
+	
+	// A span on the GPU track, already in now()'s time base
+	static void recordGpu(const std::string& name, long long begin, long long end);
+	
+	// trace_event JSON for chrome://tracing or Perfetto. Read while other
+	// threads are recording, their oldest events may be torn.
+	static void writeChromeTrace(std::ostream& out);
+	static bool writeChromeTrace(const std::string& filename);
+    };
+    
+    // One timed scope, see PROFILE_ZONE
+    class ProfileZone
+    {
+    private:
+	const char* name;
+	long long begin;
+	
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+	
+    public:
+	ProfileZone(const char* name): name(Profiler::isEnabled() ? name : NULL), begin(0)
+	{
+	    if(this->name)
+		begin = Profiler::now();
+	}
+	
+	~ProfileZone(void)
+	{
+	    if(name)
+		Profiler::record(name, begin, Profiler::now());
+	}
+    };
+}
+
+#define FOREVER_PROFILE_JOIN2(a, b) a##b
+#define FOREVER_PROFILE_JOIN(a, b) FOREVER_PROFILE_JOIN2(a, b)
+
+#if defined(FOREVER_NO_PROFILING)
+#define PROFILE_ZONE(name) do {} while(0)
+#else
+#define PROFILE_ZONE(name) forever::ProfileZone FOREVER_PROFILE_JOIN(profileZone, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,213 @@
+#include "renderqueue.hpp"
+
+#include <algorithm>
+
+#include "jobs.hpp"
+#include "materials.hpp"
+#include "profiler.hpp"
+
+using std::vector;
+using std::uint64_t;
+
+namespace forever
+{
+    // Below this many draws a single thread sorts faster than jobs
+    static const size_t PARALLEL_SORT_SIZE = 16384;
+    
+    // Constructor
+    RenderQueue::RenderQueue(void):
+	nearDepth(0.0f), farDepth(1.0f), materials(NULL), materialBinding(0)
+    {}
+    
+    // Accessors
+    void RenderQueue::setDepthRange(float nearDepth, float farDepth)
+    {
+	this->nearDepth = nearDepth;
+	this->farDepth = farDepth > nearDepth ? farDepth : nearDepth + 1.0f;
+    }
+    
+    void RenderQueue::setMaterials(MaterialBuffer* materials, GLuint binding)
+    {
+	this->materials = materials;
+	materialBinding = binding;
+    }
+    
+    size_t RenderQueue::size(void) const { return items.size(); }
+    
+    // Drop the draws, keeping the program and mesh indices stable
+    void RenderQueue::clear(void)
+    {
+	items.clear();
+	entries.clear();
+    }
+    
+    // Index of value in list, appended if new
+    template<typename T>
+    static uint64_t getIndex(vector<T*>& list, T* value)
+    {
+	size_t index = std::find(list.begin(), list.end(), value) - list.begin();
+	
+	if(index == list.size())
+	    list.push_back(value);
+	
+	return index;
+    }
+    
+    // Pack the fields, each clamped to its width
+    uint64_t RenderQueue::makeKey(RenderPass pass, const RenderItem& item, float depth)
+    {
+	float scaled = (depth - nearDepth) / (farDepth - nearDepth);
+	uint64_t quantised = (uint64_t)(std::min(std::max(scaled, 0.0f), 1.0f) * 0xffffff);
+	
+	if(pass == TRANSPARENT_PASS)
+	    quantised = 0xffffff - quantised;
+	
+	uint64_t program = std::min(getIndex(programs, item.program), (uint64_t)0xff);
+	uint64_t vertexArray = std::min(getIndex(meshes, item.mesh), (uint64_t)0xfff);
+	
+	return ((uint64_t)(pass & 0xf) << 60) | (program << 52) | ((uint64_t)(item.material & 0xffff) << 36) | (vertexArray << 24) | quantised;
+    }
+    
+    // Queue one draw
+    void RenderQueue::add(RenderPass pass, const RenderItem& item, float depth)
+    {
+	SortEntry entry = {makeKey(pass, item, depth), (GLuint)items.size()};
+	
+	items.push_back(item);
+	entries.push_back(entry);
+    }
+    
+    // A byte a pass, each counted then scattered in order. Chunks count
+    // their own histograms, so each knows where its entries start and the
+    // scatter stays stable.
+    void RenderQueue::sort(JobSystem* jobs)
+    {
+	PROFILE_ZONE("sort queue");
+	
+	size_t count = entries.size();
+	
+	if(count < 2)
+	    return;
+	
+	scratch.resize(count);
+	
+	// Bytes every key shares need no pass
+	uint64_t differ = 0;
+	
+	for(size_t curr = 1; curr < count; ++curr)
+	    differ |= entries[curr].key ^ entries[0].key;
+	
+	size_t chunkCount = jobs && count >= PARALLEL_SORT_SIZE ? (size_t)jobs->getThreadCount() : 1;
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	vector< vector<size_t> > offsets(chunkCount, vector<size_t>(256));
+	
+	for(int shift = 0; shift < 64; shift += 8) {
+	    if(((differ >> shift) & 0xff) == 0)
+		continue;
+	    
+	    const SortEntry* source = &entries[0];
+	    SortEntry* target = &scratch[0];
+	    
+	    // Histograms
+	    auto countChunk = [&](size_t chunk) {
+		vector<size_t>& histogram = offsets[chunk];
+		std::fill(histogram.begin(), histogram.end(), 0);
+		
+		for(size_t curr = chunk * chunkSize; curr < std::min(count, (chunk + 1) * chunkSize); ++curr)
+		    ++histogram[(source[curr].key >> shift) & 0xff];
+	    };
+	    
+	    // Starts, bucket by bucket then chunk by chunk
+	    auto prefix = [&]() {
+		size_t total = 0;
+		
+		for(size_t bucket = 0; bucket < 256; ++bucket) {
+		    for(size_t chunk = 0; chunk < chunkCount; ++chunk) {
+			size_t bucketCount = offsets[chunk][bucket];
+			offsets[chunk][bucket] = total;
+			total += bucketCount;
+		    }
+		}
+	    };
+	    
+	    auto scatterChunk = [&](size_t chunk) {
+		vector<size_t>& next = offsets[chunk];
+		
+		for(size_t curr = chunk * chunkSize; curr < std::min(count, (chunk + 1) * chunkSize); ++curr)
+		    target[next[(source[curr].key >> shift) & 0xff]++] = source[curr];
+	    };
+	    
+	    if(chunkCount > 1) {
+		jobs->parallelFor(0, chunkCount, 1, [&](size_t first, size_t last) {
+			for(size_t chunk = first; chunk < last; ++chunk)
+			    countChunk(chunk);
+		    });
+		
+		prefix();
+		
+		jobs->parallelFor(0, chunkCount, 1, [&](size_t first, size_t last) {
+			for(size_t chunk = first; chunk < last; ++chunk)
+			    scatterChunk(chunk);
+		    });
+	    } else {
+		countChunk(0);
+		prefix();
+		scatterChunk(0);
+	    }
+	    
+	    entries.swap(scratch);
+	}
+    }
+    
+    // Binds only on change
+    RenderQueueStats RenderQueue::submit(void)
+    {
+	PROFILE_ZONE("submit queue");
+	
+	RenderQueueStats stats = {0, 0, 0, 0, 0};
+	glslu::Program* program = NULL;
+	Mesh* mesh = NULL;
+	GLuint texture = 0;
+	GLuint material = 0;
+	
+	for(size_t curr = 0; curr < entries.size(); ++curr) {
+	    const RenderItem& item = items[entries[curr].item];
+	    
+	    if(item.program != program) {
+		program = item.program;
+		program->use();
+		++stats.programBinds;
+	    }
+	    
+	    if(item.mesh != mesh) {
+		mesh = item.mesh;
+		mesh->bind();
+		++stats.vertexArrayBinds;
+	    }
+	    
+	    if(item.texture != texture) {
+		texture = item.texture;
+		gl::BindTexture(gl::TEXTURE_2D, texture);
+		++stats.textureBinds;
+	    }
+	    
+	    if(curr == 0 || item.material != material) {
+		material = item.material;
+		
+		if(materials)
+		    materials->bind(materialBinding, material);
+		
+		++stats.materialChanges;
+	    }
+	    
+	    mesh->drawBoundInstanced(item.part, item.firstInstance, item.instanceCount);
+	    ++stats.draws;
+	}
+	
+	// Leave unit 0 as other code expects it
+	if(texture != 0)
+	    gl::BindTexture(gl::TEXTURE_2D, 0);
+	
+	return stats;
+    }
+}
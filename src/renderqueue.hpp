@@ -0,0 +1,98 @@
+#ifndef FOREVER_RENDERQUEUE
+#define FOREVER_RENDERQUEUE
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "gl_core_4_4.hpp"
+#include "glslu.hpp"
+#include "mesh.hpp"
+
+namespace forever
+{
+    class JobSystem;
+    class MaterialBuffer;
+    
+    // Passes submit in this order
+    enum RenderPass
+    {
+	OPAQUE_PASS,            // front to back
+	TRANSPARENT_PASS,       // back to front
+	OVERLAY_PASS
+    };
+    
+    // One draw and the state it needs
+    struct RenderItem
+    {
+	glslu::Program* program;
+	Mesh* mesh;
+	MeshPart part;
+	GLuint firstInstance;
+	GLsizei instanceCount;
+	GLuint material;
+	GLuint texture;         // bound to unit 0, none when zero
+    };
+    
+    // State changes made by one submit()
+    struct RenderQueueStats
+    {
+	GLsizei draws;
+	int programBinds;
+	int vertexArrayBinds;
+	int textureBinds;
+	int materialChanges;
+    };
+    
+    // Draws ordered by a 64-bit key, most significant first:
+    //
+    //     pass 4 | program 8 | material 16 | vertex array 12 | depth 24
+    //
+    // so that after sorting, draws sharing state are adjacent and submit()
+    // only changes what differs from the draw before. Programs and meshes
+    // get small indices in the order the queue first sees them.
+    //
+    // Keys are sorted with an LSD radix sort, a byte a pass, skipping
+    // bytes every key shares; large queues sort as jobs.
+    class RenderQueue
+    {
+    private:
+	struct SortEntry
+	{
+	    std::uint64_t key;
+	    GLuint item;
+	};
+	
+	std::vector<RenderItem> items;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;
+	std::vector<glslu::Program*> programs;
+	std::vector<Mesh*> meshes;
+	float nearDepth, farDepth;
+	MaterialBuffer* materials;
+	GLuint materialBinding;
+	
+	std::uint64_t makeKey(RenderPass pass, const RenderItem& item, float depth);
+	
+    public:
+	RenderQueue(void);
+	
+	// View distances depth is quantised over
+	void setDepthRange(float nearDepth, float farDepth);
+	
+	// Where item materials are bound on change, none leaves them as ids
+	void setMaterials(MaterialBuffer* materials, GLuint binding = 0);
+	
+	void clear(void);
+	void add(RenderPass pass, const RenderItem& item, float depth);
+	size_t size(void) const;
+	
+	// Order by key, stable for equal keys
+	void sort(JobSystem* jobs = NULL);
+	
+	// Draw in the current order, skipping redundant binds
+	RenderQueueStats submit(void);
+    };
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "rendertarget.hpp"
+
+#include <sstream>
+
+#include "glslu_deletion.hpp"
+
+namespace forever
+{
+    // Constructor
+    RenderTarget::RenderTarget(int width, int height) throw(RenderTargetException):
+	framebuffer(0), colour(0), depth(0), width(width), height(height)
+    {
+	if(width <= 0 || height <= 0)
+	    throw RenderTargetException("Render target needs a positive size");
+	
+	gl::GenRenderbuffers(1, &colour);
+	gl::BindRenderbuffer(gl::RENDERBUFFER, colour);
+	gl::RenderbufferStorage(gl::RENDERBUFFER, gl::RGBA8, width, height);
+	
+	gl::GenRenderbuffers(1, &depth);
+	gl::BindRenderbuffer(gl::RENDERBUFFER, depth);
+	gl::RenderbufferStorage(gl::RENDERBUFFER, gl::DEPTH_COMPONENT24, width, height);
+	gl::BindRenderbuffer(gl::RENDERBUFFER, 0);
+	
+	gl::GenFramebuffers(1, &framebuffer);
+	gl::BindFramebuffer(gl::FRAMEBUFFER, framebuffer);
+	gl::FramebufferRenderbuffer(gl::FRAMEBUFFER, gl::COLOR_ATTACHMENT0, gl::RENDERBUFFER, colour);
+	gl::FramebufferRenderbuffer(gl::FRAMEBUFFER, gl::DEPTH_ATTACHMENT, gl::RENDERBUFFER, depth);
+	
+	GLenum status = gl::CheckFramebufferStatus(gl::FRAMEBUFFER);
+	gl::BindFramebuffer(gl::FRAMEBUFFER, 0);
+	
+	if(status != gl::FRAMEBUFFER_COMPLETE) {
+	    std::stringstream buffer;
+	    buffer << "Render target " << width << "x" << height << " is incomplete (0x" << std::hex << status << ")";
+	    
+	    gl::DeleteFramebuffers(1, &framebuffer);
+	    gl::DeleteRenderbuffers(1, &colour);
+	    gl::DeleteRenderbuffers(1, &depth);
+	    throw RenderTargetException(buffer.str());
+	}
+    }
+    
+    // Deconstructor!
+    RenderTarget::~RenderTarget(void)
+    {
+	glslu::releaseObject(glslu::FRAMEBUFFER_OBJECT, framebuffer);
+	glslu::releaseObject(glslu::RENDERBUFFER_OBJECT, colour);
+	glslu::releaseObject(glslu::RENDERBUFFER_OBJECT, depth);
+    }
+    
+    // Accessors
+    GLuint RenderTarget::getFramebuffer(void) const { return framebuffer; }
+    int RenderTarget::getWidth(void) const { return width; }
+    int RenderTarget::getHeight(void) const { return height; }
+    
+    // Make it the draw target
+    void RenderTarget::bind(void)
+    {
+	gl::BindFramebuffer(gl::FRAMEBUFFER, framebuffer);
+	gl::Viewport(0, 0, width, height);
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef FOREVER_RENDER_TARGET
+#define FOREVER_RENDER_TARGET
+
+#include <stdexcept>
+#include <string>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    class RenderTargetException: public std::runtime_error
+    {
+    public:
+	RenderTargetException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // Off-screen framebuffer with a colour and a depth renderbuffer.
+    //
+    // Stands in for the window's framebuffer when there is none: a
+    // surfaceless context has no default framebuffer at all.
+    class RenderTarget
+    {
+    private:
+	GLuint framebuffer;
+	GLuint colour;
+	GLuint depth;
+	int width, height;
+	
+	// No copies, it owns the GL objects
+	RenderTarget(const RenderTarget&);
+	RenderTarget& operator=(const RenderTarget&);
+	
+    public:
+	RenderTarget(int width, int height) throw(RenderTargetException);
+	~RenderTarget(void);
+	
+	GLuint getFramebuffer(void) const;
+	int getWidth(void) const;
+	int getHeight(void) const;
+	
+	// Draw into it, viewport set to cover it
+	void bind(void);
+    };
+}
+
+#endif
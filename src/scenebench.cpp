@@ -0,0 +1,270 @@
+#include "scenebench.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <cmath>
+
+#include "capabilities.hpp"
+#include "json.hpp"
+
+using std::vector;
+using std::string;
+using std::pair;
+using std::endl;
+
+namespace forever
+{
+    namespace SceneBenchmarkJson {
+	void writePercentiles(std::ostream& out, const char* name, const Percentiles& values)
+	{
+	    out << "  " << quoteJson(name) << ": {\"samples\": " << values.samples
+		<< ", \"mean\": " << values.mean << ", \"p50\": " << values.p50 << ", \"p90\": " << values.p90
+		<< ", \"p99\": " << values.p99 << ", \"max\": " << values.max << "}";
+	}
+    }
+    
+    // Summary of a measurement
+    Percentiles getPercentiles(const vector<double>& samples)
+    {
+	Percentiles result = {(int)samples.size(), 0.0, 0.0, 0.0, 0.0, 0.0};
+	
+	if(samples.empty())
+	    return result;
+	
+	vector<double> sorted(samples);
+	std::sort(sorted.begin(), sorted.end());
+	
+	for(size_t curr = 0; curr < sorted.size(); ++curr)
+	    result.mean += sorted[curr];
+	
+	result.mean /= sorted.size();
+	result.p50 = sorted[(size_t)(0.50 * (sorted.size() - 1) + 0.5)];
+	result.p90 = sorted[(size_t)(0.90 * (sorted.size() - 1) + 0.5)];
+	result.p99 = sorted[(size_t)(0.99 * (sorted.size() - 1) + 0.5)];
+	result.max = sorted.back();
+	
+	return result;
+    }
+    
+    // Constructor
+    GpuFrameTimer::GpuFrameTimer(void):
+	supported(getCapabilities().timerQuery)
+    {
+    }
+    
+    // Deconstructor!
+    GpuFrameTimer::~GpuFrameTimer(void)
+    {
+	for(size_t curr = 0; curr < pending.size(); ++curr)
+	    spare.push_back(pending[curr].query);
+	
+	if(!spare.empty())
+	    gl::DeleteQueries((GLsizei)spare.size(), &spare[0]);
+    }
+    
+    // Accessors
+    bool GpuFrameTimer::isSupported(void) const { return supported; }
+    
+    // Start timing
+    void GpuFrameTimer::begin(long frame)
+    {
+	if(!supported)
+	    return;
+	
+	Query next;
+	next.frame = frame;
+	
+	if(spare.empty()) {
+	    gl::GenQueries(1, &next.query);
+	} else {
+	    next.query = spare.back();
+	    spare.pop_back();
+	}
+	
+	gl::BeginQuery(gl::TIME_ELAPSED, next.query);
+	pending.push_back(next);
+    }
+    
+    // Stop timing
+    void GpuFrameTimer::end(void)
+    {
+	if(supported)
+	    gl::EndQuery(gl::TIME_ELAPSED);
+    }
+    
+    // Read back finished frames, in order
+    void GpuFrameTimer::collect(vector<pair<long, double> >& results, bool wait)
+    {
+	while(!pending.empty()) {
+	    GLuint query = pending.front().query;
+	    
+	    if(!wait) {
+		GLuint available = gl::FALSE_;
+		gl::GetQueryObjectuiv(query, gl::QUERY_RESULT_AVAILABLE, &available);
+		
+		if(!available)
+		    break;
+	    }
+	    
+	    GLuint64 elapsed = 0;
+	    gl::GetQueryObjectui64v(query, gl::QUERY_RESULT, &elapsed);
+	    
+	    results.push_back(std::make_pair(pending.front().frame, elapsed / 1000000.0));
+	    spare.push_back(query);
+	    pending.pop_front();
+	}
+    }
+    
+    // Constructor
+    SceneBenchmark::SceneBenchmark(int warmupFrames, int frames, double step):
+	warmupFrames(std::max(warmupFrames, 0)), frames(std::max(frames, 1)), step(step), frame(0),
+	drawCalls(0), bytesUploaded(0), visible(0), visibleKnown(true)
+    {
+    }
+    
+    // Scene description, kept as JSON values
+    void SceneBenchmark::addSetting(const string& name, const string& value)
+    {
+	settings.push_back(std::make_pair(name, quoteJson(value)));
+    }
+    
+    void SceneBenchmark::addSetting(const string& name, const char* value) { addSetting(name, string(value)); }
+    void SceneBenchmark::addSetting(const string& name, bool value) { settings.push_back(std::make_pair(name, string(value ? "true" : "false"))); }
+    void SceneBenchmark::addSetting(const string& name, int value) { addSetting(name, (long long)value); }
+    
+    void SceneBenchmark::addSetting(const string& name, long long value)
+    {
+	std::stringstream buffer;
+	buffer << value;
+	settings.push_back(std::make_pair(name, buffer.str()));
+    }
+    
+    void SceneBenchmark::addSetting(const string& name, double value)
+    {
+	std::stringstream buffer;
+	buffer << value;
+	settings.push_back(std::make_pair(name, buffer.str()));
+    }
+    
+    // Accessors
+    long SceneBenchmark::getFrame(void) const { return frame; }
+    bool SceneBenchmark::isDone(void) const { return frame >= warmupFrames + frames; }
+    double SceneBenchmark::getSceneTime(void) const { return frame * step; }
+    
+    // Camera path
+    glm::vec3 SceneBenchmark::getEye(float distance) const
+    {
+	float angle = 6.2831853f * frame / (warmupFrames + frames);
+	float elevation = 0.4636476f + 0.25f * std::sin(2.0f * angle);
+	
+	return distance * glm::vec3(std::sin(angle) * std::cos(elevation), std::sin(elevation), std::cos(angle) * std::cos(elevation));
+    }
+    
+    // Frame brackets
+    void SceneBenchmark::beginFrame(void)
+    {
+	gpuTimer.begin(frame);
+    }
+    
+    void SceneBenchmark::endFrame(double frameTime, double submitTime, int calls, long long bytes, long drawn)
+    {
+	gpuTimer.end();
+	
+	if(frame >= warmupFrames) {
+	    frameTimes.push_back(frameTime);
+	    submitTimes.push_back(submitTime);
+	    drawCalls += calls;
+	    bytesUploaded += bytes;
+	    visible += drawn;
+	    visibleKnown = visibleKnown && drawn >= 0;
+	}
+	
+	++frame;
+	collectGpuTimes(false);
+    }
+    
+    // Keep the GPU times of recorded frames only
+    void SceneBenchmark::collectGpuTimes(bool wait)
+    {
+	vector<pair<long, double> > results;
+	gpuTimer.collect(results, wait);
+	
+	for(size_t curr = 0; curr < results.size(); ++curr)
+	    if(results[curr].first >= warmupFrames)
+		gpuTimes.push_back(results[curr].second);
+    }
+    
+    // Results
+    void SceneBenchmark::write(std::ostream& out, const vector<GpuPassStats>& passes)
+    {
+	using namespace SceneBenchmarkJson;
+	
+	collectGpuTimes(true);
+	
+	const GLubyte* renderer = gl::GetString(gl::RENDERER);
+	const GLubyte* version = gl::GetString(gl::VERSION);
+	int recorded = (int)frameTimes.size();
+	std::streamsize precision = out.precision();
+	std::ios::fmtflags flags = out.flags();
+	
+	out << std::fixed << std::setprecision(4)
+	    << "{" << endl
+	    << "  \"renderer\": " << quoteJson(renderer ? (const char*)renderer : "") << "," << endl
+	    << "  \"gl_version\": " << quoteJson(version ? (const char*)version : "") << "," << endl
+	    << "  \"scene\": {";
+	
+	for(size_t curr = 0; curr < settings.size(); ++curr)
+	    out << quoteJson(settings[curr].first) << ": " << settings[curr].second << ", ";
+	
+	out << "\"warmup_frames\": " << warmupFrames << ", \"frames\": " << frames << ", \"step_ms\": " << 1000.0 * step << "}," << endl;
+	
+	writePercentiles(out, "cpu_frame_ms", getPercentiles(frameTimes));
+	out << "," << endl;
+	
+	if(gpuTimer.isSupported())
+	    writePercentiles(out, "gpu_frame_ms", getPercentiles(gpuTimes));
+	else
+	    out << "  \"gpu_frame_ms\": null";
+	
+	out << "," << endl;
+	writePercentiles(out, "submit_ms", getPercentiles(submitTimes));
+	out << "," << endl;
+	
+	// Nested passes keyed by their path, "frame/draw"
+	vector<string> path;
+	out << "  \"gpu_passes_ms\": {";
+	
+	for(size_t curr = 0; curr < passes.size(); ++curr) {
+	    path.resize(passes[curr].depth);
+	    path.push_back(passes[curr].name);
+	    
+	    string key;
+	    
+	    for(size_t part = 0; part < path.size(); ++part)
+		key += (part > 0 ? "/" : "") + path[part];
+	    
+	    out << (curr > 0 ? ", " : "") << quoteJson(key) << ": {\"samples\": " << passes[curr].samples
+		<< ", \"mean\": " << passes[curr].mean << ", \"max\": " << passes[curr].max << "}";
+	}
+	
+	out << "}," << endl;
+	
+	out << "  \"counters\": {\"draw_calls\": " << drawCalls
+	    << ", \"draw_calls_per_frame\": " << (recorded > 0 ? (double)drawCalls / recorded : 0.0)
+	    << ", \"bytes_uploaded\": " << bytesUploaded
+	    << ", \"bytes_uploaded_per_frame\": " << (recorded > 0 ? (double)bytesUploaded / recorded : 0.0)
+	    << ", \"visible_per_frame\": ";
+	
+	if(visibleKnown)
+	    out << (recorded > 0 ? (double)visible / recorded : 0.0);
+	else
+	    out << "null";
+	
+	out << "}" << endl
+	    << "}" << endl;
+	
+	out.precision(precision);
+	out.flags(flags);
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef FOREVER_SCENE_BENCH
+#define FOREVER_SCENE_BENCH
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "gl_core_4_4.hpp"
+#include "gpuprofiler.hpp"
+
+namespace forever
+{
+    // Distribution of a per-frame measurement, milliseconds
+    struct Percentiles
+    {
+	int samples;
+	double mean;
+	double p50;
+	double p90;
+	double p99;
+	double max;
+    };
+    
+    // Nearest-rank percentiles
+    Percentiles getPercentiles(const std::vector<double>& samples);
+    
+    // GPU time of each frame through TIME_ELAPSED queries.
+    //
+    // Results are read back a few frames late so the CPU never waits on
+    // them; collect() hands over whatever has landed, tagged with the frame
+    // it was started on.
+    class GpuFrameTimer
+    {
+    private:
+	struct Query
+	{
+	    GLuint query;
+	    long frame;
+	};
+	
+	bool supported;
+	std::vector<GLuint> spare;
+	std::deque<Query> pending;
+	
+	// No copies, it owns the queries
+	GpuFrameTimer(const GpuFrameTimer&);
+	GpuFrameTimer& operator=(const GpuFrameTimer&);
+	
+    public:
+	GpuFrameTimer(void);
+	~GpuFrameTimer(void);
+	
+	bool isSupported(void) const;
+	
+	// Bracket all of a frame's GL work; one frame at a time
+	void begin(long frame);
+	void end(void);
+	
+	// Finished frames as (frame, milliseconds), waiting for all if asked
+	void collect(std::vector<std::pair<long, double> >& results, bool wait = false);
+    };
+    
+    // A scripted, repeatable run of the demo.
+    //
+    // Frames are numbered from zero; the first warmupFrames are run but not
+    // recorded. The scene is driven by the frame number alone: simulation
+    // time advances a fixed step per frame and the camera follows a fixed
+    // orbit, so every run and every build draws the same frames.
+    class SceneBenchmark
+    {
+    private:
+	int warmupFrames;
+	int frames;
+	double step;
+	long frame;
+	
+	std::vector<double> frameTimes;
+	std::vector<double> submitTimes;
+	std::vector<double> gpuTimes;
+	long drawCalls;
+	long long bytesUploaded;
+	long long visible;
+	bool visibleKnown;
+	
+	GpuFrameTimer gpuTimer;
+	
+	std::vector<std::pair<std::string, std::string> > settings;   // name, JSON value
+	
+	void collectGpuTimes(bool wait);
+	
+    public:
+	SceneBenchmark(int warmupFrames, int frames, double step = 1.0 / 60.0);
+	
+	// Describe the scene, written out with the results as a JSON string,
+	// number or bool to match the value
+	void addSetting(const std::string& name, const std::string& value);
+	void addSetting(const std::string& name, const char* value);
+	void addSetting(const std::string& name, bool value);
+	void addSetting(const std::string& name, int value);
+	void addSetting(const std::string& name, long long value);
+	void addSetting(const std::string& name, double value);
+	
+	long getFrame(void) const;
+	bool isDone(void) const;
+	
+	// Simulation time of the current frame, seconds
+	double getSceneTime(void) const;
+	
+	// Camera for the current frame: one orbit of the target at distance
+	// over the run, bobbing up and down
+	glm::vec3 getEye(float distance) const;
+	
+	// Bracket the frame's GL work, then record it; times in milliseconds,
+	// visible negative when only the GPU knows
+	void beginFrame(void);
+	void endFrame(double frameTime, double submitTime, int drawCalls, long long bytesUploaded, long visible);
+	
+	// Results as JSON, waiting for outstanding GPU times first; per-pass
+	// times from a GpuProfiler reset when recording started
+	void write(std::ostream& out, const std::vector<GpuPassStats>& passes = std::vector<GpuPassStats>());
+    };
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "scenegraph.hpp"
+
+#include <atomic>
+#include <sstream>
+
+#include "jobs.hpp"
+#include "profiler.hpp"
+
+using std::vector;
+
+namespace forever
+{
+    // Constructor
+    SceneGraph::SceneGraph(void):
+	recomputed(0)
+    {}
+    
+    // Depth-first append
+    int SceneGraph::addNode(int parent, const glm::mat4& local) throw(SceneGraphException)
+    {
+	int node = (int)parents.size();
+	
+	if(parent >= node || parent < -1 || (parent >= 0 && subtreeEnds[parent] != (size_t)node)) {
+	    std::stringstream buffer;
+	    
+	    // Every ancestor's subtree must still end at the last node
+	    if(parent >= node || parent < -1)
+		buffer << "Scene graph parent " << parent << " does not exist";
+	    else
+		buffer << "Scene graph node " << parent << " already has a closed subtree, nodes go in depth first";
+	    
+	    throw SceneGraphException(buffer.str());
+	}
+	
+	parents.push_back(parent);
+	subtreeEnds.push_back(node + 1);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	changed.push_back(0);
+	
+	for(int ancestor = parent; ancestor >= 0; ancestor = parents[ancestor])
+	    subtreeEnds[ancestor] = node + 1;
+	
+	return node;
+    }
+    
+    // Drop every node
+    void SceneGraph::clear(void)
+    {
+	parents.clear();
+	subtreeEnds.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	changed.clear();
+	recomputed = 0;
+    }
+    
+    // Mark for the next update
+    void SceneGraph::setLocal(int node, const glm::mat4& local)
+    {
+	locals[node] = local;
+	dirty[node] = 1;
+    }
+    
+    // Accessors
+    const glm::mat4& SceneGraph::getLocal(int node) const { return locals[node]; }
+    const glm::mat4& SceneGraph::getWorld(int node) const { return worlds[node]; }
+    int SceneGraph::getParent(int node) const { return parents[node]; }
+    size_t SceneGraph::size(void) const { return parents.size(); }
+    size_t SceneGraph::getRecomputedCount(void) const { return recomputed; }
+    bool SceneGraph::wasRecomputed(int node) const { return changed[node] != 0; }
+    
+    // One linear pass over whole subtrees; parents come first, so their
+    // changed flags are final by the time a child reads them
+    size_t SceneGraph::updateRange(size_t begin, size_t end)
+    {
+	size_t count = 0;
+	
+	for(size_t node = begin; node < end; ++node) {
+	    int parent = parents[node];
+	    
+	    if(dirty[node] || (parent >= 0 && changed[parent])) {
+		worlds[node] = parent >= 0 ? worlds[parent] * locals[node] : locals[node];
+		changed[node] = 1;
+		++count;
+	    } else {
+		changed[node] = 0;
+	    }
+	    
+	    dirty[node] = 0;
+	}
+	
+	return count;
+    }
+    
+    // Serially, or root subtrees in batches of about a grain of nodes
+    void SceneGraph::update(JobSystem* jobs)
+    {
+	PROFILE_ZONE("scene graph");
+	
+	if(!jobs || jobs->getThreadCount() <= 1) {
+	    recomputed = updateRange(0, parents.size());
+	    return;
+	}
+	
+	const size_t grain = 4096;
+	vector<size_t> batches(1, 0);
+	
+	for(size_t root = 0; root < parents.size(); root = subtreeEnds[root])
+	    if(subtreeEnds[root] - batches.back() >= grain || subtreeEnds[root] == parents.size())
+		batches.push_back(subtreeEnds[root]);
+	
+	std::atomic<size_t> count(0);
+	
+	jobs->parallelFor(0, batches.size() - 1, 1, [&](size_t first, size_t last) {
+		for(size_t batch = first; batch < last; ++batch)
+		    count += updateRange(batches[batch], batches[batch + 1]);
+	    });
+	
+	recomputed = count;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef FOREVER_SCENEGRAPH
+#define FOREVER_SCENEGRAPH
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+namespace forever
+{
+    class JobSystem;
+    
+    class SceneGraphException: public std::runtime_error
+    {
+    public:
+	SceneGraphException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // Transform hierarchy kept as flat arrays in depth-first order, so a
+    // parent always comes before its children and every subtree is one
+    // contiguous range of nodes.
+    //
+    // setLocal() only marks a node dirty; update() walks the arrays once,
+    // recomputing a world matrix only where the node or an ancestor
+    // changed. Root subtrees share nothing, so they can update as jobs.
+    class SceneGraph
+    {
+    private:
+	std::vector<int> parents;               // -1 for roots
+	std::vector<size_t> subtreeEnds;        // one past a node's last descendant
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<unsigned char> dirty;       // local changed since the last update
+	std::vector<unsigned char> changed;     // world recomputed in the last update
+	size_t recomputed;
+	
+	size_t updateRange(size_t begin, size_t end);
+	
+    public:
+	SceneGraph(void);
+	
+	// Append a node, returning its index. Nodes go in depth first: parent
+	// must be the last node added or one of its ancestors, or -1.
+	int addNode(int parent, const glm::mat4& local) throw(SceneGraphException);
+	void clear(void);
+	
+	void setLocal(int node, const glm::mat4& local);
+	const glm::mat4& getLocal(int node) const;
+	const glm::mat4& getWorld(int node) const;
+	int getParent(int node) const;
+	size_t size(void) const;
+	
+	// Bring every world matrix up to date, root subtrees spread over
+	// jobs when given
+	void update(JobSystem* jobs = NULL);
+	
+	// Nodes whose world matrix the last update() recomputed
+	size_t getRecomputedCount(void) const;
+	bool wasRecomputed(int node) const;
+    };
+}
+
+#endif
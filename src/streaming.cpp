@@ -0,0 +1,225 @@
+#include "streaming.hpp"
+
+#include <chrono>
+
+#include "capabilities.hpp"
+#include "glslu_deletion.hpp"
+
+namespace forever
+{
+    // Mode names for reports
+    const char* getStreamModeName(StreamMode mode)
+    {
+	switch(mode) {
+	case PERSISTENT_STREAM:
+	    return "persistent";
+	    
+	case UNSYNCHRONIZED_STREAM:
+	    return "unsynchronized";
+	    
+	case MAP_STREAM:
+	    return "map-range";
+	    
+	case SUBDATA_STREAM:
+	    return "subdata";
+	    
+	default:
+	    return "unknown";
+	}
+    }
+    
+    // Persistent mapping needs buffer storage, everything else is 3.0
+    StreamMode getDefaultStreamMode(void)
+    {
+	return getCapabilities().bufferStorage ? PERSISTENT_STREAM : UNSYNCHRONIZED_STREAM;
+    }
+    
+    // Constructor
+    StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize, StreamMode mode, int regionCount, GLsizeiptr alignment) throw(StreamException):
+	target(target), mode(mode), buffer(0), regionSize(0), alignment(alignment > 0 ? alignment : 1), regionCount(regionCount > 0 ? regionCount : 1),
+	persistent(NULL), fences(regionCount > 0 ? regionCount : 1, (GLsync)0), region(0), regionReady(false),
+	cursor(0), mappedOffset(-1), mappedSize(0), waitTime(0.0), waitCount(0)
+    {
+	if(mode == PERSISTENT_STREAM && !getCapabilities().bufferStorage)
+	    throw StreamException("Persistent streaming needs ARB_buffer_storage");
+	
+	// Regions start aligned so every allocation in them can be
+	this->regionSize = (regionSize + this->alignment - 1) / this->alignment * this->alignment;
+	
+	GLsizeiptr size = this->regionSize * this->regionCount;
+	
+	gl::GenBuffers(1, &buffer);
+	gl::BindBuffer(target, buffer);
+	
+	if(mode == PERSISTENT_STREAM) {
+	    GLbitfield flags = gl::MAP_WRITE_BIT | gl::MAP_PERSISTENT_BIT | gl::MAP_COHERENT_BIT;
+	    
+	    gl::BufferStorage(target, size, NULL, flags);
+	    persistent = (char*)gl::MapBufferRange(target, 0, size, flags);
+	    
+	    if(!persistent) {
+		gl::DeleteBuffers(1, &buffer);
+		throw StreamException("Could not map stream buffer persistently");
+	    }
+	} else {
+	    gl::BufferData(target, size, NULL, gl::STREAM_DRAW);
+	}
+	
+	gl::BindBuffer(target, 0);
+    }
+    
+    // Deconstructor!
+    StreamBuffer::~StreamBuffer(void)
+    {
+	for(size_t curr = 0; curr < fences.size(); ++curr)
+	    if(fences[curr])
+		gl::DeleteSync(fences[curr]);
+	
+	// A persistent mapping lives until the buffer is gone
+	if(persistent) {
+	    gl::BindBuffer(target, buffer);
+	    gl::UnmapBuffer(target);
+	    gl::BindBuffer(target, 0);
+	}
+	
+	glslu::releaseObject(glslu::BUFFER_OBJECT, buffer);
+    }
+    
+    // Accessors
+    GLuint StreamBuffer::getBuffer(void) { return buffer; }
+    StreamMode StreamBuffer::getMode(void) { return mode; }
+    GLsizeiptr StreamBuffer::getRegionSize(void) { return regionSize; }
+    double StreamBuffer::getWaitTime(void) { return waitTime; }
+    int StreamBuffer::getWaitCount(void) { return waitCount; }
+    
+    // Block until the GPU has finished with the current region
+    void StreamBuffer::waitForRegion(void)
+    {
+	regionReady = true;
+	
+	if(!fences[region])
+	    return;
+	
+	// Only count real stalls, a signalled fence costs nothing
+	if(gl::ClientWaitSync(fences[region], 0, 0) == gl::TIMEOUT_EXPIRED) {
+	    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	    GLbitfield flags = gl::SYNC_FLUSH_COMMANDS_BIT;
+	    
+	    while(gl::ClientWaitSync(fences[region], flags, 1000000) == gl::TIMEOUT_EXPIRED)
+		flags = 0;
+	    
+	    waitTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	    ++waitCount;
+	}
+	
+	gl::DeleteSync(fences[region]);
+	fences[region] = 0;
+    }
+    
+    // Start a write
+    void* StreamBuffer::map(GLsizeiptr size) throw(StreamException)
+    {
+	if(mappedOffset >= 0)
+	    throw StreamException("Stream buffer is already mapped");
+	
+	if(size > regionSize)
+	    throw StreamException("Stream write is larger than a region");
+	
+	if(!regionReady)
+	    waitForRegion();
+	
+	// Regions only fill up when a frame writes more than it promised
+	if(cursor + size > regionSize)
+	    throw StreamException("Stream region is full for this frame");
+	
+	mappedOffset = region * regionSize + cursor;
+	mappedSize = size;
+	cursor += (size + alignment - 1) / alignment * alignment;
+	
+	switch(mode) {
+	case PERSISTENT_STREAM:
+	    return persistent + mappedOffset;
+	    
+	case UNSYNCHRONIZED_STREAM: {
+	    gl::BindBuffer(target, buffer);
+	    
+	    // Orphan on wrap: the driver hands out fresh storage while the
+	    // GPU finishes with the old, so no region is ever overwritten in use
+	    if(mappedOffset == 0)
+		gl::BufferData(target, regionSize * regionCount, NULL, gl::STREAM_DRAW);
+	    
+	    void* data = gl::MapBufferRange(target, mappedOffset, size, gl::MAP_WRITE_BIT | gl::MAP_UNSYNCHRONIZED_BIT | gl::MAP_INVALIDATE_RANGE_BIT);
+	    
+	    if(!data)
+		throw StreamException("Could not map stream buffer range");
+	    
+	    return data;
+	}
+	    
+	case MAP_STREAM: {
+	    gl::BindBuffer(target, buffer);
+	    void* data = gl::MapBufferRange(target, mappedOffset, size, gl::MAP_WRITE_BIT | gl::MAP_INVALIDATE_RANGE_BIT);
+	    
+	    if(!data)
+		throw StreamException("Could not map stream buffer range");
+	    
+	    return data;
+	}
+	    
+	default:
+	    staging.resize(size);
+	    return size > 0 ? &staging[0] : NULL;
+	}
+    }
+    
+    // Finish a write
+    GLintptr StreamBuffer::unmap(void)
+    {
+	GLintptr offset = mappedOffset;
+	
+	if(offset < 0)
+	    return 0;
+	
+	switch(mode) {
+	case PERSISTENT_STREAM:
+	    break;
+	    
+	case UNSYNCHRONIZED_STREAM:
+	case MAP_STREAM:
+	    gl::BindBuffer(target, buffer);
+	    gl::UnmapBuffer(target);
+	    break;
+	    
+	default:
+	    gl::BindBuffer(target, buffer);
+	    
+	    if(mappedSize > 0)
+		gl::BufferSubData(target, offset, mappedSize, &staging[0]);
+	    
+	    break;
+	}
+	
+	mappedOffset = -1;
+	mappedSize = 0;
+	
+	return offset;
+    }
+    
+    // Fence the frame's region and move to the next
+    void StreamBuffer::fence(void)
+    {
+	// Orphaning and the driver-synchronized modes need no fences of their
+	// own. A frame that never mapped leaves the region's old fence; the new
+	// one covers the same commands, so it is dropped without waiting.
+	if(mode == PERSISTENT_STREAM) {
+	    if(fences[region])
+		gl::DeleteSync(fences[region]);
+	    
+	    fences[region] = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	
+	region = (region + 1) % regionCount;
+	regionReady = false;
+	cursor = 0;
+    }
+}
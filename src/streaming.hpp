@@ -0,0 +1,94 @@
+#ifndef FOREVER_STREAMING
+#define FOREVER_STREAMING
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    class StreamException: public std::runtime_error
+    {
+    public:
+	StreamException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // How a StreamBuffer gets data to the GPU
+    enum StreamMode
+    {
+	PERSISTENT_STREAM,      // mapped once, coherent, regions guarded by fences
+	UNSYNCHRONIZED_STREAM,  // MapBufferRange unsynchronized, orphaned on wrap
+	MAP_STREAM,             // MapBufferRange invalidating, the driver syncs
+	SUBDATA_STREAM,         // staged in client memory, copied by BufferSubData
+	STREAM_MODE_COUNT
+    };
+    
+    const char* getStreamModeName(StreamMode mode);
+    
+    // Best mode the context supports
+    StreamMode getDefaultStreamMode(void);
+    
+    // Ring buffer for data rewritten every frame.
+    //
+    // The buffer is split into regionCount regions of regionSize bytes, one
+    // per frame in flight. Each frame write through map()/unmap() pairs, draw
+    // from the offsets unmap() hands back, then call fence() once the draws
+    // reading the frame's data are issued. In PERSISTENT_STREAM mode the CPU
+    // writes straight into GPU-visible memory and only waits if it laps a
+    // region the GPU is still reading.
+    class StreamBuffer
+    {
+    private:
+	GLenum target;
+	StreamMode mode;
+	GLuint buffer;
+	GLsizeiptr regionSize;
+	GLsizeiptr alignment;
+	int regionCount;
+	
+	// Persistent mapping and the fence guarding each region
+	char* persistent;
+	std::vector<GLsync> fences;
+	int region;
+	bool regionReady;
+	
+	// Write cursor and the allocation being written
+	GLintptr cursor;
+	GLintptr mappedOffset;
+	GLsizeiptr mappedSize;
+	std::vector<char> staging;
+	
+	// Time spent blocked on fences, for tuning regionCount
+	double waitTime;
+	int waitCount;
+	
+	// Prevent object copying
+	StreamBuffer(const StreamBuffer& other) {}
+	StreamBuffer& operator=(const StreamBuffer& other) { return *this; }
+	
+	void waitForRegion(void);
+	
+    public:
+	StreamBuffer(GLenum target, GLsizeiptr regionSize, StreamMode mode = getDefaultStreamMode(), int regionCount = 3, GLsizeiptr alignment = 256) throw(StreamException);
+	~StreamBuffer(void);
+	
+	GLuint getBuffer(void);
+	StreamMode getMode(void);
+	GLsizeiptr getRegionSize(void);
+	double getWaitTime(void);
+	int getWaitCount(void);
+	
+	// Writable pointer to size bytes of this frame's region
+	void* map(GLsizeiptr size) throw(StreamException);
+	
+	// Finish the current write, returns its offset into getBuffer()
+	GLintptr unmap(void);
+	
+	// Close the frame once its draws are issued
+	void fence(void);
+    };
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include "texturearray.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include "capabilities.hpp"
+#include "glslu_deletion.hpp"
+#include "jobs.hpp"
+#include "tga.hpp"
+
+using std::vector;
+using std::string;
+
+namespace forever
+{
+    static GLsizei roundUp(GLsizei value, GLsizei multiple) { return (value + multiple - 1) / multiple * multiple; }
+    
+    // Constructor
+    TextureAtlas::TextureAtlas(GLsizei width, GLsizei height, GLsizei alignment):
+	width(width), height(height), alignment(alignment > 0 ? alignment : 1)
+    {}
+    
+    // First shelf that fits, else a new shelf, else a new layer
+    bool TextureAtlas::place(GLsizei width, GLsizei height, AtlasSlot& slot)
+    {
+	width = roundUp(width, alignment);
+	height = roundUp(height, alignment);
+	
+	if(width > this->width || height > this->height)
+	    return false;
+	
+	slot.width = width;
+	slot.height = height;
+	
+	for(size_t layer = 0; layer <= shelves.size(); ++layer) {
+	    if(layer == shelves.size()) {
+		shelves.push_back(vector<Shelf>());
+		tops.push_back(0);
+	    }
+	    
+	    vector<Shelf>& layerShelves = shelves[layer];
+	    
+	    for(size_t curr = 0; curr < layerShelves.size(); ++curr) {
+		Shelf& shelf = layerShelves[curr];
+		
+		if(height <= shelf.height && shelf.x + width <= this->width) {
+		    slot.layer = (GLuint)layer;
+		    slot.x = shelf.x;
+		    slot.y = shelf.y;
+		    shelf.x += width;
+		    return true;
+		}
+	    }
+	    
+	    if(tops[layer] + height <= this->height) {
+		Shelf shelf = {tops[layer], height, width};
+		layerShelves.push_back(shelf);
+		tops[layer] += height;
+		
+		slot.layer = (GLuint)layer;
+		slot.x = 0;
+		slot.y = shelf.y;
+		return true;
+	    }
+	}
+	
+	return false;
+    }
+    
+    GLsizei TextureAtlas::getLayerCount(void) const { return (GLsizei)shelves.size(); }
+    
+    // One image's slot, the image placed inside its gutter
+    struct ArrayImage
+    {
+	GLsizei width, height;
+	AtlasSlot slot;
+	GLsizei gutterX, gutterY;
+    };
+    
+    // Decode into the middle of a slot, repeat the edges out to its
+    // borders, then filter the slot's mip chain, level 0 first
+    static void buildSlotChain(const string& filename, const ArrayImage& image, GLsizei levels, vector<unsigned char>& chain) throw(ImageException)
+    {
+	vector<unsigned char> pixels((size_t)image.width * image.height * 4);
+	decodeTga(filename, &pixels[0], image.width, image.height);
+	
+	GLsizeiptr size = 0;
+	
+	for(GLsizei level = 0; level < levels; ++level)
+	    size += (GLsizeiptr)(image.slot.width >> level) * (image.slot.height >> level) * 4;
+	
+	chain.resize(size);
+	
+	for(GLsizei y = 0; y < image.slot.height; ++y) {
+	    GLsizei sourceY = std::min(std::max(y - image.gutterY, 0), image.height - 1);
+	    
+	    for(GLsizei x = 0; x < image.slot.width; ++x) {
+		GLsizei sourceX = std::min(std::max(x - image.gutterX, 0), image.width - 1);
+		
+		for(int channel = 0; channel < 4; ++channel)
+		    chain[((size_t)y * image.slot.width + x) * 4 + channel] = pixels[((size_t)sourceY * image.width + sourceX) * 4 + channel];
+	    }
+	}
+	
+	unsigned char* level = &chain[0];
+	
+	for(GLsizei curr = 1; curr < levels; ++curr) {
+	    GLsizei width = image.slot.width >> (curr - 1), height = image.slot.height >> (curr - 1);
+	    unsigned char* next = level + (size_t)width * height * 4;
+	    
+	    filterMipLevel(level, width, height, next, width / 2, height / 2);
+	    level = next;
+	}
+    }
+    
+    // Constructor
+    TextureArray::TextureArray(const vector<string>& filenames, JobSystem& jobs, GLsizei layerSize, GLsizei levels) throw(TextureException):
+	texture(0), layerSize(0), layers(0), levels(std::max(levels, 1)), coverage(0.0)
+    {
+	if(filenames.empty())
+	    throw TextureException("A texture array needs at least one image");
+	
+	GLsizei alignment = 1 << (this->levels - 1);
+	GLsizei gutter = alignment / 2;
+	vector<ArrayImage> images(filenames.size());
+	
+	// Sizes first, the packing needs nothing else
+	try {
+	    for(size_t curr = 0; curr < filenames.size(); ++curr) {
+		readTgaSize(filenames[curr], images[curr].width, images[curr].height);
+		layerSize = std::max(layerSize, std::max(images[curr].width, images[curr].height));
+	    }
+	} catch(ImageException& e) {
+	    throw TextureException(e.what());
+	}
+	
+	this->layerSize = layerSize = roundUp(layerSize, alignment);
+	
+	// Tallest first packs shelves tighter
+	vector<size_t> order(images.size());
+	
+	for(size_t curr = 0; curr < order.size(); ++curr)
+	    order[curr] = curr;
+	
+	std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b) { return images[a].height > images[b].height; });
+	
+	TextureAtlas atlas(layerSize, layerSize, alignment);
+	GLsizeiptr imageArea = 0;
+	
+	for(size_t curr = 0; curr < order.size(); ++curr) {
+	    ArrayImage& image = images[order[curr]];
+	    GLsizei slotWidth = std::min(roundUp(image.width + 2 * gutter, alignment), layerSize);
+	    GLsizei slotHeight = std::min(roundUp(image.height + 2 * gutter, alignment), layerSize);
+	    
+	    if(!atlas.place(slotWidth, slotHeight, image.slot))
+		throw TextureException("Could not place \"" + filenames[order[curr]] + "\" in the texture array");
+	    
+	    image.gutterX = (slotWidth - image.width) / 2;
+	    image.gutterY = (slotHeight - image.height) / 2;
+	    imageArea += (GLsizeiptr)image.width * image.height;
+	}
+	
+	layers = atlas.getLayerCount();
+	coverage = (double)imageArea / ((double)layerSize * layerSize * layers);
+	
+	GLint maxLayers = 0;
+	gl::GetIntegerv(gl::MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+	
+	if(layers > maxLayers) {
+	    std::stringstream error;
+	    error << "Textures need " << layers << " array layers, the context allows " << maxLayers;
+	    throw TextureException(error.str());
+	}
+	
+	gl::GenTextures(1, &texture);
+	gl::BindTexture(gl::TEXTURE_2D_ARRAY, texture);
+	
+	if(getCapabilities().textureStorage) {
+	    gl::TexStorage3D(gl::TEXTURE_2D_ARRAY, this->levels, gl::RGBA8, layerSize, layerSize, layers);
+	} else {
+	    for(GLsizei level = 0; level < this->levels; ++level)
+		gl::TexImage3D(gl::TEXTURE_2D_ARRAY, level, gl::RGBA8, layerSize >> level, layerSize >> level, layers, 0, gl::RGBA, gl::UNSIGNED_BYTE, NULL);
+	}
+	
+	gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_MIN_FILTER, gl::LINEAR_MIPMAP_LINEAR);
+	gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_MAG_FILTER, gl::LINEAR);
+	gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_WRAP_S, gl::CLAMP_TO_EDGE);
+	gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_WRAP_T, gl::CLAMP_TO_EDGE);
+	gl::TexParameteri(gl::TEXTURE_2D_ARRAY, gl::TEXTURE_MAX_LEVEL, this->levels - 1);
+	
+	// A few images at a time, decoded across the jobs and uploaded here
+	size_t batch = (size_t)std::max(jobs.getThreadCount(), 1);
+	vector<vector<unsigned char> > chains(batch);
+	vector<string> errors(batch);
+	
+	for(size_t begin = 0; begin < images.size(); begin += batch) {
+	    size_t end = std::min(begin + batch, images.size());
+	    
+	    jobs.parallelFor(begin, end, 1, [&](size_t first, size_t last) {
+		    for(size_t curr = first; curr < last; ++curr) {
+			try {
+			    buildSlotChain(filenames[curr], images[curr], this->levels, chains[curr - begin]);
+			} catch(ImageException& e) {
+			    errors[curr - begin] = e.what();
+			}
+		    }
+		});
+	    
+	    for(size_t curr = begin; curr < end; ++curr) {
+		if(!errors[curr - begin].empty()) {
+		    gl::BindTexture(gl::TEXTURE_2D_ARRAY, 0);
+		    gl::DeleteTextures(1, &texture);
+		    throw TextureException(errors[curr - begin]);
+		}
+		
+		const AtlasSlot& slot = images[curr].slot;
+		const unsigned char* texels = &chains[curr - begin][0];
+		
+		for(GLsizei level = 0; level < this->levels; ++level) {
+		    gl::TexSubImage3D(gl::TEXTURE_2D_ARRAY, level, slot.x >> level, slot.y >> level, slot.layer, slot.width >> level, slot.height >> level, 1, gl::RGBA, gl::UNSIGNED_BYTE, texels);
+		    texels += (size_t)(slot.width >> level) * (slot.height >> level) * 4;
+		}
+	    }
+	}
+	
+	gl::BindTexture(gl::TEXTURE_2D_ARRAY, 0);
+	
+	for(size_t curr = 0; curr < images.size(); ++curr) {
+	    const ArrayImage& image = images[curr];
+	    TextureRegion region = {
+		image.slot.layer,
+		{(GLfloat)(image.slot.x + image.gutterX) / layerSize, (GLfloat)(image.slot.y + image.gutterY) / layerSize},
+		{(GLfloat)image.width / layerSize, (GLfloat)image.height / layerSize}
+	    };
+	    
+	    regions.push_back(region);
+	}
+    }
+    
+    // Deconstructor!
+    TextureArray::~TextureArray(void)
+    {
+	glslu::releaseObject(glslu::TEXTURE_OBJECT, texture);
+    }
+    
+    // Accessors
+    GLuint TextureArray::getTexture(void) const { return texture; }
+    GLsizei TextureArray::getLayerCount(void) const { return layers; }
+    GLsizei TextureArray::getLayerSize(void) const { return layerSize; }
+    double TextureArray::getCoverage(void) const { return coverage; }
+    const vector<TextureRegion>& TextureArray::getRegions(void) const { return regions; }
+}
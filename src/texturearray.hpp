@@ -0,0 +1,96 @@
+#ifndef FOREVER_TEXTUREARRAY
+#define FOREVER_TEXTUREARRAY
+
+#include <string>
+#include <vector>
+
+#include "gl_core_4_4.hpp"
+#include "textures.hpp"
+
+namespace forever
+{
+    class JobSystem;
+    
+    // Where an image landed: its layer, then its rect in normalized
+    // coordinates of that layer
+    struct TextureRegion
+    {
+	GLuint layer;
+	GLfloat offset[2];
+	GLfloat scale[2];
+    };
+    
+    // Texels of one layer set aside for an image
+    struct AtlasSlot
+    {
+	GLuint layer;
+	GLsizei x, y;
+	GLsizei width, height;
+    };
+    
+    // Shelf packer over as many equal layers as it takes. Slots are rounded
+    // up to a multiple of alignment and start on one, so a slot stays whole
+    // down that many halvings of the mip chain.
+    class TextureAtlas
+    {
+    private:
+	struct Shelf
+	{
+	    GLsizei y, height;
+	    GLsizei x;          // first free column
+	};
+	
+	GLsizei width, height, alignment;
+	std::vector<std::vector<Shelf> > shelves;
+	std::vector<GLsizei> tops;
+	
+    public:
+	TextureAtlas(GLsizei width, GLsizei height, GLsizei alignment = 1);
+	
+	// Reserve width x height texels, opening a layer when none has room;
+	// false when that is more than a layer
+	bool place(GLsizei width, GLsizei height, AtlasSlot& slot);
+	
+	GLsizei getLayerCount(void) const;
+    };
+    
+    // TGA images packed into the layers of one TEXTURE_2D_ARRAY, so shapes
+    // with different textures still share a draw: each instance carries its
+    // layer and rect, and the shader samples the array.
+    //
+    // Slots come from a TextureAtlas aligned to the smallest mip, each
+    // image inside a gutter of its repeated edge texels so filtering and
+    // the smaller mips do not bleed in from its neighbours. Mips are
+    // filtered per slot. The array holds only the layers the packing used,
+    // and the files decode across jobs.
+    class TextureArray
+    {
+    private:
+	GLuint texture;
+	GLsizei layerSize, layers, levels;
+	std::vector<TextureRegion> regions;
+	double coverage;
+	
+	// Prevent object copying
+	TextureArray(const TextureArray& other);
+	TextureArray& operator=(const TextureArray& other);
+	
+    public:
+	// Square layers of layerSize, grown to the largest image and rounded
+	// to a multiple of 1 << (levels - 1)
+	TextureArray(const std::vector<std::string>& filenames, JobSystem& jobs, GLsizei layerSize = 1024, GLsizei levels = 5) throw(TextureException);
+	~TextureArray(void);
+	
+	GLuint getTexture(void) const;
+	GLsizei getLayerCount(void) const;
+	GLsizei getLayerSize(void) const;
+	
+	// Fraction of the layers' texels that are image, not gutter or free
+	double getCoverage(void) const;
+	
+	// One per file, in the order given
+	const std::vector<TextureRegion>& getRegions(void) const;
+    };
+}
+
+#endif
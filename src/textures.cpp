@@ -0,0 +1,480 @@
+#include "textures.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <cstring>
+
+#include "capabilities.hpp"
+#include "glslu_deletion.hpp"
+#include "profiler.hpp"
+#include "tga.hpp"
+
+using std::vector;
+using std::string;
+
+namespace forever
+{
+    // Staging allocations start on this boundary
+    static const GLsizeiptr STAGING_ALIGNMENT = 256;
+    
+    // Solid colour
+    GLuint createSolidTexture(GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha, GLenum target)
+    {
+	GLubyte texel[4] = {red, green, blue, alpha};
+	GLuint texture = 0;
+	
+	gl::GenTextures(1, &texture);
+	gl::BindTexture(target, texture);
+	
+	if(target == gl::TEXTURE_2D_ARRAY)
+	    gl::TexImage3D(target, 0, gl::RGBA8, 1, 1, 1, 0, gl::RGBA, gl::UNSIGNED_BYTE, texel);
+	else
+	    gl::TexImage2D(target, 0, gl::RGBA8, 1, 1, 0, gl::RGBA, gl::UNSIGNED_BYTE, texel);
+	
+	gl::TexParameteri(target, gl::TEXTURE_MIN_FILTER, gl::NEAREST);
+	gl::TexParameteri(target, gl::TEXTURE_MAG_FILTER, gl::NEAREST);
+	gl::BindTexture(target, 0);
+	
+	return texture;
+    }
+    
+    // Halving until both sides reach one
+    GLsizei getMipLevelCount(GLsizei width, GLsizei height)
+    {
+	GLsizei levels = 1;
+	
+	for(GLsizei size = std::max(width, height); size > 1; size >>= 1)
+	    ++levels;
+	
+	return levels;
+    }
+    
+    // Level sizes and where each starts in a staged chain, level 0 first
+    static GLsizei getLevelSize(GLsizei size, GLsizei level) { return std::max(size >> level, 1); }
+    
+    static GLsizeiptr getLevelOffset(GLsizei width, GLsizei height, GLsizei level)
+    {
+	GLsizeiptr offset = 0;
+	
+	for(GLsizei curr = 0; curr < level; ++curr)
+	    offset += (GLsizeiptr)getLevelSize(width, curr) * getLevelSize(height, curr) * 4;
+	
+	return offset;
+    }
+    
+    // 2x2 box filter, clamped at odd edges
+    void filterMipLevel(const unsigned char* source, GLsizei sourceWidth, GLsizei sourceHeight, unsigned char* target, GLsizei width, GLsizei height)
+    {
+	for(GLsizei y = 0; y < height; ++y) {
+	    const unsigned char* row0 = source + (size_t)std::min(2 * y, sourceHeight - 1) * sourceWidth * 4;
+	    const unsigned char* row1 = source + (size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth * 4;
+	    
+	    for(GLsizei x = 0; x < width; ++x) {
+		GLsizei x0 = std::min(2 * x, sourceWidth - 1) * 4, x1 = std::min(2 * x + 1, sourceWidth - 1) * 4;
+		
+		for(int channel = 0; channel < 4; ++channel)
+		    target[((size_t)y * width + x) * 4 + channel] = (row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel] + 2) / 4;
+	    }
+	}
+    }
+    
+    // Constructor
+    TextureStreamer::TextureStreamer(GLsizeiptr stagingSize, GLsizeiptr uploadBudget, int decodeThreads) throw(TextureException):
+	pixelBuffer(0), staging(NULL), stagingSize(stagingSize), ringHead(0), ringTail(0), ringEmpty(true),
+	uploadBudget(uploadBudget > 0 ? uploadBudget : 1), stopping(false)
+    {
+	if(stagingSize <= 0)
+	    throw TextureException("Texture staging needs some space");
+	
+	// Workers write straight into memory the GL reads from, when it can
+	if(getCapabilities().bufferStorage) {
+	    GLbitfield flags = gl::MAP_WRITE_BIT | gl::MAP_PERSISTENT_BIT | gl::MAP_COHERENT_BIT;
+	    
+	    gl::GenBuffers(1, &pixelBuffer);
+	    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, pixelBuffer);
+	    gl::BufferStorage(gl::PIXEL_UNPACK_BUFFER, stagingSize, NULL, flags);
+	    staging = (unsigned char*)gl::MapBufferRange(gl::PIXEL_UNPACK_BUFFER, 0, stagingSize, flags);
+	    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+	    
+	    if(!staging) {
+		gl::DeleteBuffers(1, &pixelBuffer);
+		pixelBuffer = 0;
+	    }
+	}
+	
+	if(!staging) {
+	    clientStaging.resize(stagingSize);
+	    staging = &clientStaging[0];
+	}
+	
+	stats.requested = stats.resident = stats.failed = 0;
+	resetStats();
+	
+	for(int curr = 0; curr < std::max(decodeThreads, 1); ++curr)
+	    decoders.push_back(std::thread(&TextureStreamer::decoderMain, this));
+    }
+    
+    // Deconstructor!
+    TextureStreamer::~TextureStreamer(void)
+    {
+	// Decodes still write into staging, let them finish first
+	{
+	    std::lock_guard<std::mutex> guard(decodeLock);
+	    stopping = true;
+	}
+	
+	decodeReady.notify_all();
+	
+	for(size_t curr = 0; curr < decoders.size(); ++curr)
+	    decoders[curr].join();
+	
+	for(size_t curr = 0; curr < requests.size(); ++curr) {
+	    if(requests[curr]->fence)
+		gl::DeleteSync(requests[curr]->fence);
+	    
+	    delete requests[curr];
+	}
+	
+	if(pixelBuffer) {
+	    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, pixelBuffer);
+	    gl::UnmapBuffer(gl::PIXEL_UNPACK_BUFFER);
+	    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+	    glslu::releaseObject(glslu::BUFFER_OBJECT, pixelBuffer);
+	}
+	
+	for(size_t curr = 0; curr < textures.size(); ++curr)
+	    glslu::releaseObject(glslu::TEXTURE_OBJECT, textures[curr]);
+    }
+    
+    // Accessors
+    bool TextureStreamer::isPersistent(void) const { return pixelBuffer != 0; }
+    GLsizeiptr TextureStreamer::getUploadBudget(void) const { return uploadBudget; }
+    void TextureStreamer::setUploadBudget(GLsizeiptr budget) { uploadBudget = budget > 0 ? budget : 1; }
+    const TextureStreamStats& TextureStreamer::getStats(void) const { return stats; }
+    
+    int TextureStreamer::getPendingCount(void) const { return stats.requested - stats.resident - stats.failed; }
+    
+    void TextureStreamer::resetStats(void)
+    {
+	stats.uploads = 0;
+	stats.uploadedBytes = 0;
+	stats.maxUpdateTime = 0.0;
+    }
+    
+    // Allocate the chain and show the placeholder
+    GLuint TextureStreamer::load(const string& filename) throw(TextureException)
+    {
+	int width, height;
+	
+	try {
+	    readTgaSize(filename, width, height);
+	} catch(ImageException& e) {
+	    throw TextureException(e.what());
+	}
+	
+	GLsizei levels = getMipLevelCount(width, height);
+	GLsizeiptr size = getLevelOffset(width, height, levels);
+	
+	if(size > stagingSize)
+	    throw TextureException("\"" + filename + "\" is larger than the texture staging buffer");
+	
+	GLuint texture = 0;
+	gl::GenTextures(1, &texture);
+	gl::BindTexture(gl::TEXTURE_2D, texture);
+	
+	if(getCapabilities().textureStorage) {
+	    gl::TexStorage2D(gl::TEXTURE_2D, levels, gl::RGBA8, width, height);
+	} else {
+	    for(GLsizei level = 0; level < levels; ++level)
+		gl::TexImage2D(gl::TEXTURE_2D, level, gl::RGBA8, getLevelSize(width, level), getLevelSize(height, level), 0, gl::RGBA, gl::UNSIGNED_BYTE, NULL);
+	}
+	
+	gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MIN_FILTER, gl::LINEAR_MIPMAP_LINEAR);
+	gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAG_FILTER, gl::LINEAR);
+	gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_S, gl::REPEAT);
+	gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_WRAP_T, gl::REPEAT);
+	gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_BASE_LEVEL, levels - 1);
+	gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_MAX_LEVEL, levels - 1);
+	
+	// Grey until the real levels arrive
+	GLubyte placeholder[4] = {128, 128, 128, 255};
+	gl::TexSubImage2D(gl::TEXTURE_2D, levels - 1, 0, 0, 1, 1, gl::RGBA, gl::UNSIGNED_BYTE, placeholder);
+	gl::BindTexture(gl::TEXTURE_2D, 0);
+	
+	Request* request = new Request();
+	request->texture = texture;
+	request->filename = filename;
+	request->width = width;
+	request->height = height;
+	request->levels = levels;
+	request->state = WAITING;
+	request->decoded = false;
+	request->failed = false;
+	request->stagingOffset = 0;
+	request->stagingSize = size;
+	request->level = levels - 1;
+	request->row = 0;
+	request->fence = 0;
+	
+	requests.push_back(request);
+	textures.push_back(texture);
+	++stats.requested;
+	
+	return texture;
+    }
+    
+    // Claim ring space in request order, false when it is all in use
+    bool TextureStreamer::reserve(Request& request)
+    {
+	GLsizeiptr size = (request.stagingSize + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+	GLintptr offset;
+	
+	if(ringEmpty)
+	    ringHead = ringTail = 0;
+	
+	// Free space is [head, end) and [0, tail) when empty or ahead of
+	// the tail, [head, tail) once wrapped
+	if(ringEmpty || ringHead > ringTail) {
+	    if(ringHead + size <= stagingSize)
+		offset = ringHead;
+	    else if(size <= ringTail)
+		offset = 0;
+	    else
+		return false;
+	} else if(ringHead < ringTail && ringHead + size <= ringTail) {
+	    offset = ringHead;
+	} else {
+	    return false;
+	}
+	
+	request.stagingOffset = offset;
+	ringHead = offset + size;
+	ringEmpty = false;
+	
+	return true;
+    }
+    
+    // Decode and filter the chain into its staging
+    void TextureStreamer::decode(Request& request)
+    {
+	PROFILE_ZONE("decode texture");
+	vector<unsigned char> level((size_t)request.width * request.height * 4), next;
+	
+	try {
+	    decodeTga(request.filename, &level[0], request.width, request.height);
+	} catch(ImageException&) {
+	    request.failed = true;
+	    return;
+	}
+	
+	// Staging may be write-combined, so the levels are filtered from a
+	// copy in client memory and only ever written to it
+	unsigned char* out = staging + request.stagingOffset;
+	
+	for(GLsizei curr = 0; curr < request.levels; ++curr) {
+	    GLsizei width = getLevelSize(request.width, curr), height = getLevelSize(request.height, curr);
+	    
+	    if(curr > 0) {
+		next.resize((size_t)width * height * 4);
+		filterMipLevel(&level[0], getLevelSize(request.width, curr - 1), getLevelSize(request.height, curr - 1), &next[0], width, height);
+		level.swap(next);
+	    }
+	    
+	    std::memcpy(out, &level[0], (size_t)width * height * 4);
+	    out += (size_t)width * height * 4;
+	}
+    }
+    
+    // Decode thread
+    void TextureStreamer::decoderMain(void)
+    {
+	if(Profiler::isEnabled())
+	    Profiler::setThreadName("texture decoder");
+	
+	for(;;) {
+	    Request* request;
+	    
+	    {
+		std::unique_lock<std::mutex> guard(decodeLock);
+		decodeReady.wait(guard, [this]() { return stopping || !decodeQueue.empty(); });
+		
+		if(stopping)
+		    return;
+		
+		request = decodeQueue.front();
+		decodeQueue.pop_front();
+	    }
+	    
+	    decode(*request);
+	    request->decoded.store(true, std::memory_order_release);
+	}
+    }
+    
+    // Bands of rows from staging, smallest level first, up to budget bytes
+    GLsizeiptr TextureStreamer::upload(Request& request, GLsizeiptr budget)
+    {
+	GLsizeiptr spent = 0;
+	
+	gl::BindTexture(gl::TEXTURE_2D, request.texture);
+	
+	while(request.level >= 0) {
+	    GLsizei width = getLevelSize(request.width, request.level), height = getLevelSize(request.height, request.level);
+	    GLsizeiptr pitch = (GLsizeiptr)width * 4;
+	    GLsizei rows = (GLsizei)std::min<GLsizeiptr>((budget - spent) / pitch, height - request.row);
+	    
+	    // A row at least, so wide levels still make progress
+	    if(rows < 1) {
+		if(spent > 0)
+		    break;
+		
+		rows = 1;
+	    }
+	    
+	    GLintptr offset = request.stagingOffset + getLevelOffset(request.width, request.height, request.level) + request.row * pitch;
+	    const void* pixels = pixelBuffer ? (const void*)offset : (const void*)(staging + offset);
+	    
+	    gl::TexSubImage2D(gl::TEXTURE_2D, request.level, 0, request.row, width, rows, gl::RGBA, gl::UNSIGNED_BYTE, pixels);
+	    
+	    spent += rows * pitch;
+	    request.row += rows;
+	    ++stats.uploads;
+	    
+	    // A finished level becomes the sharpest one sampled
+	    if(request.row == height) {
+		gl::TexParameteri(gl::TEXTURE_2D, gl::TEXTURE_BASE_LEVEL, request.level);
+		--request.level;
+		request.row = 0;
+	    }
+	    
+	    if(spent >= budget)
+		break;
+	}
+	
+	if(request.level < 0) {
+	    request.fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+	    request.state = FENCED;
+	    ++stats.resident;
+	}
+	
+	stats.uploadedBytes += spent;
+	
+	return spent;
+    }
+    
+    // Free staging the GPU has finished reading, oldest first
+    void TextureStreamer::retire(void)
+    {
+	while(!requests.empty()) {
+	    Request* request = requests.front();
+	    
+	    if(request->state == FENCED) {
+		GLenum result = gl::ClientWaitSync(request->fence, 0, 0);
+		
+		if(result != gl::ALREADY_SIGNALED && result != gl::CONDITION_SATISFIED && result != gl::WAIT_FAILED_)
+		    break;
+		
+		gl::DeleteSync(request->fence);
+		request->fence = 0;
+		request->state = DONE;
+	    }
+	    
+	    if(request->state != DONE)
+		break;
+	    
+	    requests.pop_front();
+	    delete request;
+	}
+	
+	// The oldest claim left marks the tail
+	ringEmpty = true;
+	
+	for(size_t curr = 0; curr < requests.size() && ringEmpty; ++curr) {
+	    if(requests[curr]->state != WAITING) {
+		ringTail = requests[curr]->stagingOffset;
+		ringEmpty = false;
+	    }
+	}
+    }
+    
+    // Per-frame step
+    void TextureStreamer::update(void)
+    {
+	PROFILE_ZONE("stream textures");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	retire();
+	
+	for(size_t curr = 0; curr < requests.size(); ++curr) {
+	    if(requests[curr]->state == WAITING) {
+		if(!reserve(*requests[curr]))
+		    break;
+		
+		requests[curr]->state = DECODING;
+		
+		{
+		    std::lock_guard<std::mutex> guard(decodeLock);
+		    decodeQueue.push_back(requests[curr]);
+		}
+		
+		decodeReady.notify_one();
+	    }
+	}
+	
+	GLsizeiptr budget = uploadBudget;
+	bool uploaded = false;
+	
+	for(size_t curr = 0; curr < requests.size() && budget > 0; ++curr) {
+	    Request& request = *requests[curr];
+	    
+	    if(request.state == DECODING && request.decoded.load(std::memory_order_acquire)) {
+		if(request.failed) {
+		    request.state = DONE;
+		    ++stats.failed;
+		    continue;
+		}
+		
+		request.state = UPLOADING;
+	    }
+	    
+	    if(request.state == UPLOADING) {
+		if(!uploaded && pixelBuffer)
+		    gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, pixelBuffer);
+		
+		uploaded = true;
+		budget -= upload(request, budget);
+	    }
+	}
+	
+	if(uploaded) {
+	    gl::BindTexture(gl::TEXTURE_2D, 0);
+	    
+	    if(pixelBuffer)
+		gl::BindBuffer(gl::PIXEL_UNPACK_BUFFER, 0);
+	}
+	
+	double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.maxUpdateTime = std::max(stats.maxUpdateTime, time);
+    }
+    
+    // Everything now, whatever the budget
+    void TextureStreamer::finish(void)
+    {
+	GLsizeiptr budget = uploadBudget;
+	uploadBudget = stagingSize;
+	
+	while(!requests.empty()) {
+	    update();
+	    
+	    if(requests.empty())
+		break;
+	    
+	    if(requests.front()->state == FENCED)
+		gl::Finish();
+	    else
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	
+	uploadBudget = budget;
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef FOREVER_TEXTURES
+#define FOREVER_TEXTURES
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    class TextureException: public std::runtime_error
+    {
+    public:
+	TextureException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // A 1x1 RGBA8 texture of one colour, e.g. white for untextured draws;
+    // target is TEXTURE_2D or TEXTURE_2D_ARRAY, as one layer
+    GLuint createSolidTexture(GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha, GLenum target = gl::TEXTURE_2D);
+    
+    // Levels in a full mip chain down to 1x1
+    GLsizei getMipLevelCount(GLsizei width, GLsizei height);
+    
+    // Next RGBA8 level down from source with a 2x2 box filter
+    void filterMipLevel(const unsigned char* source, GLsizei sourceWidth, GLsizei sourceHeight, unsigned char* target, GLsizei width, GLsizei height);
+    
+    // Texture counts since creation, upload traffic since the last reset
+    struct TextureStreamStats
+    {
+	int requested;
+	int resident;
+	int failed;                 // left as their placeholder
+	int uploads;                // TexSubImage calls
+	GLsizeiptr uploadedBytes;
+	double maxUpdateTime;       // worst update(), milliseconds
+    };
+    
+    // Loads TGA textures without stalling the frame.
+    //
+    // load() reads only the header, allocates the texture's whole mip chain
+    // (TexStorage2D where available) and shows a grey 1x1 level in its
+    // place. Decoding and mip filtering then run on the streamer's own
+    // threads, not the frame's job system where a waiting render thread
+    // could pick one up, writing the chain into a staging ring: a persistently mapped pixel unpack buffer, or
+    // client memory without buffer storage. Each update() copies decoded
+    // levels into their textures, smallest first and a band of rows at a
+    // time, until the frame's upload budget is spent, lowering the base
+    // level as each one lands so the texture sharpens as it streams in.
+    //
+    // Ring space is claimed in request order and freed once a fence shows
+    // the GPU has read it, so requests wait for room rather than fail.
+    class TextureStreamer
+    {
+    private:
+	enum State
+	{
+	    WAITING,            // for staging space
+	    DECODING,
+	    UPLOADING,
+	    FENCED,             // uploaded, staging still being read
+	    DONE
+	};
+	
+	struct Request
+	{
+	    GLuint texture;
+	    std::string filename;
+	    GLsizei width, height, levels;
+	    State state;
+	    std::atomic<bool> decoded;
+	    bool failed;
+	    GLintptr stagingOffset;
+	    GLsizeiptr stagingSize;
+	    GLsizei level;      // next level to upload, counting down
+	    GLsizei row;        // next row of it
+	    GLsync fence;
+	};
+	
+	GLuint pixelBuffer;
+	unsigned char* staging;
+	std::vector<unsigned char> clientStaging;
+	GLsizeiptr stagingSize;
+	GLintptr ringHead, ringTail;
+	bool ringEmpty;
+	GLsizeiptr uploadBudget;
+	
+	std::deque<Request*> requests;
+	std::deque<GLuint> textures;
+	TextureStreamStats stats;
+	
+	// Decode threads and the requests handed to them
+	std::vector<std::thread> decoders;
+	std::deque<Request*> decodeQueue;
+	std::mutex decodeLock;
+	std::condition_variable decodeReady;
+	bool stopping;
+	
+	bool reserve(Request& request);
+	void decode(Request& request);
+	void decoderMain(void);
+	GLsizeiptr upload(Request& request, GLsizeiptr budget);
+	void retire(void);
+	
+	// Prevent object copying
+	TextureStreamer(const TextureStreamer& other);
+	TextureStreamer& operator=(const TextureStreamer& other);
+	
+    public:
+	TextureStreamer(GLsizeiptr stagingSize = 32 << 20, GLsizeiptr uploadBudget = 1 << 20, int decodeThreads = 1) throw(TextureException);
+	~TextureStreamer(void);
+	
+	// A texture that streams in over the next frames, owned by the streamer
+	GLuint load(const std::string& filename) throw(TextureException);
+	
+	// Once a frame on the GL thread, before drawing
+	void update(void);
+	
+	// Update until everything requested is resident or has failed
+	void finish(void);
+	
+	bool isPersistent(void) const;
+	int getPendingCount(void) const;
+	GLsizeiptr getUploadBudget(void) const;
+	void setUploadBudget(GLsizeiptr budget);
+	
+	const TextureStreamStats& getStats(void) const;
+	void resetStats(void);
+    };
+}
+
+#endif
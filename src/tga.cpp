@@ -0,0 +1,183 @@
+#include "tga.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+using std::string;
+using std::vector;
+using std::ifstream;
+using std::ofstream;
+using std::ios;
+
+namespace forever
+{
+    // The fixed header, little endian throughout
+    struct TgaHeader
+    {
+	int idLength;
+	int colourMapType;
+	int imageType;
+	int width, height;
+	int pixelDepth;
+	int descriptor;
+    };
+    
+    static int readShort(const unsigned char* bytes) { return bytes[0] | bytes[1] << 8; }
+    
+    // Parse and vet a header
+    static TgaHeader parseHeader(const string& filename, const unsigned char* bytes) throw(ImageException)
+    {
+	TgaHeader header;
+	header.idLength = bytes[0];
+	header.colourMapType = bytes[1];
+	header.imageType = bytes[2];
+	header.width = readShort(bytes + 12);
+	header.height = readShort(bytes + 14);
+	header.pixelDepth = bytes[16];
+	header.descriptor = bytes[17];
+	
+	int kind = header.imageType & ~8;
+	std::stringstream error;
+	
+	if(header.colourMapType != 0 || (kind != 2 && kind != 3))
+	    error << "\"" << filename << "\" is not a true colour or greyscale TGA (type " << header.imageType << ")";
+	else if((kind == 2 && header.pixelDepth != 24 && header.pixelDepth != 32) || (kind == 3 && header.pixelDepth != 8))
+	    error << "\"" << filename << "\" has unsupported " << header.pixelDepth << "-bit pixels";
+	else if(header.width == 0 || header.height == 0)
+	    error << "\"" << filename << "\" is empty";
+	else if(header.descriptor & 0x10)
+	    error << "\"" << filename << "\" is stored right to left";
+	
+	if(!error.str().empty())
+	    throw ImageException(error.str());
+	
+	return header;
+    }
+    
+    // Header only
+    void readTgaSize(const string& filename, int& width, int& height) throw(ImageException)
+    {
+	ifstream input(filename.c_str(), ios::in | ios::binary);
+	unsigned char bytes[18];
+	
+	if(!input.read((char*)bytes, sizeof(bytes)))
+	    throw ImageException("Could not read TGA header from \"" + filename + "\"");
+	
+	TgaHeader header = parseHeader(filename, bytes);
+	
+	width = header.width;
+	height = header.height;
+    }
+    
+    // Whole file in, RGBA rows out
+    void decodeTga(const string& filename, unsigned char* target, int width, int height) throw(ImageException)
+    {
+	ifstream input(filename.c_str(), ios::in | ios::binary | ios::ate);
+	
+	if(!input)
+	    throw ImageException("Could not open \"" + filename + "\"");
+	
+	vector<unsigned char> file((size_t)input.tellg());
+	input.seekg(0);
+	
+	if(file.size() < 18 || !input.read((char*)&file[0], file.size()))
+	    throw ImageException("Could not read \"" + filename + "\"");
+	
+	TgaHeader header = parseHeader(filename, &file[0]);
+	
+	if(header.width != width || header.height != height)
+	    throw ImageException("\"" + filename + "\" changed size while loading");
+	
+	const unsigned char* data = &file[0] + 18 + header.idLength;
+	const unsigned char* end = &file[0] + file.size();
+	int bytesPerPixel = header.pixelDepth / 8;
+	bool compressed = (header.imageType & 8) != 0;
+	bool topDown = (header.descriptor & 0x20) != 0;
+	size_t pixelCount = (size_t)width * height;
+	size_t pixel = 0;
+	
+	// Packets may run across rows, so pixels are counted over the image
+	while(pixel < pixelCount) {
+	    size_t run = 1;
+	    bool repeat = false;
+	    
+	    if(compressed) {
+		if(data >= end)
+		    break;
+		
+		run = (*data & 0x7F) + 1;
+		repeat = (*data & 0x80) != 0;
+		++data;
+	    } else {
+		run = pixelCount;
+	    }
+	    
+	    if(run > pixelCount - pixel)
+		run = pixelCount - pixel;
+	    
+	    for(size_t curr = 0; curr < run; ++curr, ++pixel) {
+		if(data + bytesPerPixel > end)
+		    throw ImageException("\"" + filename + "\" is truncated");
+		
+		size_t x = pixel % width, y = pixel / width;
+		unsigned char* out = target + ((topDown ? height - 1 - y : y) * width + x) * 4;
+		
+		// Stored BGR(A)
+		if(bytesPerPixel == 1) {
+		    out[0] = out[1] = out[2] = data[0];
+		    out[3] = 255;
+		} else {
+		    out[0] = data[2];
+		    out[1] = data[1];
+		    out[2] = data[0];
+		    out[3] = bytesPerPixel == 4 ? data[3] : 255;
+		}
+		
+		if(!repeat || curr == run - 1)
+		    data += bytesPerPixel;
+	    }
+	}
+	
+	if(pixel < pixelCount)
+	    throw ImageException("\"" + filename + "\" is truncated");
+    }
+    
+    // Uncompressed writer, for generated test images
+    void writeTga(const string& filename, const unsigned char* pixels, int width, int height) throw(ImageException)
+    {
+	ofstream output(filename.c_str(), ios::out | ios::binary | ios::trunc);
+	
+	if(!output)
+	    throw ImageException("Could not write \"" + filename + "\"");
+	
+	unsigned char header[18] = {0};
+	header[2] = 2;
+	header[12] = width & 0xFF;
+	header[13] = (width >> 8) & 0xFF;
+	header[14] = height & 0xFF;
+	header[15] = (height >> 8) & 0xFF;
+	header[16] = 32;
+	header[17] = 8;
+	
+	output.write((const char*)header, sizeof(header));
+	
+	vector<unsigned char> row(width * 4);
+	
+	for(int y = 0; y < height; ++y) {
+	    const unsigned char* in = pixels + (size_t)y * width * 4;
+	    
+	    for(int x = 0; x < width; ++x) {
+		row[x * 4 + 0] = in[x * 4 + 2];
+		row[x * 4 + 1] = in[x * 4 + 1];
+		row[x * 4 + 2] = in[x * 4 + 0];
+		row[x * 4 + 3] = in[x * 4 + 3];
+	    }
+	    
+	    output.write((const char*)&row[0], row.size());
+	}
+	
+	if(!output)
+	    throw ImageException("Could not write \"" + filename + "\"");
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef FOREVER_TGA
+#define FOREVER_TGA
+
+#include <stdexcept>
+#include <string>
+
+namespace forever
+{
+    class ImageException: public std::runtime_error
+    {
+    public:
+	ImageException(const std::string &msg): std::runtime_error(msg) {}
+    };
+    
+    // Truevision TGA, the uncompressed and run-length encoded true colour
+    // and greyscale kinds at 8, 24 or 32 bits. Colour-mapped images are
+    // refused. Pixels come out as RGBA8, bottom row first as GL expects.
+    
+    // Dimensions from the 18-byte header alone
+    void readTgaSize(const std::string& filename, int& width, int& height) throw(ImageException);
+    
+    // Decode into target, width * height * 4 bytes the size read above
+    void decodeTga(const std::string& filename, unsigned char* target, int width, int height) throw(ImageException);
+    
+    // Uncompressed 32-bit, bottom row first
+    void writeTga(const std::string& filename, const unsigned char* pixels, int width, int height) throw(ImageException);
+}
+
+#endif
@@ -0,0 +1,122 @@
+#include "throttle.hpp"
+
+#include <algorithm>
+
+namespace forever
+{
+    // Constructor
+    FrameThrottle::FrameThrottle(int framesInFlight):
+	framesInFlight(std::max(framesInFlight, 0))
+    {
+	resetStats();
+    }
+    
+    // Deconstructor!
+    FrameThrottle::~FrameThrottle(void)
+    {
+	for(size_t curr = 0; curr < inFlight.size(); ++curr)
+	    gl::DeleteSync(inFlight[curr].fence);
+    }
+    
+    // Accessors
+    int FrameThrottle::getFramesInFlight(void) const { return framesInFlight; }
+    
+    // A frame the GPU has finished
+    void FrameThrottle::retire(const Frame& frame)
+    {
+	double latency = std::chrono::duration<double, std::milli>(Clock::now() - frame.submitted).count();
+	
+	latencyTotal += latency;
+	latencyMax = std::max(latencyMax, latency);
+	++latencyCount;
+	
+	gl::DeleteSync(frame.fence);
+    }
+    
+    // Retire whatever has finished, fences signal in order
+    void FrameThrottle::poll(void)
+    {
+	while(!inFlight.empty()) {
+	    GLenum result = gl::ClientWaitSync(inFlight.front().fence, 0, 0);
+	    
+	    if(result != gl::ALREADY_SIGNALED && result != gl::CONDITION_SATISFIED)
+		break;
+	    
+	    retire(inFlight.front());
+	    inFlight.pop_front();
+	}
+    }
+    
+    // Hold the CPU back
+    void FrameThrottle::wait(void)
+    {
+	poll();
+	
+	if(framesInFlight == 0 || (int)inFlight.size() < framesInFlight)
+	    return;
+	
+	Clock::time_point start = Clock::now();
+	
+	while((int)inFlight.size() >= framesInFlight) {
+	    GLbitfield flags = gl::SYNC_FLUSH_COMMANDS_BIT;
+	    GLenum result;
+	    
+	    while((result = gl::ClientWaitSync(inFlight.front().fence, flags, 1000000)) == gl::TIMEOUT_EXPIRED)
+		flags = 0;
+	    
+	    // A lost context will never signal, stop throttling on it
+	    if(result == gl::WAIT_FAILED_) {
+		gl::DeleteSync(inFlight.front().fence);
+		inFlight.pop_front();
+		continue;
+	    }
+	    
+	    retire(inFlight.front());
+	    inFlight.pop_front();
+	}
+	
+	waitTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	++waitCount;
+    }
+    
+    // Fence the frame just swapped
+    void FrameThrottle::fence(void)
+    {
+	if(!gl::FenceSync)
+	    return;
+	
+	Frame frame;
+	frame.fence = gl::FenceSync(gl::SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame.submitted = Clock::now();
+	
+	if(frame.fence)
+	    inFlight.push_back(frame);
+	
+	poll();
+    }
+    
+    // Nothing left for the destructor to delete
+    void FrameThrottle::release(void)
+    {
+	while(!inFlight.empty()) {
+	    gl::ClientWaitSync(inFlight.front().fence, gl::SYNC_FLUSH_COMMANDS_BIT, gl::TIMEOUT_IGNORED);
+	    gl::DeleteSync(inFlight.front().fence);
+	    inFlight.pop_front();
+	}
+    }
+    
+    // Statistics
+    double FrameThrottle::getLatency(void) const { return latencyCount > 0 ? latencyTotal / latencyCount : 0.0; }
+    double FrameThrottle::getMaxLatency(void) const { return latencyMax; }
+    double FrameThrottle::getWaitTime(void) const { return waitTime; }
+    int FrameThrottle::getWaitCount(void) const { return waitCount; }
+    
+    void FrameThrottle::resetStats(void)
+    {
+	latencyTotal = 0.0;
+	latencyMax = 0.0;
+	latencyCount = 0;
+	waitTime = 0.0;
+	waitCount = 0;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef FOREVER_THROTTLE
+#define FOREVER_THROTTLE
+
+#include <deque>
+#include <chrono>
+
+#include "gl_core_4_4.hpp"
+
+namespace forever
+{
+    // Bounds how far the CPU may run ahead of the GPU.
+    //
+    // fence() drops a sync object after every swap; wait(), before recording
+    // the next frame, blocks on the one from framesInFlight frames ago. One
+    // frame in flight is a frame-sized glFinish, more let CPU and GPU overlap
+    // at the cost of latency. Zero leaves queueing to the driver, still
+    // measuring.
+    //
+    // Latency is from a frame's swap to its fence being seen signalled, so it
+    // is an upper bound, checked at each wait() and fence().
+    class FrameThrottle
+    {
+    private:
+	typedef std::chrono::steady_clock Clock;
+	
+	struct Frame
+	{
+	    GLsync fence;
+	    Clock::time_point submitted;
+	};
+	
+	int framesInFlight;
+	std::deque<Frame> inFlight;
+	
+	double latencyTotal;
+	double latencyMax;
+	int latencyCount;
+	double waitTime;
+	int waitCount;
+	
+	void retire(const Frame& frame);
+	void poll(void);
+	
+	// No copies, it owns the fences
+	FrameThrottle(const FrameThrottle&);
+	FrameThrottle& operator=(const FrameThrottle&);
+    
+    public:
+	FrameThrottle(int framesInFlight = 2);
+	~FrameThrottle(void);
+	
+	int getFramesInFlight(void) const;
+	
+	// Block until at most framesInFlight - 1 frames are still queued
+	void wait(void);
+	
+	// Mark the end of a frame, just after swapping
+	void fence(void);
+	
+	// Wait out the frames still queued and delete their fences, before the
+	// context goes
+	void release(void);
+	
+	// Statistics since the last reset, milliseconds
+	double getLatency(void) const;
+	double getMaxLatency(void) const;
+	double getWaitTime(void) const;
+	int getWaitCount(void) const;
+	void resetStats(void);
+    };
+}
+
+#endif
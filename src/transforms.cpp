@@ -0,0 +1,330 @@
+#include "transforms.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "jobs.hpp"
+#include "profiler.hpp"
+
+// Per-function target attributes, as for the culling kernels
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FOREVER_TRANSFORM_X86 1
+#include <immintrin.h>
+#endif
+
+using std::vector;
+
+namespace forever
+{
+    // Array pointers handed to the kernels, in the order they are loaded
+    enum TransformComponent
+    {
+	POSITION_X, POSITION_Y, POSITION_Z,
+	ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+	SCALE_X, SCALE_Y, SCALE_Z,
+	TRANSFORM_COMPONENTS
+    };
+    
+    struct TransformArrays
+    {
+	const float* components[TRANSFORM_COMPONENTS];
+	const GLuint* colour;
+	const GLushort* surface;
+	const GLfloat* layer;
+    };
+    
+    // Source instance of each lane in a block; a short tail repeats its
+    // last instance rather than read past the range
+    static inline void getLanes(const GLuint* indices, size_t index, size_t end, int width, GLuint* lanes)
+    {
+	for(int lane = 0; lane < width; ++lane) {
+	    size_t curr = std::min(index + lane, end - 1);
+	    lanes[lane] = indices ? indices[curr] : (GLuint)curr;
+	}
+    }
+    
+    // Colour and texture through, no spin left for the shader
+    static inline void finishInstance(const TransformArrays& arrays, GLuint source, Instance& target)
+    {
+	std::memcpy(target.colour, &arrays.colour[source], sizeof(target.colour));
+	target.phase = 0.0f;
+	std::memcpy(target.surface, &arrays.surface[source * 4], sizeof(target.surface));
+	target.layer = arrays.layer[source];
+    }
+    
+    // Reference kernel
+    static void composeScalar(const TransformArrays& arrays, const float spin[4], const GLuint* indices, size_t begin, size_t end, Instance* target)
+    {
+	for(size_t curr = begin; curr < end; ++curr) {
+	    GLuint source = indices ? indices[curr] : (GLuint)curr;
+	    float value[TRANSFORM_COMPONENTS];
+	    
+	    for(int component = 0; component < TRANSFORM_COMPONENTS; ++component)
+		value[component] = arrays.components[component][source];
+	    
+	    // rotation * spin
+	    float x = value[ROTATION_W] * spin[0] + value[ROTATION_X] * spin[3] + value[ROTATION_Y] * spin[2] - value[ROTATION_Z] * spin[1];
+	    float y = value[ROTATION_W] * spin[1] - value[ROTATION_X] * spin[2] + value[ROTATION_Y] * spin[3] + value[ROTATION_Z] * spin[0];
+	    float z = value[ROTATION_W] * spin[2] + value[ROTATION_X] * spin[1] - value[ROTATION_Y] * spin[0] + value[ROTATION_Z] * spin[3];
+	    float w = value[ROTATION_W] * spin[3] - value[ROTATION_X] * spin[0] - value[ROTATION_Y] * spin[1] - value[ROTATION_Z] * spin[2];
+	    
+	    float* m = target[curr].transform;
+	    
+	    m[0] = (1.0f - 2.0f * (y * y + z * z)) * value[SCALE_X];
+	    m[1] = 2.0f * (x * y + w * z) * value[SCALE_X];
+	    m[2] = 2.0f * (x * z - w * y) * value[SCALE_X];
+	    m[3] = 0.0f;
+	    m[4] = 2.0f * (x * y - w * z) * value[SCALE_Y];
+	    m[5] = (1.0f - 2.0f * (x * x + z * z)) * value[SCALE_Y];
+	    m[6] = 2.0f * (y * z + w * x) * value[SCALE_Y];
+	    m[7] = 0.0f;
+	    m[8] = 2.0f * (x * z + w * y) * value[SCALE_Z];
+	    m[9] = 2.0f * (y * z - w * x) * value[SCALE_Z];
+	    m[10] = (1.0f - 2.0f * (x * x + y * y)) * value[SCALE_Z];
+	    m[11] = 0.0f;
+	    m[12] = value[POSITION_X];
+	    m[13] = value[POSITION_Y];
+	    m[14] = value[POSITION_Z];
+	    m[15] = 1.0f;
+	    
+	    finishInstance(arrays, source, target[curr]);
+	}
+    }
+    
+#ifdef FOREVER_TRANSFORM_X86
+    // Four instances at a time, each matrix column transposed out of the
+    // lanes and stored whole
+    __attribute__((target("sse2")))
+    static void composeSSE(const TransformArrays& arrays, const float spin[4], const GLuint* indices, size_t begin, size_t end, Instance* target)
+    {
+	const __m128 sx = _mm_set1_ps(spin[0]), sy = _mm_set1_ps(spin[1]), sz = _mm_set1_ps(spin[2]), sw = _mm_set1_ps(spin[3]);
+	const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+	
+	for(size_t index = begin; index < end; index += 4) {
+	    __m128 value[TRANSFORM_COMPONENTS];
+	    GLuint lanes[4];
+	    
+	    getLanes(indices, index, end, 4, lanes);
+	    
+	    if(!indices && index + 4 <= end) {
+		for(int component = 0; component < TRANSFORM_COMPONENTS; ++component)
+		    value[component] = _mm_loadu_ps(arrays.components[component] + index);
+	    } else {
+		for(int component = 0; component < TRANSFORM_COMPONENTS; ++component) {
+		    const float* array = arrays.components[component];
+		    value[component] = _mm_setr_ps(array[lanes[0]], array[lanes[1]], array[lanes[2]], array[lanes[3]]);
+		}
+	    }
+	    
+	    // rotation * spin
+	    __m128 x = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(value[ROTATION_W], sx), _mm_mul_ps(value[ROTATION_X], sw)), _mm_mul_ps(value[ROTATION_Y], sz)), _mm_mul_ps(value[ROTATION_Z], sy));
+	    __m128 y = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(value[ROTATION_W], sy), _mm_mul_ps(value[ROTATION_X], sz)), _mm_mul_ps(value[ROTATION_Y], sw)), _mm_mul_ps(value[ROTATION_Z], sx));
+	    __m128 z = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(value[ROTATION_W], sz), _mm_mul_ps(value[ROTATION_X], sy)), _mm_mul_ps(value[ROTATION_Y], sx)), _mm_mul_ps(value[ROTATION_Z], sw));
+	    __m128 w = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(value[ROTATION_W], sw), _mm_mul_ps(value[ROTATION_X], sx)), _mm_mul_ps(value[ROTATION_Y], sy)), _mm_mul_ps(value[ROTATION_Z], sz));
+	    
+	    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+	    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+	    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+	    
+	    // Rows of each column across the lanes
+	    __m128 column[4][4] = {
+		{_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), value[SCALE_X]),
+		 _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), value[SCALE_X]),
+		 _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), value[SCALE_X]), zero},
+		{_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), value[SCALE_Y]),
+		 _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), value[SCALE_Y]),
+		 _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), value[SCALE_Y]), zero},
+		{_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), value[SCALE_Z]),
+		 _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), value[SCALE_Z]),
+		 _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), value[SCALE_Z]), zero},
+		{value[POSITION_X], value[POSITION_Y], value[POSITION_Z], one}
+	    };
+	    
+	    size_t laneCount = std::min(end - index, (size_t)4);
+	    
+	    for(int curr = 0; curr < 4; ++curr) {
+		_MM_TRANSPOSE4_PS(column[curr][0], column[curr][1], column[curr][2], column[curr][3]);
+		
+		for(size_t lane = 0; lane < laneCount; ++lane)
+		    _mm_storeu_ps(target[index + lane].transform + curr * 4, column[curr][lane]);
+	    }
+	    
+	    for(size_t lane = 0; lane < laneCount; ++lane)
+		finishInstance(arrays, lanes[lane], target[index + lane]);
+	}
+    }
+    
+    // Eight instances at a time, each half transposed as above
+    __attribute__((target("avx2,fma")))
+    static void composeAVX2(const TransformArrays& arrays, const float spin[4], const GLuint* indices, size_t begin, size_t end, Instance* target)
+    {
+	const __m256 sx = _mm256_set1_ps(spin[0]), sy = _mm256_set1_ps(spin[1]), sz = _mm256_set1_ps(spin[2]), sw = _mm256_set1_ps(spin[3]);
+	const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+	
+	for(size_t index = begin; index < end; index += 8) {
+	    __m256 value[TRANSFORM_COMPONENTS];
+	    GLuint lanes[8];
+	    
+	    getLanes(indices, index, end, 8, lanes);
+	    
+	    if(!indices && index + 8 <= end) {
+		for(int component = 0; component < TRANSFORM_COMPONENTS; ++component)
+		    value[component] = _mm256_loadu_ps(arrays.components[component] + index);
+	    } else {
+		__m256i offsets = _mm256_loadu_si256((const __m256i*)lanes);
+		
+		for(int component = 0; component < TRANSFORM_COMPONENTS; ++component)
+		    value[component] = _mm256_i32gather_ps(arrays.components[component], offsets, 4);
+	    }
+	    
+	    // rotation * spin
+	    __m256 x = _mm256_fnmadd_ps(value[ROTATION_Z], sy, _mm256_fmadd_ps(value[ROTATION_Y], sz, _mm256_fmadd_ps(value[ROTATION_X], sw, _mm256_mul_ps(value[ROTATION_W], sx))));
+	    __m256 y = _mm256_fmadd_ps(value[ROTATION_Z], sx, _mm256_fmadd_ps(value[ROTATION_Y], sw, _mm256_fnmadd_ps(value[ROTATION_X], sz, _mm256_mul_ps(value[ROTATION_W], sy))));
+	    __m256 z = _mm256_fmadd_ps(value[ROTATION_Z], sw, _mm256_fnmadd_ps(value[ROTATION_Y], sx, _mm256_fmadd_ps(value[ROTATION_X], sy, _mm256_mul_ps(value[ROTATION_W], sz))));
+	    __m256 w = _mm256_fnmadd_ps(value[ROTATION_Z], sz, _mm256_fnmadd_ps(value[ROTATION_Y], sy, _mm256_fnmadd_ps(value[ROTATION_X], sx, _mm256_mul_ps(value[ROTATION_W], sw))));
+	    
+	    __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+	    __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+	    __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+	    
+	    __m256 column[4][4] = {
+		{_mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one), value[SCALE_X]),
+		 _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), value[SCALE_X]),
+		 _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), value[SCALE_X]), zero},
+		{_mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), value[SCALE_Y]),
+		 _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one), value[SCALE_Y]),
+		 _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), value[SCALE_Y]), zero},
+		{_mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), value[SCALE_Z]),
+		 _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), value[SCALE_Z]),
+		 _mm256_mul_ps(_mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one), value[SCALE_Z]), zero},
+		{value[POSITION_X], value[POSITION_Y], value[POSITION_Z], one}
+	    };
+	    
+	    size_t laneCount = std::min(end - index, (size_t)8);
+	    
+	    for(int curr = 0; curr < 4; ++curr) {
+		for(size_t half = 0; half < 2; ++half) {
+		    __m128 row[4];
+		    
+		    for(int element = 0; element < 4; ++element)
+			row[element] = half ? _mm256_extractf128_ps(column[curr][element], 1) : _mm256_castps256_ps128(column[curr][element]);
+		    
+		    _MM_TRANSPOSE4_PS(row[0], row[1], row[2], row[3]);
+		    
+		    for(size_t lane = half * 4; lane < laneCount && lane < half * 4 + 4; ++lane)
+			_mm_storeu_ps(target[index + lane].transform + curr * 4, row[lane - half * 4]);
+		}
+	    }
+	    
+	    for(size_t lane = 0; lane < laneCount; ++lane)
+		finishInstance(arrays, lanes[lane], target[index + lane]);
+	}
+    }
+#endif
+    
+    // Constructor
+    TransformSet::TransformSet(void):
+	count(0)
+    {}
+    
+    // From model matrices
+    void TransformSet::assign(const vector<Instance>& instances, const glm::vec3& spinAxis)
+    {
+	count = instances.size();
+	
+	vector<float>* arrays[] = {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY, &scaleZ};
+	
+	for(size_t array = 0; array < sizeof(arrays) / sizeof(arrays[0]); ++array)
+	    arrays[array]->resize(count);
+	
+	colour.resize(count);
+	surface.resize(count * 4);
+	layer.resize(count);
+	
+	for(size_t index = 0; index < count; ++index) {
+	    const Instance& instance = instances[index];
+	    const float* m = instance.transform;
+	    
+	    glm::vec3 columns[3] = {glm::vec3(m[0], m[1], m[2]), glm::vec3(m[4], m[5], m[6]), glm::vec3(m[8], m[9], m[10])};
+	    glm::vec3 scale(glm::length(columns[0]), glm::length(columns[1]), glm::length(columns[2]));
+	    glm::mat3 rotation;
+	    
+	    for(int column = 0; column < 3; ++column)
+		rotation[column] = scale[column] > 0.0f ? columns[column] / scale[column] : columns[column];
+	    
+	    set(index, glm::vec3(m[12], m[13], m[14]), glm::quat_cast(rotation) * glm::angleAxis(instance.phase, spinAxis), scale);
+	    std::memcpy(&colour[index], instance.colour, sizeof(instance.colour));
+	    std::memcpy(&surface[index * 4], instance.surface, sizeof(instance.surface));
+	    layer[index] = instance.layer;
+	}
+    }
+    
+    // One instance, the rotation normalized
+    void TransformSet::set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+    {
+	glm::quat unit = glm::normalize(rotation);
+	
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+	rotationX[index] = unit.x;
+	rotationY[index] = unit.y;
+	rotationZ[index] = unit.z;
+	rotationW[index] = unit.w;
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+    }
+    
+    // Accessors
+    void TransformSet::get(size_t index, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const
+    {
+	position = glm::vec3(positionX[index], positionY[index], positionZ[index]);
+	rotation = glm::quat(rotationW[index], rotationX[index], rotationY[index], rotationZ[index]);
+	scale = glm::vec3(scaleX[index], scaleY[index], scaleZ[index]);
+    }
+    
+    size_t TransformSet::size(void) const { return count; }
+    
+    // One range through the chosen kernel
+    void TransformSet::compose(Instance* target, size_t begin, size_t end, const glm::quat& spin, CullISA isa, const GLuint* indices) const
+    {
+	if(begin >= end)
+	    return;
+	
+	PROFILE_ZONE("compose");
+	
+	TransformArrays arrays = {
+	    {&positionX[0], &positionY[0], &positionZ[0], &rotationX[0], &rotationY[0], &rotationZ[0], &rotationW[0], &scaleX[0], &scaleY[0], &scaleZ[0]},
+	    &colour[0], &surface[0], &layer[0]
+	};
+	float spinValues[4] = {spin.x, spin.y, spin.z, spin.w};
+	
+	if(!isCullISASupported(isa))
+	    isa = SCALAR_CULL;
+	
+	switch(isa) {
+#ifdef FOREVER_TRANSFORM_X86
+	case SSE_CULL:
+	    composeSSE(arrays, spinValues, indices, begin, end, target);
+	    break;
+	    
+	case AVX2_CULL:
+	    composeAVX2(arrays, spinValues, indices, begin, end, target);
+	    break;
+#endif
+	    
+	default:
+	    composeScalar(arrays, spinValues, indices, begin, end, target);
+	    break;
+	}
+    }
+    
+    // Ranges as jobs
+    void TransformSet::compose(Instance* target, size_t count, const glm::quat& spin, CullISA isa, JobSystem& jobs, const GLuint* indices) const
+    {
+	jobs.parallelFor(0, count, 4096, [=](size_t begin, size_t end) {
+		compose(target, begin, end, spin, isa, indices);
+	    });
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef FOREVER_TRANSFORMS
+#define FOREVER_TRANSFORMS
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "gl_core_4_4.hpp"
+#include "mesh.hpp"
+#include "culling.hpp"
+
+namespace forever
+{
+    class JobSystem;
+    
+    // Instance transforms as position, rotation quaternion and scale in
+    // structure-of-arrays layout, composed into model matrices four or
+    // eight at a time. The kernels share CullISA with culling.
+    class TransformSet
+    {
+    private:
+	size_t count;
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<GLuint> colour;     // packed RGBA, carried through
+	std::vector<GLushort> surface;  // four a instance, carried through
+	std::vector<GLfloat> layer;     // carried through
+	
+    public:
+	TransformSet(void);
+	
+	// Decompose each instance's model matrix, assumed free of shear, its
+	// phase folded into the rotation as a turn about spinAxis the way
+	// cube.vert spins it
+	void assign(const std::vector<Instance>& instances, const glm::vec3& spinAxis);
+	
+	void set(size_t index, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void get(size_t index, glm::vec3& position, glm::quat& rotation, glm::vec3& scale) const;
+	size_t size(void) const;
+	
+	// Write target[begin, end) from instance curr, or indices[curr] when
+	// given, as translate * rotation * spin * scale with a zero phase.
+	// Every field is written, so target may be a write-only mapping.
+	void compose(Instance* target, size_t begin, size_t end, const glm::quat& spin, CullISA isa, const GLuint* indices = NULL) const;
+	
+	// The same over target[0, count), as jobs
+	void compose(Instance* target, size_t count, const glm::quat& spin, CullISA isa, JobSystem& jobs, const GLuint* indices = NULL) const;
+    };
+}
+
+#endif